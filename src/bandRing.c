@@ -0,0 +1,141 @@
+/*
+ * A ring of band buffers, part of an exercise program that draws mandelbrot
+ * sets.
+ *
+ * This module only hands out slots of memory, and keeps the bands in order; it
+ * knows nothing about what is drawn into them.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "bandRing.h"
+
+#include <stdlib.h>
+
+
+
+
+// Allocates the slots, and marks all of them as empty.
+int bandRingInit(bandRing    *ring,
+		 const size_t bandBytes,
+		 const int    slotCount,
+		 const int    bandCount)
+{
+    ring->bandBytes = bandBytes;
+    ring->slotCount = slotCount;
+    ring->bandCount = bandCount;
+    ring->nextBand  = 0;
+    ring->nextWrite = 0;
+    ring->memory    = malloc(bandBytes * slotCount);
+    ring->doneBand  = malloc(slotCount * sizeof *ring->doneBand);
+
+    if (ring->memory == NULL || ring->doneBand == NULL) {
+	free(ring->memory);
+	free(ring->doneBand);
+	return 1;
+    }
+
+    for (int i = 0; i < slotCount; i++)
+	ring->doneBand[i] = -1;
+
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->changed, NULL);
+
+    return 0;
+}
+
+
+
+
+// Frees the slots, and the lock.
+void bandRingFree(bandRing *ring)
+{
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->changed);
+    free(ring->memory);
+    free(ring->doneBand);
+    ring->memory   = NULL;
+    ring->doneBand = NULL;
+}
+
+
+
+
+/* Band n goes in slot n % slotCount, which is free once the band before it in
+   that slot (n - slotCount) has been written. */
+int bandRingClaim(bandRing *ring, int *band, void **buffer)
+{
+    pthread_mutex_lock(&ring->lock);
+
+    if (ring->nextBand == ring->bandCount) {
+	pthread_mutex_unlock(&ring->lock);
+	return 0;
+    }
+
+    const int claimed = ring->nextBand++;
+
+    while (claimed >= ring->nextWrite + ring->slotCount)
+	pthread_cond_wait(&ring->changed, &ring->lock);
+
+    pthread_mutex_unlock(&ring->lock);
+
+    *band   = claimed;
+    *buffer = ring->memory + (size_t) (claimed % ring->slotCount) *
+	ring->bandBytes;
+
+    return 1;
+}
+
+
+
+
+// Marks a band as drawn, waking the writer if it was waiting on it.
+void bandRingDone(bandRing *ring, const int band)
+{
+    pthread_mutex_lock(&ring->lock);
+    ring->doneBand[band % ring->slotCount] = band;
+    pthread_cond_broadcast(&ring->changed);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+
+
+
+// Waits for the next band in order to be drawn.
+int bandRingNextWrite(bandRing *ring, int *band, void **buffer)
+{
+    pthread_mutex_lock(&ring->lock);
+
+    const int next = ring->nextWrite;
+
+    if (next == ring->bandCount) {
+	pthread_mutex_unlock(&ring->lock);
+	return 0;
+    }
+
+    while (ring->doneBand[next % ring->slotCount] != next)
+	pthread_cond_wait(&ring->changed, &ring->lock);
+
+    pthread_mutex_unlock(&ring->lock);
+
+    *band   = next;
+    *buffer = ring->memory + (size_t) (next % ring->slotCount) *
+	ring->bandBytes;
+
+    return 1;
+}
+
+
+
+
+// Gives the written band's slot back, waking any worker waiting on it.
+void bandRingWritten(bandRing *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    ring->nextWrite++;
+    pthread_cond_broadcast(&ring->changed);
+    pthread_mutex_unlock(&ring->lock);
+}
@@ -0,0 +1,70 @@
+/*
+ * A ring of band buffers, part of an exercise program that draws mandelbrot
+ * sets.
+ *
+ * The streaming renderer cuts the image into bands of whole rows. Worker
+ * threads draw the bands, in whatever order they finish, while a single writer
+ * takes them out again strictly top to bottom. The ring only has a handful of
+ * slots, so the memory used stays the same however big the image is: a worker
+ * that runs too far ahead of the writer waits for a slot to free up, and the
+ * writer waits for the band it needs next.
+ *
+ * Like the tile scheduler, this module knows nothing about what is drawn into
+ * the bands.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef BAND_RING_MODULE
+#define BAND_RING_MODULE
+
+#include <stddef.h>
+#include <pthread.h>
+
+
+
+// The ring itself. Shared between the workers and the writer.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;     // Signalled when a band is done or written.
+    unsigned char  *memory;      // Every slot, one after the other.
+    size_t          bandBytes;   // Size of a single slot.
+    int             slotCount;
+    int             bandCount;   // Bands in the whole image.
+    int             nextBand;    // Next band handed to a worker.
+    int             nextWrite;   // Next band the writer takes.
+    int            *doneBand;    // Band last finished in each slot, or -1.
+} bandRing;
+
+
+
+/*
+ * Sets up a ring of slotCount slots, each bandBytes big, for an image of
+ * bandCount bands. Returns 1 if memory could not be allocated, 0 otherwise.
+ */
+int  bandRingInit(bandRing    *ring,
+		  const size_t bandBytes,
+		  const int    slotCount,
+		  const int    bandCount);
+void bandRingFree(bandRing *ring);
+
+/*
+ * Hands a worker the next band to draw, and the slot to draw it into, waiting
+ * until the slot is free. Returns 0 once every band has been handed out, 1
+ * otherwise. The band must be passed to bandRingDone once it is drawn.
+ */
+int  bandRingClaim(bandRing *ring, int *band, void **buffer);
+void bandRingDone(bandRing *ring, const int band);
+
+/*
+ * Hands the writer the next band of the image, in order, waiting until it has
+ * been drawn. Returns 0 once every band has been written, 1 otherwise. The
+ * slot must be given back with bandRingWritten once it is written out.
+ */
+int  bandRingNextWrite(bandRing *ring, int *band, void **buffer);
+void bandRingWritten(bandRing *ring);
+
+#endif // BAND_RING_MODULE
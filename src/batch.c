@@ -0,0 +1,346 @@
+/*
+ * A batch driver, part of an exercise program that draws mandelbrot sets.
+ *
+ * This file, 'batch.c', draws a whole list of images in one run. Each line of
+ * the job file is one image, given the same options and size as mandelbrot
+ * would take on its command line. For small images, starting a process, and
+ * setting up its memory, takes longer than drawing them, so doing them all in
+ * one process saves most of the time.
+ *
+ * Jobs are split by how much work they could take (pixels times iterations).
+ * Large jobs are drawn one after another, each by every thread at once. Small
+ * ones are then shared out among the threads, each drawn whole by one thread,
+ * so many of them are drawn at once. The same threads are kept for the whole
+ * run, as OpenMP keeps them between parallel blocks, and every image takes its
+ * buffers from a pool shared by the whole batch, and gives them back when
+ * done, so the buffers of one image are reused by the next.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+
+// getline and strdup are not part of ISO C.
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+#include "mandelbrotRender.h"
+#include "bufferPool.h"
+#include "renderOptions.h"
+
+/* Names of the images of jobs without -O, numbered by their place in the job
+   file, counting from 0. */
+#define JOB_FILENAME "mandelbrot.job%05d.%s"
+
+/* Work (pixels times iterations, in millions) past which a job is large, and
+   megabytes of buffers kept for reuse, unless told otherwise. */
+#define BATCH_LARGE_WORK 256
+#define BATCH_POOL_MB    256
+
+
+
+
+// One image of the batch, and how it went.
+typedef struct {
+    renderSettings renderInput;
+    char          *line;       // Copy of the job's line, which the names
+    const char    *outputPath; // point into.
+    int            lineNumber;
+    int            number;     // Place among the jobs, from 0.
+    double         work;       // Pixels times iterations.
+    int            status;     // Exit status, as mandelbrot would give.
+    double         seconds;
+} batchJob;
+
+
+
+
+// Seperated out for cleanliness.
+static void helpMenu(void)
+{
+    printf(
+	"Usage:\n"
+	"    mandelbrotBatch [options] jobfile\n"
+	"Draws every image in the job file (or - for standard input), one per\n"
+	"line, each given as mandelbrot would take it: [options] width height.\n"
+	"Job options: -x -y -z -i -o -l -c -b -d -k -e -T -P -j -f -A -F -O.\n"
+	"Images without -O are saved as mandelbrot.job00000.tga and so on.\n"
+	"Available options:\n"
+	"        -t : Threads (default: every CPU).\n"
+	"        -L : Work (millions of pixels times iterations) past which a\n"
+	"             job is drawn by every thread at once (default %d).\n"
+	"        -m : Megabytes of buffers kept for reuse (default %d).\n"
+	"        -s : Print how long each job took.\n"
+	"        -h : Invokes this help menu.\n",
+	BATCH_LARGE_WORK, BATCH_POOL_MB
+	);
+}
+
+
+
+
+/* Reads every job in the file. Lines that are blank, or start with #, are
+   skipped. Returns the number of jobs, or -1 if memory ran out. Jobs that
+   could not be read are kept, with a status of 1, so they are counted. */
+static int readJobs(FILE *jobFile, batchJob **jobs)
+{
+    char  *line       = NULL;
+    size_t lineSize   = 0;
+    int    count      = 0;
+    int    capacity   = 0;
+    int    lineNumber = 0;
+
+    *jobs = NULL;
+
+    while (getline(&line, &lineSize, jobFile) != -1) {
+	const char *start = line + strspn(line, " \t\r\n");
+	lineNumber++;
+
+	if (*start == '\0' || *start == '#')
+	    continue;
+
+	// The list grows by doubling, as the number of jobs is not known.
+	if (count == capacity) {
+	    capacity = (capacity > 0) ? 2 * capacity : 64;
+
+	    batchJob *grown = realloc(*jobs, capacity * sizeof *grown);
+
+	    if (grown == NULL) {
+		free(line);
+		return -1;
+	    }
+
+	    *jobs = grown;
+	}
+
+	batchJob *job = &(*jobs)[count];
+
+	job->renderInput = renderOptionsDefaults();
+	job->line        = strdup(line);
+	job->outputPath  = NULL;
+	job->lineNumber  = lineNumber;
+	job->number      = count;
+	job->work        = 0;
+	job->seconds     = 0;
+	count++;
+
+	if (job->line == NULL) {
+	    free(line);
+	    return -1;
+	}
+
+	char error[256];
+
+	job->status = renderOptionsParse(job->line, &job->renderInput,
+					 &job->outputPath, error, sizeof error);
+
+	if (job->status != 0) {
+	    fprintf(
+		stderr,
+		"Error: Line %d: %s\n",
+		lineNumber, error
+		);
+	    continue;
+	}
+
+	job->work = (double) job->renderInput.draw.width *
+	    job->renderInput.draw.height *
+	    job->renderInput.color.maxIterations;
+    }
+
+    free(line);
+
+    return count;
+}
+
+
+
+
+/*
+ * Draws one job, on the given number of threads, with its buffers from the
+ * pool. Large jobs go to the parallel renderer, and small ones to the plain
+ * one, which is the one that runs alongside others. Fills in the job's status,
+ * saying what went wrong if anything did.
+ */
+static void runJob(batchJob *job, const int threadCount, bufferPool *pool)
+{
+    renderSettings renderInput = job->renderInput;
+    char           name[sizeof JOB_FILENAME + 16];
+    const double   startTime   = omp_get_wtime();
+
+    if (job->outputPath == NULL)
+	snprintf(name, sizeof name, JOB_FILENAME, job->number,
+		 imageFormatExtension(renderInput.format));
+
+    const char *imageName = (job->outputPath != NULL) ? job->outputPath : name;
+
+    renderInput.draw.threadCount = threadCount;
+    renderInput.pool             = pool;
+    renderInput.imageFile        = fopen(imageName, "wb");
+
+    if (renderInput.imageFile == NULL) {
+	fprintf(
+	    stderr,
+	    "Error: Line %d: Could not open \"%s\".\n",
+	    job->lineNumber, imageName
+	    );
+	job->status = 3;
+	return;
+    }
+
+    const int status = (threadCount > 1) ?
+	renderToTarga_parallel(renderInput) : renderToTarga(renderInput);
+
+    if (fclose(renderInput.imageFile) != 0 && status == 0) {
+	fprintf(
+	    stderr,
+	    "Error: Line %d: Could not write \"%s\".\n",
+	    job->lineNumber, imageName
+	    );
+	job->status = 3;
+    } else if (status != 0) {
+	fprintf(
+	    stderr,
+	    "Error: Line %d: Could not allocate memory for the image.\n",
+	    job->lineNumber
+	    );
+	job->status = 2;
+    }
+
+    job->seconds = omp_get_wtime() - startTime;
+}
+
+
+
+
+/* Reads the job file, draws the large jobs one at a time, then the small ones
+   all at once. Returns 0 if every job was drawn, or else the highest exit
+   status of any job. */
+int main(int argc, char *argv[])
+{
+    int    threadCount = omp_get_num_procs();
+    double largeWork   = BATCH_LARGE_WORK;
+    long   poolSize    = BATCH_POOL_MB;
+    int    statsFlag   = 0;
+    int    arg;
+
+    while ((arg = getopt(argc, argv, "t:L:m:sh")) != -1) {
+	switch (arg) {
+	case 't':
+	    threadCount = atoi(optarg);
+	    break;
+
+	case 'L':
+	    largeWork = atof(optarg);
+	    break;
+
+	case 'm':
+	    poolSize = atol(optarg);
+	    break;
+
+	case 's':
+	    statsFlag = 1;
+	    break;
+
+	case 'h':
+	    helpMenu();
+	    return 0;
+
+	default:
+	    fprintf(
+		stderr,
+		"Use -h for additional help.\n"
+		);
+	    return 1;
+	}
+    }
+
+    if (optind != argc - 1 || threadCount < 1 || largeWork < 0 ||
+	poolSize < 0) {
+	fprintf(
+	    stderr,
+	    "Error: Needs one job file, and a positive thread count (-t), "
+	    "work (-L) and pool size (-m).\n"
+	    "Use -h for additional help.\n"
+	    );
+	return 1;
+    }
+
+    FILE *jobFile = (strcmp(argv[optind], "-") == 0) ?
+	stdin : fopen(argv[optind], "r");
+
+    if (jobFile == NULL) {
+	fprintf(
+	    stderr,
+	    "Error: Could not open the job file.\n"
+	    );
+	return 3;
+    }
+
+    batchJob *jobs;
+    const int jobCount = readJobs(jobFile, &jobs);
+
+    if (jobFile != stdin)
+	fclose(jobFile);
+
+    if (jobCount < 0) {
+	fprintf(
+	    stderr,
+	    "Error: Could not allocate memory for the jobs.\n"
+	    );
+	return 2;
+    }
+
+    bufferPool pool;
+    bufferPoolInit(&pool, (size_t) poolSize << 20);
+
+    const double startTime = omp_get_wtime();
+
+    // Large jobs first, each spread over every thread by the renderer.
+    for (int i = 0; i < jobCount; i++)
+	if (jobs[i].status == 0 && jobs[i].work > largeWork * 1e6)
+	    runJob(&jobs[i], threadCount, &pool);
+
+    /* Then the small ones, handed out one at a time to whichever thread is
+       free, and each drawn by that thread alone. */
+    #pragma omp parallel for num_threads(threadCount) schedule(dynamic, 1)
+    for (int i = 0; i < jobCount; i++)
+	if (jobs[i].status == 0 && jobs[i].work <= largeWork * 1e6)
+	    runJob(&jobs[i], 1, &pool);
+
+    const double seconds = omp_get_wtime() - startTime;
+    int          status  = 0;
+    int          failed  = 0;
+
+    for (int i = 0; i < jobCount; i++) {
+	if (jobs[i].status != 0)
+	    failed++;
+	if (jobs[i].status > status)
+	    status = jobs[i].status;
+
+	if (statsFlag == 1 && jobs[i].status == 0)
+	    fprintf(stderr, "Line %d: %.3f s.\n", jobs[i].lineNumber,
+		    jobs[i].seconds);
+
+	free(jobs[i].line);
+    }
+
+    if (statsFlag == 1)
+	fprintf(
+	    stderr,
+	    "%d jobs (%d failed) in %.3f s. Buffers: %zu allocated, %zu "
+	    "reused.\n",
+	    jobCount, failed, seconds, pool.allocated, pool.reused
+	    );
+
+    free(jobs);
+    bufferPoolFree(&pool);
+
+    return status;
+}
@@ -0,0 +1,502 @@
+/*
+ * A benchmark driver, part of an exercise program that draws mandelbrot sets.
+ *
+ * This file, 'bench.c', runs a fixed set of scenes through every renderer, at
+ * a range of thread counts, and prints how fast each one went as JSON, so that
+ * numbers from different builds (or machines) can be compared by a script.
+ *
+ * Each render runs in a child process of its own, so that the peak memory use
+ * reported for it is its own, and not that of whichever render came before.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+
+// fork, pipe and wait4 are not part of ISO C.
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <omp.h>
+#include "mandelbrotRender.h"
+#include "escapeKernel.h"
+
+// Size of the images drawn, unless told otherwise.
+#define BENCH_WIDTH  640
+#define BENCH_HEIGHT 360
+
+// Times each render is run; the fastest run is the one reported.
+#define BENCH_REPEATS 3
+
+// Passes the progressive renderer draws in.
+#define BENCH_PASSES 4
+
+// Most threads a render is ever given.
+#define BENCH_MAX_THREADS 256
+
+
+
+
+// A place on the complex plane to draw, and how.
+typedef struct {
+    const char *name;
+    const char *real;          // Center, as -x and -y would take it.
+    const char *imag;
+    double      zoomLevel;
+    int         maxIterations;
+    fractalType fractal;
+    int         power;
+    int         deepZoom;
+} benchScene;
+
+
+
+// The scenes drawn: something of every kind of work the renderers face.
+static const benchScene scenes[] = {
+    // The whole set. Mostly cheap points, and the bulbs test.
+    {"full",     "0",     "0",    1,     1000,  FRACTAL_MANDELBROT,   2, 0},
+    // Seahorse valley. Almost every point escapes, but slowly.
+    {"seahorse", "-0.745", "0.1", 512,   1440,  FRACTAL_MANDELBROT,   2, 0},
+    // Mostly inside a period-3 bulb, where periodicity checking matters.
+    {"interior", "-0.1",  "0.8",  4,     20000, FRACTAL_MANDELBROT,   2, 0},
+    // Far past the limits of doubles, in deep-zoom mode.
+    {"deep",     "0",     "1",    1e100, 3000,  FRACTAL_MANDELBROT,   2, 1},
+    // The default Julia set, with no bulbs test to help.
+    {"julia",    "0",     "0",    1,     1000,  FRACTAL_JULIA,        2, 0},
+    // A multibrot set, with a few more multiplies every iteration.
+    {"cubic",    "0",     "0",    1,     1000,  FRACTAL_MANDELBROT,   3, 0},
+    // The burning ship, around its namesake.
+    {"ship",     "-1.76", "-0.03", 20,   1000,  FRACTAL_BURNING_SHIP, 2, 0}
+};
+
+
+
+// A renderer, and whether it uses more than one thread.
+typedef struct {
+    const char *name;
+    int       (*render)(const renderSettings renderInput);
+    int         parallel;
+    fillMode    fill;
+} benchRenderer;
+
+
+
+static const benchRenderer renderers[] = {
+    {"serial",         renderToTarga,             0, FILL_NONE},
+    {"lowMem",         renderToTarga_lowMem,      0, FILL_NONE},
+    {"parallel",       renderToTarga_parallel,    1, FILL_NONE},
+    {"stream",         renderToTarga_stream,      1, FILL_NONE},
+    {"mapped",         renderToTarga_mapped,      1, FILL_NONE},
+    {"fill-subdivide", renderToTarga_fill,        1, FILL_SUBDIVIDE},
+    {"fill-trace",     renderToTarga_fill,        1, FILL_TRACE},
+    {"progressive",    renderToTarga_progressive, 1, FILL_NONE}
+};
+
+
+
+// Names of the kernels, in the order of kernelType.
+static const char *kernelNames[] = {
+    "auto", "scalar", "sse2", "avx2", "avx512"
+};
+
+
+
+// What a child process sends back about the render it ran.
+typedef struct {
+    int          status;
+    double       seconds;    // Wall-clock time of the whole call, with output.
+    double       renderTime; // Time spent drawing, as the renderer reports it.
+    unsigned int threadCount;
+    double       busyTime[BENCH_MAX_THREADS];
+} benchRun;
+
+
+
+
+// Sets up the render settings for a scene, the way main.c's defaults would.
+static renderSettings sceneSettings(const benchScene *scene,
+				    const int         width,
+				    const int         height)
+{
+    renderSettings renderInput;
+
+    renderInput.draw.width              = width;
+    renderInput.draw.height             = height;
+    renderInput.draw.threadCount        = 1;
+    renderInput.draw.offset.real        = atof(scene->real);
+    renderInput.draw.offset.imag        = atof(scene->imag);
+    renderInput.draw.zoomLevel          = scene->zoomLevel;
+    renderInput.draw.fill               = FILL_NONE;
+    renderInput.draw.passes             = BENCH_PASSES;
+    renderInput.draw.samples            = 1;
+    renderInput.color.maxIterations     = scene->maxIterations;
+    renderInput.color.constantLight     = 0.5;
+    renderInput.color.hueOffset         = 0;
+    renderInput.color.hueLimiter        = 1;
+    renderInput.color.lightMax          = 1;
+    renderInput.color.lightDistribution = 4;
+    renderInput.calc.fractal            = scene->fractal;
+    renderInput.calc.power              = scene->power;
+    renderInput.calc.juliaConstant.real = -0.8;
+    renderInput.calc.juliaConstant.imag = 0.156;
+    renderInput.calc.kernel             = KERNEL_AUTO;
+    renderInput.calc.interiorChecks     = INTERIOR_ALL;
+    renderInput.calc.deepZoom           = scene->deepZoom;
+    renderInput.calc.deepReal           = scene->real;
+    renderInput.calc.deepImag           = scene->imag;
+    renderInput.calc.smooth             = 0;
+    renderInput.calc.reference          = NULL;
+    renderInput.imageFile               = NULL;
+    renderInput.format                  = IMAGE_TGA;
+    renderInput.escapeFile              = NULL;
+    renderInput.stats                   = NULL;
+    renderInput.passDone                = NULL;
+    renderInput.passContext             = NULL;
+    renderInput.pool                    = NULL;
+
+    return renderInput;
+}
+
+
+
+
+/*
+ * Counts the iterations a scene takes, as a plain escape-time loop would count
+ * them: every point inside the set costs the full iteration count, whether or
+ * not the interior checks skip it. This keeps iterations per second comparable
+ * between renderers that skip different amounts of work. Returns -1 if the
+ * scene could not be drawn.
+ */
+static double sceneIterations(renderSettings renderInput)
+{
+    renderInput.imageFile  = tmpfile();
+    renderInput.escapeFile = tmpfile();
+
+    if (renderInput.imageFile == NULL || renderInput.escapeFile == NULL ||
+	renderToTarga(renderInput) != 0) {
+	if (renderInput.imageFile != NULL)
+	    fclose(renderInput.imageFile);
+	if (renderInput.escapeFile != NULL)
+	    fclose(renderInput.escapeFile);
+
+	return -1;
+    }
+
+    tEscapeBuffer escapes;
+    rewind(renderInput.escapeFile);
+
+    const int status = escapeBufferRead(&escapes, renderInput.escapeFile);
+    fclose(renderInput.imageFile);
+    fclose(renderInput.escapeFile);
+
+    if (status != 0)
+	return -1;
+
+    const int maxIterations = escapes.maxIterations;
+    double    total         = 0;
+
+    for (int y = 0; y < escapes.height; y++) {
+	for (int x = 0; x < escapes.width; x++) {
+	    const int escape = escapeBufferGet(&escapes, x, y);
+
+	    total += (escape == 0) ? maxIterations : maxIterations - escape + 1;
+	}
+    }
+
+    escapeBufferDeallocate(&escapes);
+
+    return total;
+}
+
+
+
+
+/* Runs one render in a child process, and collects what it reports, along with
+   its peak resident memory. Returns 1 if the child could not be run. */
+static int runChild(const benchRenderer *renderer,
+		    renderSettings       renderInput,
+		    benchRun            *run,
+		    long                *peakMemory)
+{
+    int pipeEnds[2];
+
+    if (pipe(pipeEnds) != 0)
+	return 1;
+
+    const pid_t child = fork();
+
+    if (child < 0) {
+	close(pipeEnds[0]);
+	close(pipeEnds[1]);
+	return 1;
+    }
+
+    if (child == 0) {
+	// Draws the image into a scratch file, timing the whole call.
+	threadStats threads[BENCH_MAX_THREADS];
+	renderStats stats;
+	benchRun    result;
+
+	memset(&result, 0, sizeof result);
+	stats.thread          = threads;
+	renderInput.stats     = &stats;
+	renderInput.imageFile = tmpfile();
+
+	if (renderInput.imageFile == NULL) {
+	    result.status = 1;
+	} else {
+	    const double startTime = omp_get_wtime();
+
+	    result.status  = renderer->render(renderInput);
+	    fflush(renderInput.imageFile);
+	    result.seconds = omp_get_wtime() - startTime;
+	    fclose(renderInput.imageFile);
+	}
+
+	if (result.status == 0) {
+	    result.renderTime  = stats.renderTime;
+	    result.threadCount = stats.threadCount;
+
+	    for (unsigned int i = 0; i < stats.threadCount; i++)
+		result.busyTime[i] = stats.thread[i].busyTime;
+	}
+
+	const int written = write(pipeEnds[1], &result, sizeof result) ==
+	    (ssize_t) sizeof result;
+	_exit(written ? 0 : 1);
+    }
+
+    close(pipeEnds[1]);
+
+    const ssize_t got = read(pipeEnds[0], run, sizeof *run);
+    close(pipeEnds[0]);
+
+    int           childStatus;
+    struct rusage usage;
+
+    if (wait4(child, &childStatus, 0, &usage) != child ||
+	!WIFEXITED(childStatus) || WEXITSTATUS(childStatus) != 0 ||
+	got != (ssize_t) sizeof *run)
+	return 1;
+
+    // Linux reports this in kilobytes.
+    *peakMemory = usage.ru_maxrss;
+
+    return 0;
+}
+
+
+
+
+// Prints a JSON string. The names here never need escaping.
+static void printString(const char *name, const char *value)
+{
+    printf("\"%s\": \"%s\"", name, value);
+}
+
+
+
+
+/* Runs a renderer on a scene with the given kernel and thread count, several
+   times over, and prints the fastest run as one JSON object. Returns 1 if any
+   run failed. */
+static int benchOne(const benchScene    *scene,
+		    const benchRenderer *renderer,
+		    renderSettings       renderInput,
+		    const double         iterations,
+		    const int            repeats,
+		    int                 *first)
+{
+    benchRun best;
+    long     peakMemory = 0;
+
+    memset(&best, 0, sizeof best);
+
+    for (int i = 0; i < repeats; i++) {
+	benchRun run;
+	long     memory;
+
+	if (runChild(renderer, renderInput, &run, &memory) != 0 ||
+	    run.status != 0)
+	    return 1;
+
+	if (i == 0 || run.seconds < best.seconds)
+	    best = run;
+	if (memory > peakMemory)
+	    peakMemory = memory;
+    }
+
+    const double pixels = (double) renderInput.draw.width *
+	renderInput.draw.height;
+
+    printf("%s\n    {", *first ? "" : ",");
+    *first = 0;
+
+    printString("scene", scene->name);
+    printf(", ");
+    printString("renderer", renderer->name);
+    printf(", ");
+    printString("kernel", scene->deepZoom ?
+		"perturbation" : kernelNames[renderInput.calc.kernel]);
+    printf(", \"threads\": %u", renderInput.draw.threadCount);
+    printf(", \"seconds\": %.6f", best.seconds);
+    printf(", \"renderSeconds\": %.6f", best.renderTime);
+    printf(", \"megapixelsPerSecond\": %.3f", pixels / best.seconds / 1e6);
+    printf(", \"iterationsPerSecond\": %.4g", iterations / best.seconds);
+    printf(", \"peakRssKB\": %ld", peakMemory);
+    printf(", \"threadUtilization\": [");
+
+    for (unsigned int i = 0; i < best.threadCount; i++)
+	printf("%s%.3f", (i == 0) ? "" : ", ", (best.renderTime > 0) ?
+	       best.busyTime[i] / best.renderTime : 1.0);
+
+    printf("]}");
+    fflush(stdout);
+
+    return 0;
+}
+
+
+
+
+// Seperated out for cleanliness.
+static void helpMenu(void)
+{
+    printf(
+	"Usage:\n"
+	"    mandelbrotBench [options] [width height]\n"
+	"Runs every scene through every renderer, and prints the results as\n"
+	"JSON. Images are %dx%d unless a size is given.\n"
+	"Available options:\n"
+	"        -r : Runs of each render; the fastest counts (default %d).\n"
+	"        -t : Highest thread count to try (default: every CPU).\n"
+	"        -h : Invokes this help menu.\n",
+	BENCH_WIDTH, BENCH_HEIGHT, BENCH_REPEATS
+	);
+}
+
+
+
+
+/* Goes through every scene, renderer, kernel and thread count in turn. Thread
+   counts go up in powers of two, up to the highest one asked for. */
+int main(int argc, char *argv[])
+{
+    int width      = BENCH_WIDTH;
+    int height     = BENCH_HEIGHT;
+    int repeats    = BENCH_REPEATS;
+    int maxThreads = omp_get_num_procs();
+    int arg;
+
+    while ((arg = getopt(argc, argv, "r:t:h")) != -1) {
+	switch (arg) {
+	case 'r':
+	    repeats = atoi(optarg);
+	    break;
+
+	case 't':
+	    maxThreads = atoi(optarg);
+	    break;
+
+	case 'h':
+	    helpMenu();
+	    return 0;
+
+	default:
+	    fprintf(
+		stderr,
+		"Use -h for additional help.\n"
+		);
+	    return 1;
+	}
+    }
+
+    if (optind <= argc - 2) {
+	width  = atoi(argv[optind]);
+	height = atoi(argv[optind + 1]);
+    }
+
+    if (width < 1 || height < 1 || repeats < 1 || maxThreads < 1 ||
+	maxThreads > BENCH_MAX_THREADS) {
+	fprintf(
+	    stderr,
+	    "Error: Sizes, runs (-r) and threads (-t, at most %d) must be "
+	    "positive.\n",
+	    BENCH_MAX_THREADS
+	    );
+	return 1;
+    }
+
+    printf("{\n  \"width\": %d, \"height\": %d, \"repeats\": %d, "
+	   "\"cpus\": %d,\n  \"results\": [",
+	   width, height, repeats, omp_get_num_procs());
+
+    int first  = 1;
+    int failed = 0;
+
+    for (size_t s = 0; s < sizeof scenes / sizeof *scenes; s++) {
+	const benchScene *scene       = &scenes[s];
+	renderSettings    renderInput = sceneSettings(scene, width, height);
+	const double      iterations  = sceneIterations(renderInput);
+
+	fprintf(stderr, "Scene \"%s\"...\n", scene->name);
+
+	if (iterations < 0) {
+	    fprintf(
+		stderr,
+		"Error: Could not draw scene \"%s\".\n",
+		scene->name
+		);
+	    failed = 1;
+	    continue;
+	}
+
+	for (size_t r = 0; r < sizeof renderers / sizeof *renderers; r++) {
+	    const benchRenderer *renderer = &renderers[r];
+	    renderInput.draw.fill = renderer->fill;
+
+	    for (int step = 1; ; step *= 2) {
+		const int threads = (step < maxThreads) ? step : maxThreads;
+		renderInput.draw.threadCount = threads;
+
+		/* Single-threaded renderers are tried with every kernel the
+		   CPU has, and the rest just with the best one. Deep zooms
+		   always use their own kernel. */
+		for (int k = KERNEL_SCALAR; k <= KERNEL_AVX512; k++) {
+		    if (escapeKernelSupported(k) == 0 ||
+			((renderer->parallel || scene->deepZoom) &&
+			 k != (int) escapeKernelBest()))
+			continue;
+
+		    renderInput.calc.kernel = k;
+
+		    if (benchOne(scene, renderer, renderInput, iterations,
+				 repeats, &first) != 0) {
+			fprintf(
+			    stderr,
+			    "Error: %s renderer failed on scene \"%s\".\n",
+			    renderer->name, scene->name
+			    );
+			failed = 1;
+		    }
+		}
+
+		if (renderer->parallel == 0 || threads == maxThreads)
+		    break;
+	    }
+	}
+    }
+
+    printf("\n  ]\n}\n");
+
+    return failed;
+}
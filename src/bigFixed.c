@@ -0,0 +1,323 @@
+/*
+ * Arbitrary-precision fixed-point numbers, part of an exercise program that
+ * draws mandelbrot sets.
+ *
+ * This module only contains the number type and its arithmetic. It is plain
+ * schoolbook arithmetic, which is plenty for the few hundred bits a deep zoom
+ * needs.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "bigFixed.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+// Longest run of digits bigFixedParse will read, after any exponent.
+#define MAX_DIGITS 4096
+
+
+
+
+// One integer limb, plus enough fraction limbs to hold the bits.
+int bigFixedLimbsFor(const int fractionBits)
+{
+    int limbs = 1 + (fractionBits + 31) / 32;
+
+    if (limbs < 2)
+	limbs = 2;
+    if (limbs > BIG_FIXED_MAX_LIMBS)
+	limbs = BIG_FIXED_MAX_LIMBS;
+
+    return limbs;
+}
+
+
+
+
+// Sets a number to zero.
+static void bigFixedZero(tBigFixed *number, const int limbCount)
+{
+    number->negative  = 0;
+    number->limbCount = limbCount;
+    memset(number->limb, 0, sizeof number->limb);
+}
+
+
+
+
+// Compares the magnitudes of two numbers. Returns -1, 0 or 1, like strcmp.
+static int compareMagnitude(const tBigFixed *a, const tBigFixed *b)
+{
+    for (int i = a->limbCount - 1; i >= 0; i--) {
+	if (a->limb[i] != b->limb[i])
+	    return (a->limb[i] > b->limb[i]) ? 1 : -1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Adds the magnitudes of two numbers, ignoring sign.
+static void addMagnitude(tBigFixed *result, const tBigFixed *a,
+			 const tBigFixed *b)
+{
+    uint64_t carry = 0;
+
+    for (int i = 0; i < a->limbCount; i++) {
+	carry          += (uint64_t) a->limb[i] + b->limb[i];
+	result->limb[i] = (uint32_t) carry;
+	carry         >>= 32;
+    }
+}
+
+
+
+
+// Subtracts the magnitude of b from a, which must be the larger one.
+static void subMagnitude(tBigFixed *result, const tBigFixed *a,
+			 const tBigFixed *b)
+{
+    int64_t borrow = 0;
+
+    for (int i = 0; i < a->limbCount; i++) {
+	int64_t difference = (int64_t) a->limb[i] - b->limb[i] - borrow;
+
+	borrow          = difference < 0;
+	result->limb[i] = (uint32_t) (difference + (borrow << 32));
+    }
+}
+
+
+
+
+/* Adds two signed numbers. Same signs add their magnitudes, and different
+   signs subtract the smaller magnitude from the larger. */
+static void addSigned(tBigFixed *result, const tBigFixed *a,
+		      const int aNegative, const tBigFixed *b,
+		      const int bNegative)
+{
+    tBigFixed sum;
+    sum.limbCount = a->limbCount;
+
+    if (aNegative == bNegative) {
+	addMagnitude(&sum, a, b);
+	sum.negative = aNegative;
+    } else if (compareMagnitude(a, b) >= 0) {
+	subMagnitude(&sum, a, b);
+	sum.negative = aNegative;
+    } else {
+	subMagnitude(&sum, b, a);
+	sum.negative = bNegative;
+    }
+
+    *result = sum;
+}
+
+
+
+
+// Adds two numbers.
+void bigFixedAdd(tBigFixed *result, const tBigFixed *a, const tBigFixed *b)
+{
+    addSigned(result, a, a->negative, b, b->negative);
+}
+
+
+
+
+// Subtracts b from a, by adding b with its sign flipped.
+void bigFixedSub(tBigFixed *result, const tBigFixed *a, const tBigFixed *b)
+{
+    addSigned(result, a, a->negative, b, !b->negative);
+}
+
+
+
+
+/* Multiplies two numbers. The full product has twice as many fraction limbs as
+   the inputs, so the lowest half of them are dropped to get back to the same
+   fixed point. */
+void bigFixedMul(tBigFixed *result, const tBigFixed *a, const tBigFixed *b)
+{
+    const int limbCount = a->limbCount;
+    const int fraction  = limbCount - 1;
+    uint32_t  product[2 * BIG_FIXED_MAX_LIMBS];
+
+    memset(product, 0, 2 * limbCount * sizeof *product);
+
+    for (int i = 0; i < limbCount; i++) {
+	uint64_t carry = 0;
+
+	if (a->limb[i] == 0)
+	    continue;
+
+	for (int j = 0; j < limbCount; j++) {
+	    carry += (uint64_t) a->limb[i] * b->limb[j] + product[i + j];
+	    product[i + j] = (uint32_t) carry;
+	    carry >>= 32;
+	}
+
+	product[i + limbCount] = (uint32_t) carry;
+    }
+
+    result->limbCount = limbCount;
+    result->negative  = a->negative != b->negative;
+    memcpy(result->limb, product + fraction, limbCount * sizeof *product);
+}
+
+
+
+
+/* Divides the magnitude of a number by a small integer, in place. Used for
+   shifting decimal digits into the fraction. */
+static void divideSmall(tBigFixed *number, const uint32_t divisor)
+{
+    uint64_t remainder = 0;
+
+    for (int i = number->limbCount - 1; i >= 0; i--) {
+	const uint64_t current = (remainder << 32) | number->limb[i];
+
+	number->limb[i] = (uint32_t) (current / divisor);
+	remainder       = current % divisor;
+    }
+}
+
+
+
+
+/*
+ * Reads a decimal number. The digits are first gathered into one string with
+ * the decimal point's position noted, which makes exponents a matter of
+ * moving the point. The integer digits are then read as a normal integer,
+ * while the fraction digits are fed in from the last one to the first, each
+ * time adding the digit and dividing by ten.
+ */
+int bigFixedParse(tBigFixed *number, const char *string, const int limbCount)
+{
+    char digits[MAX_DIGITS];
+    int  digitCount = 0;
+    int  pointAt    = -1; // Digits before the decimal point.
+    int  negative   = 0;
+
+    bigFixedZero(number, limbCount);
+
+    while (isspace((unsigned char) *string))
+	string++;
+
+    if (*string == '-' || *string == '+')
+	negative = (*string++ == '-');
+
+    for (; *string != '\0'; string++) {
+	if (isdigit((unsigned char) *string)) {
+	    if (digitCount == MAX_DIGITS)
+		return 1;
+	    digits[digitCount++] = *string - '0';
+	} else if (*string == '.' && pointAt < 0) {
+	    pointAt = digitCount;
+	} else {
+	    break;
+	}
+    }
+
+    if (digitCount == 0)
+	return 1;
+    if (pointAt < 0)
+	pointAt = digitCount;
+
+    // An exponent just moves the decimal point.
+    if (*string == 'e' || *string == 'E') {
+	char *end;
+	long  exponent = strtol(string + 1, &end, 10);
+
+	if (end == string + 1 ||
+	    exponent > MAX_DIGITS || exponent < -MAX_DIGITS)
+	    return 1;
+
+	pointAt += exponent;
+	string   = end;
+    }
+
+    // Anything left over means this was not a number.
+    if (*string != '\0')
+	return 1;
+
+    // Reads the integer part, which has to fit in the integer limb.
+    uint64_t integer = 0;
+
+    for (int i = 0; i < pointAt; i++) {
+	integer = integer * 10 + (i < digitCount ? digits[i] : 0);
+
+	if (integer > UINT32_MAX)
+	    return 1;
+    }
+
+    /* Reads the fraction from the last digit back. Digits before the first
+       one (when the point is further left than the digits start) are zeros. */
+    const int firstFraction = (pointAt > 0) ? pointAt : 0;
+
+    for (int i = digitCount - 1; i >= firstFraction; i--) {
+	number->limb[limbCount - 1] = digits[i];
+	divideSmall(number, 10);
+    }
+
+    for (int i = pointAt; i < 0; i++)
+	divideSmall(number, 10);
+
+    number->limb[limbCount - 1] = (uint32_t) integer;
+    number->negative            = negative;
+
+    return 0;
+}
+
+
+
+
+/* Splits a double into limbs, 32 bits at a time. This is exact as long as the
+   number has enough fraction limbs to reach the double's lowest bit. */
+void bigFixedFromDouble(tBigFixed *number, double value, const int limbCount)
+{
+    bigFixedZero(number, limbCount);
+
+    if (value < 0) {
+	number->negative = 1;
+	value            = -value;
+    }
+
+    for (int i = limbCount - 1; i >= 0 && value > 0; i--) {
+	const double limb = floor(value);
+
+	number->limb[i] = (uint32_t) limb;
+	value           = ldexp(value - limb, 32);
+    }
+}
+
+
+
+
+/* Adds up the limbs from the least significant end, so the rounding happens
+   where it matters least. Only three limbs, from the highest non-zero one
+   down, can reach a double's 53 bits, so the rest are skipped. */
+double bigFixedToDouble(const tBigFixed *number)
+{
+    const int fraction = number->limbCount - 1;
+    int       highest  = number->limbCount - 1;
+    double    value    = 0;
+
+    while (highest > 0 && number->limb[highest] == 0)
+	highest--;
+
+    for (int i = (highest > 2) ? highest - 2 : 0; i <= highest; i++)
+	value += ldexp((double) number->limb[i], 32 * (i - fraction));
+
+    return number->negative ? -value : value;
+}
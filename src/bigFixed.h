@@ -0,0 +1,60 @@
+/*
+ * Arbitrary-precision fixed-point numbers, part of an exercise program that
+ * draws mandelbrot sets.
+ *
+ * Doubles run out of digits at a zoom of around 10^13, so deep zooms need the
+ * center of the image (and one orbit through it) worked out with more precision.
+ * This module gives just enough arithmetic for that: parsing, adding,
+ * subtracting and multiplying, with as many bits after the point as needed.
+ *
+ * A number is stored as a sign and a magnitude, the magnitude being a run of
+ * 32 bit limbs, least significant first. The last limb holds the integer part,
+ * and every other limb holds 32 bits of the fraction.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef BIG_FIXED_MODULE
+#define BIG_FIXED_MODULE
+
+#include <stdint.h>
+
+// Most limbs a number can have. 128 limbs is just over 4000 bits.
+#define BIG_FIXED_MAX_LIMBS 128
+
+
+
+// An arbitrary-precision fixed-point number.
+typedef struct {
+    int      negative;  // 1 for negative numbers, 0 otherwise.
+    int      limbCount; // Fraction limbs, plus one integer limb.
+    uint32_t limb[BIG_FIXED_MAX_LIMBS];
+} tBigFixed;
+
+
+
+// Works out how many limbs are needed for a number of bits after the point.
+int bigFixedLimbsFor(const int fractionBits);
+
+/*
+ * Reads a decimal number such as "-0.7436438870371587" or "1.5e-3" into a
+ * number with the given limb count. The integer part must fit in 32 bits.
+ * Returns 1 if the string is not a number, 0 otherwise.
+ */
+int bigFixedParse(tBigFixed *number, const char *string, const int limbCount);
+
+// Converts a double into a number with the given limb count.
+void bigFixedFromDouble(tBigFixed *number, double value, const int limbCount);
+
+// Rounds a number to the nearest double.
+double bigFixedToDouble(const tBigFixed *number);
+
+// Arithmetic. Both inputs must have the same limb count, as the result will.
+void bigFixedAdd(tBigFixed *result, const tBigFixed *a, const tBigFixed *b);
+void bigFixedSub(tBigFixed *result, const tBigFixed *a, const tBigFixed *b);
+void bigFixedMul(tBigFixed *result, const tBigFixed *a, const tBigFixed *b);
+
+#endif // BIG_FIXED_MODULE
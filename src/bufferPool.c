@@ -0,0 +1,167 @@
+/*
+ * A pool of reusable buffers, part of an exercise program that draws
+ * mandelbrot sets.
+ *
+ * Every buffer has a small header in front of it, holding its class, and the
+ * next buffer in its list while it waits to be reused. The header is a whole
+ * cache line, so buffers keep the alignment of malloc, and more.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "bufferPool.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+
+// Bytes in front of every buffer, for its header.
+#define HEADER_SIZE 64
+
+
+
+
+// What sits in front of every buffer.
+typedef struct {
+    void *next;      // Next buffer in the list, while waiting to be reused.
+    int   sizeClass; // Buffer holds 2^(sizeClass + BUFFER_POOL_CLASS_MIN).
+} bufferHeader;
+
+_Static_assert(sizeof (bufferHeader) <= HEADER_SIZE, "Header must fit");
+
+
+
+
+// Finds the header of a buffer.
+static bufferHeader *headerOf(void *buffer)
+{
+    return (bufferHeader *) ((unsigned char *) buffer - HEADER_SIZE);
+}
+
+
+
+
+// Finds the smallest class that holds size bytes, or -1 if none does.
+static int classOf(const size_t size)
+{
+    for (int i = 0; i < BUFFER_POOL_CLASSES; i++)
+	if (size <= (size_t) 1 << (i + BUFFER_POOL_CLASS_MIN))
+	    return i;
+
+    return -1;
+}
+
+
+
+
+// Sets up an empty pool.
+void bufferPoolInit(bufferPool *pool, const size_t limit)
+{
+    omp_init_lock(&pool->lock);
+
+    for (int i = 0; i < BUFFER_POOL_CLASSES; i++)
+	pool->free[i] = NULL;
+
+    pool->held      = 0;
+    pool->limit     = limit;
+    pool->reused    = 0;
+    pool->allocated = 0;
+}
+
+
+
+
+// Frees every buffer still waiting in the pool, and the pool's lock.
+void bufferPoolFree(bufferPool *pool)
+{
+    for (int i = 0; i < BUFFER_POOL_CLASSES; i++) {
+	while (pool->free[i] != NULL) {
+	    bufferHeader *header = headerOf(pool->free[i]);
+
+	    pool->free[i] = header->next;
+	    free(header);
+	}
+    }
+
+    pool->held = 0;
+    omp_destroy_lock(&pool->lock);
+}
+
+
+
+
+/* Takes the first buffer from the list of its class, if there is one. The
+   buffer may have been used before, so it is not zeroed. */
+void *bufferPoolTake(bufferPool *pool, const size_t size)
+{
+    if (pool == NULL)
+	return malloc(size);
+
+    const int sizeClass = classOf(size);
+
+    if (sizeClass < 0)
+	return NULL;
+
+    const size_t bytes  = (size_t) 1 << (sizeClass + BUFFER_POOL_CLASS_MIN);
+    void        *buffer = NULL;
+
+    omp_set_lock(&pool->lock);
+
+    if (pool->free[sizeClass] != NULL) {
+	buffer                = pool->free[sizeClass];
+	pool->free[sizeClass] = headerOf(buffer)->next;
+	pool->held           -= bytes;
+	pool->reused++;
+    } else {
+	pool->allocated++;
+    }
+
+    omp_unset_lock(&pool->lock);
+
+    if (buffer != NULL)
+	return buffer;
+
+    // Nothing to reuse, so the system is asked, outside of the lock.
+    bufferHeader *header = malloc(HEADER_SIZE + bytes);
+
+    if (header == NULL)
+	return NULL;
+
+    header->sizeClass = sizeClass;
+
+    return (unsigned char *) header + HEADER_SIZE;
+}
+
+
+
+
+// Puts a buffer at the front of the list of its class, if there is room.
+void bufferPoolGive(bufferPool *pool, void *buffer)
+{
+    if (pool == NULL || buffer == NULL) {
+	free(buffer);
+	return;
+    }
+
+    bufferHeader *header = headerOf(buffer);
+    const size_t  bytes  = (size_t) 1 <<
+	(header->sizeClass + BUFFER_POOL_CLASS_MIN);
+    int           kept   = 0;
+
+    omp_set_lock(&pool->lock);
+
+    if (pool->held + bytes <= pool->limit) {
+	header->next                  = pool->free[header->sizeClass];
+	pool->free[header->sizeClass] = buffer;
+	pool->held                   += bytes;
+	kept                          = 1;
+    }
+
+    omp_unset_lock(&pool->lock);
+
+    if (kept == 0)
+	free(header);
+}
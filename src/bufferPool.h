@@ -0,0 +1,58 @@
+/*
+ * A pool of reusable buffers, part of an exercise program that draws
+ * mandelbrot sets.
+ *
+ * Drawing many small images one after another spends much of its time asking
+ * the system for memory and handing it back, and in the page faults of memory
+ * that is brand new. A pool keeps the buffers of finished images instead, and
+ * hands them out again to the next ones. Buffers are sorted into classes by
+ * size, each a power of two, so a buffer can be reused by any image that
+ * needs about as much memory, not only one of the very same size.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef BUFFER_POOL_MODULE
+#define BUFFER_POOL_MODULE
+
+#include <stddef.h>
+#include <omp.h>
+
+// Size classes of the pool: buffers of 2^12 (4 KiB) bytes up to 2^47.
+#define BUFFER_POOL_CLASS_MIN 12
+#define BUFFER_POOL_CLASSES   36
+
+
+
+/* The pool itself, which any number of threads can take buffers from and give
+   them back to at once. Buffers waiting to be reused are kept in a list for
+   each class, up to limit bytes in all; any more are freed. */
+typedef struct bufferPool {
+    omp_lock_t lock;
+    void      *free[BUFFER_POOL_CLASSES]; // Buffers waiting to be reused.
+    size_t     held;                      // Bytes waiting, over every class.
+    size_t     limit;
+    size_t     reused;                    // Buffers handed out again.
+    size_t     allocated;                 // Buffers asked of the system.
+} bufferPool;
+
+
+
+/* Tools for creating a pool, keeping up to limit bytes of buffers for reuse.
+   Freeing a pool frees every buffer waiting in it. */
+void bufferPoolInit(bufferPool *pool, const size_t limit);
+void bufferPoolFree(bufferPool *pool);
+
+/*
+ * Takes a buffer of at least size bytes from the pool, or from the system if
+ * the pool has none of its class, and gives one back once done with it. With
+ * a NULL pool, these are just malloc and free. Taking returns NULL if memory
+ * could not be allocated, and the buffer is not zeroed.
+ */
+void *bufferPoolTake(bufferPool *pool, const size_t size);
+void  bufferPoolGive(bufferPool *pool, void *buffer);
+
+#endif // BUFFER_POOL_MODULE
@@ -0,0 +1,261 @@
+/*
+ * Escape-time buffers, part of an exercise program that draws mandelbrot sets.
+ *
+ * This module only contains the buffer itself, and its file format. Turning
+ * the escape times into colors is left to 'mandelbrotRender.c'.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "escapeBuffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bufferPool.h"
+
+// First bytes of every escape buffer file, and the version of the format.
+#define FILE_MAGIC   "MESC"
+#define FILE_VERSION 2
+
+// Written as a number, so a file from the other byte order reads back wrong.
+#define BYTE_ORDER_MARK 0x01020304
+
+
+
+
+// The header of an escape buffer file.
+typedef struct {
+    char     magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t width;
+    uint32_t height;
+    uint32_t maxIterations;
+    uint32_t countSize;
+    uint32_t smoothFlag;
+    uint32_t expMapFlag;
+} fileHeader;
+
+
+
+
+/* Allocates the escape times, with nothing to give them back to but the
+   system. */
+int escapeBufferAllocate(tEscapeBuffer *buffer, const int width,
+			 const int height, const int maxIterations,
+			 const int smoothFlag)
+{
+    return escapeBufferAllocateFrom(buffer, NULL, width, height, maxIterations,
+				    smoothFlag);
+}
+
+
+
+
+/* Takes zeroed memory from a pool, or from calloc without one. Reused memory
+   has to be zeroed by hand. */
+static void *allocateZeroed(bufferPool *pool, const size_t count,
+			    const size_t size)
+{
+    if (pool == NULL)
+	return calloc(count, size);
+
+    void *memory = bufferPoolTake(pool, count * size);
+
+    if (memory != NULL)
+	memset(memory, 0, count * size);
+
+    return memory;
+}
+
+
+
+
+/* Allocates the escape times, picking the smallest size that holds every
+   iteration count. They are zeroed, which reads as "inside the set". */
+int escapeBufferAllocateFrom(tEscapeBuffer *buffer,
+			     bufferPool    *pool,
+			     const int      width,
+			     const int      height,
+			     const int      maxIterations,
+			     const int      smoothFlag)
+{
+    const size_t pixels = (size_t) width * height;
+
+    buffer->width         = width;
+    buffer->height        = height;
+    buffer->maxIterations = maxIterations;
+    buffer->countSize     = (maxIterations <= UINT16_MAX) ? 2 : 4;
+    buffer->expMap        = 0;
+    buffer->counts16      = NULL;
+    buffer->counts32      = NULL;
+    buffer->smooth        = NULL;
+    buffer->pool          = pool;
+
+    if (buffer->countSize == 2)
+	buffer->counts16 = allocateZeroed(pool, pixels,
+					  sizeof *buffer->counts16);
+    else
+	buffer->counts32 = allocateZeroed(pool, pixels,
+					  sizeof *buffer->counts32);
+
+    if (smoothFlag)
+	buffer->smooth = allocateZeroed(pool, pixels, sizeof *buffer->smooth);
+
+    if ((buffer->counts16 == NULL && buffer->counts32 == NULL) ||
+	(smoothFlag && buffer->smooth == NULL)) {
+	escapeBufferDeallocate(buffer);
+	return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Frees the memory of an escape buffer, or gives it back to its pool.
+void escapeBufferDeallocate(tEscapeBuffer *buffer)
+{
+    bufferPoolGive(buffer->pool, buffer->counts16);
+    bufferPoolGive(buffer->pool, buffer->counts32);
+    bufferPoolGive(buffer->pool, buffer->smooth);
+    buffer->counts16 = NULL;
+    buffer->counts32 = NULL;
+    buffer->smooth   = NULL;
+}
+
+
+
+
+// Narrows the escape times down to the buffer's size as they are stored.
+void escapeBufferStore(tEscapeBuffer *buffer, const int x, const int y,
+		       const int count, const int *escapes,
+		       const float *smooth)
+{
+    const size_t start = (size_t) y * buffer->width + x;
+
+    if (buffer->countSize == 2) {
+	for (int i = 0; i < count; i++)
+	    buffer->counts16[start + i] = (uint16_t) escapes[i];
+    } else {
+	for (int i = 0; i < count; i++)
+	    buffer->counts32[start + i] = (uint32_t) escapes[i];
+    }
+
+    if (buffer->smooth != NULL && smooth != NULL)
+	memcpy(buffer->smooth + start, smooth, count * sizeof *smooth);
+}
+
+
+
+
+// Writes the header, then the escape times, then any smooth escape times.
+int escapeBufferWrite(const tEscapeBuffer *buffer, FILE *file)
+{
+    const size_t pixels = (size_t) buffer->width * buffer->height;
+    fileHeader   header;
+
+    memcpy(header.magic, FILE_MAGIC, sizeof header.magic);
+    header.version       = FILE_VERSION;
+    header.byteOrder     = BYTE_ORDER_MARK;
+    header.width         = buffer->width;
+    header.height        = buffer->height;
+    header.maxIterations = buffer->maxIterations;
+    header.countSize     = buffer->countSize;
+    header.smoothFlag    = buffer->smooth != NULL;
+    header.expMapFlag    = buffer->expMap;
+
+    if (fwrite(&header, sizeof header, 1, file) != 1)
+	return 1;
+
+    const void *counts = (buffer->countSize == 2) ?
+	(const void *) buffer->counts16 : (const void *) buffer->counts32;
+
+    if (fwrite(counts, buffer->countSize, pixels, file) != pixels)
+	return 1;
+
+    if (buffer->smooth != NULL &&
+	fwrite(buffer->smooth, sizeof *buffer->smooth, pixels, file) != pixels)
+	return 1;
+
+    return 0;
+}
+
+
+
+
+/* Checks that every escape time read back lies within the iteration count,
+   as the palette has no color for any other. Smooth times that are not
+   numbers, or lie outside it, are turned down too. Returns 1 if any do. */
+static int checkTimes(const tEscapeBuffer *buffer)
+{
+    const size_t pixels = (size_t) buffer->width * buffer->height;
+    const int    limit  = buffer->maxIterations;
+
+    for (size_t i = 0; i < pixels; i++) {
+	const int escape = (buffer->countSize == 2) ?
+	    buffer->counts16[i] : (int) buffer->counts32[i];
+
+	if (escape < 0 || escape > limit)
+	    return 1;
+    }
+
+    if (buffer->smooth != NULL)
+	for (size_t i = 0; i < pixels; i++)
+	    if (!isfinite(buffer->smooth[i]) || buffer->smooth[i] < 0 ||
+		buffer->smooth[i] > limit)
+		return 1;
+
+    return 0;
+}
+
+
+
+
+/* Reads a buffer written by escapeBufferWrite, checking the header before
+   trusting any of its sizes, and the escape times before trusting them. */
+int escapeBufferRead(tEscapeBuffer *buffer, FILE *file)
+{
+    fileHeader header;
+
+    if (fread(&header, sizeof header, 1, file) != 1)
+	return 1;
+
+    if (memcmp(header.magic, FILE_MAGIC, sizeof header.magic) != 0 ||
+	header.version != FILE_VERSION ||
+	header.byteOrder != BYTE_ORDER_MARK)
+	return 1;
+
+    if (header.width == 0 || header.width > INT32_MAX ||
+	header.height == 0 || header.height > INT32_MAX ||
+	header.maxIterations == 0 || header.maxIterations > INT32_MAX ||
+	header.expMapFlag > 1)
+	return 1;
+
+    if (escapeBufferAllocate(buffer, header.width, header.height,
+			     header.maxIterations, header.smoothFlag) != 0)
+	return 1;
+
+    buffer->expMap = header.expMapFlag;
+
+    // The size is worked out from the iteration count, so they must agree.
+    const size_t pixels = (size_t) buffer->width * buffer->height;
+    void        *counts = (buffer->countSize == 2) ?
+	(void *) buffer->counts16 : (void *) buffer->counts32;
+
+    if (header.countSize != (uint32_t) buffer->countSize ||
+	fread(counts, buffer->countSize, pixels, file) != pixels ||
+	(buffer->smooth != NULL &&
+	 fread(buffer->smooth, sizeof *buffer->smooth, pixels, file) != pixels) ||
+	checkTimes(buffer) != 0) {
+	escapeBufferDeallocate(buffer);
+	return 1;
+    }
+
+    return 0;
+}
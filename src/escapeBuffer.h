@@ -0,0 +1,93 @@
+/*
+ * Escape-time buffers, part of an exercise program that draws mandelbrot sets.
+ *
+ * An escape buffer holds the raw escape times of every pixel of an image,
+ * before they are given colors. Keeping them around (or saving them to disk)
+ * means the image can be colored again with different color settings, without
+ * working out a single iteration twice.
+ *
+ * The escape times take 2 bytes a pixel when the iteration count fits in 16
+ * bits, and 4 bytes otherwise. Smooth (fractional) escape times can be kept
+ * alongside them, at another 4 bytes a pixel.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef ESCAPE_BUFFER_MODULE
+#define ESCAPE_BUFFER_MODULE
+
+#include <stdio.h>
+#include <stdint.h>
+
+
+
+/*
+ * The escape times of an image, stored row-major like tImage, but without any
+ * padding between rows.
+ *
+ * Only one of counts16 and counts32 is used, depending on countSize. smooth is
+ * NULL unless smooth escape times were asked for. expMap starts out as 0, and
+ * is left for whoever draws an exponential map into the buffer to set.
+ */
+typedef struct {
+    uint16_t *counts16;      // Escape times, if countSize is 2.
+    uint32_t *counts32;      // Escape times, if countSize is 4.
+    float    *smooth;        // Fractional escape times, or NULL.
+    int       width;
+    int       height;
+    int       maxIterations; // Iteration count the image was drawn with.
+    int       countSize;     // Bytes per escape time, 2 or 4.
+    int       expMap;        // 1 if the rows are an exponential map's.
+    struct bufferPool *pool; // Where the memory goes back to, or NULL.
+} tEscapeBuffer;
+
+
+
+/* Tools for creating a buffer in RAM. Allocation returns 1 on failure, and
+   zeroes the buffer, so untouched pixels count as inside the set. The memory
+   can be taken from a pool (see 'bufferPool.h'), and is then given back to it
+   when the buffer is deallocated. */
+int  escapeBufferAllocate(tEscapeBuffer *buffer, const int width,
+			  const int height, const int maxIterations,
+			  const int smoothFlag);
+int  escapeBufferAllocateFrom(tEscapeBuffer     *buffer,
+			      struct bufferPool *pool,
+			      const int          width,
+			      const int          height,
+			      const int          maxIterations,
+			      const int          smoothFlag);
+void escapeBufferDeallocate(tEscapeBuffer *buffer);
+
+// Stores a span of escape times (and smooth ones, if kept) into a row.
+void escapeBufferStore(tEscapeBuffer *buffer, const int x, const int y,
+		       const int count, const int *escapes,
+		       const float *smooth);
+
+// Gets a single escape time.
+static inline int escapeBufferGet(const tEscapeBuffer *buffer, const int x,
+				  const int y)
+{
+    const size_t i = (size_t) y * buffer->width + x;
+
+    if (buffer->countSize == 2)
+	return buffer->counts16[i];
+
+    return (int) buffer->counts32[i];
+}
+
+
+
+/*
+ * Tools for saving a buffer to disk, and reading it back in. The file is a
+ * short header followed by the raw escape times, in the byte order of the
+ * machine that wrote it. Both return 1 on failure; reading also fails on
+ * files that are not escape buffers, were written by a machine with the
+ * other byte order, or hold escape times past their own iteration count.
+ */
+int escapeBufferWrite(const tEscapeBuffer *buffer, FILE *file);
+int escapeBufferRead(tEscapeBuffer *buffer, FILE *file);
+
+#endif // ESCAPE_BUFFER_MODULE
@@ -0,0 +1,230 @@
+/*
+ * A cache of escape-time buffers, part of an exercise program that draws
+ * mandelbrot sets.
+ *
+ * The cache is a fixed table of slots, searched from end to end. It never
+ * holds more than a few hundred images, and comparing their settings is far
+ * quicker than anything else done with an image, so nothing cleverer is
+ * needed to find one, or the least recently used one.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "escapeCache.h"
+
+#include <stdlib.h>
+
+
+
+
+// Sets up an empty cache.
+void escapeCacheInit(escapeCache *cache, const size_t limit)
+{
+    for (int i = 0; i < ESCAPE_CACHE_ENTRIES; i++) {
+	cache->entries[i].lastUsed = 0;
+	cache->entries[i].image    = NULL;
+    }
+
+    cache->held   = 0;
+    cache->limit  = limit;
+    cache->clock  = 0;
+    cache->hits   = 0;
+    cache->misses = 0;
+}
+
+
+
+
+// Empties a slot, freeing everything in it.
+static void dropEntry(escapeCache *cache, escapeCacheEntry *entry)
+{
+    escapeBufferDeallocate(&entry->escapes);
+    free(entry->image);
+
+    cache->held     -= entry->bytes;
+    entry->image     = NULL;
+    entry->lastUsed  = 0;
+}
+
+
+
+
+// Deallocates every image still in the cache.
+void escapeCacheFree(escapeCache *cache)
+{
+    for (int i = 0; i < ESCAPE_CACHE_ENTRIES; i++)
+	if (cache->entries[i].lastUsed != 0)
+	    dropEntry(cache, &cache->entries[i]);
+}
+
+
+
+
+/* Drops the least recently used image, other than keep (which may be NULL).
+   Returns 1 if there was none to drop. */
+static int dropLeastRecent(escapeCache *cache, const escapeCacheEntry *keep)
+{
+    escapeCacheEntry *oldest = NULL;
+
+    for (int i = 0; i < ESCAPE_CACHE_ENTRIES; i++) {
+	escapeCacheEntry *entry = &cache->entries[i];
+
+	if (entry->lastUsed != 0 && entry != keep &&
+	    (oldest == NULL || entry->lastUsed < oldest->lastUsed))
+	    oldest = entry;
+    }
+
+    if (oldest == NULL)
+	return 1;
+
+    dropEntry(cache, oldest);
+
+    return 0;
+}
+
+
+
+
+/* Whether two sets of settings give the same escape times. The Julia constant
+   only matters to Julia sets. */
+static int sameEscapes(const renderSettings *a, const renderSettings *b)
+{
+    return a->draw.width == b->draw.width &&
+	a->draw.height == b->draw.height &&
+	a->draw.offset.real == b->draw.offset.real &&
+	a->draw.offset.imag == b->draw.offset.imag &&
+	a->draw.zoomLevel == b->draw.zoomLevel &&
+	a->color.maxIterations == b->color.maxIterations &&
+	a->calc.fractal == b->calc.fractal &&
+	a->calc.power == b->calc.power &&
+	a->calc.smooth == b->calc.smooth &&
+	(a->calc.fractal != FRACTAL_JULIA ||
+	 (a->calc.juliaConstant.real == b->calc.juliaConstant.real &&
+	  a->calc.juliaConstant.imag == b->calc.juliaConstant.imag));
+}
+
+
+
+
+// Compares the colors field by field, as the struct has padding.
+int escapeCacheImageMatches(const escapeCacheEntry *entry,
+			    const colorSettings     color,
+			    const imageFormat       format)
+{
+    return entry->image != NULL && entry->format == format &&
+	entry->color.maxIterations == color.maxIterations &&
+	entry->color.hueLimiter == color.hueLimiter &&
+	entry->color.hueOffset == color.hueOffset &&
+	entry->color.constantLight == color.constantLight &&
+	entry->color.lightMax == color.lightMax &&
+	entry->color.lightDistribution == color.lightDistribution;
+}
+
+
+
+
+// Looks through every slot in use.
+escapeCacheEntry *escapeCacheFind(escapeCache          *cache,
+				  const renderSettings *renderInput)
+{
+    for (int i = 0; i < ESCAPE_CACHE_ENTRIES; i++) {
+	escapeCacheEntry *entry = &cache->entries[i];
+
+	if (entry->lastUsed != 0 &&
+	    sameEscapes(&entry->renderInput, renderInput)) {
+	    entry->lastUsed = ++cache->clock;
+	    cache->hits++;
+	    return entry;
+	}
+    }
+
+    cache->misses++;
+
+    return NULL;
+}
+
+
+
+
+/* Makes room for the image first, then takes the first free slot, dropping
+   the least recently used image if every slot is taken. */
+void escapeCacheAdd(escapeCache          *cache,
+		    const renderSettings *renderInput,
+		    tEscapeBuffer        *escapes,
+		    const colorSettings   color,
+		    const imageFormat     format,
+		    char                 *image,
+		    const size_t          imageSize)
+{
+    const size_t pixels = (size_t) escapes->width * escapes->height;
+    const size_t bytes  = pixels * escapes->countSize + imageSize +
+	((escapes->smooth != NULL) ? pixels * sizeof (float) : 0);
+
+    if (bytes > cache->limit) {
+	escapeBufferDeallocate(escapes);
+	free(image);
+	return;
+    }
+
+    while (cache->held + bytes > cache->limit)
+	dropLeastRecent(cache, NULL);
+
+    escapeCacheEntry *entry = NULL;
+
+    for (int i = 0; i < ESCAPE_CACHE_ENTRIES && entry == NULL; i++)
+	if (cache->entries[i].lastUsed == 0)
+	    entry = &cache->entries[i];
+
+    if (entry == NULL) {
+	dropLeastRecent(cache, NULL);
+	escapeCacheAdd(cache, renderInput, escapes, color, format, image,
+		       imageSize);
+	return;
+    }
+
+    entry->renderInput = *renderInput;
+    entry->escapes     = *escapes;
+    entry->color       = color;
+    entry->format      = format;
+    entry->image       = image;
+    entry->imageSize   = imageSize;
+    entry->bytes       = bytes;
+    entry->lastUsed    = ++cache->clock;
+    cache->held       += bytes;
+}
+
+
+
+
+/* Frees the old picture first, then makes room for the new one among the
+   other images. If there is none left to drop, and it still does not fit, the
+   image is kept without a picture. */
+void escapeCacheKeepImage(escapeCache         *cache,
+			  escapeCacheEntry    *entry,
+			  const colorSettings  color,
+			  const imageFormat    format,
+			  char                *image,
+			  const size_t         imageSize)
+{
+    free(entry->image);
+    cache->held     -= entry->imageSize;
+    entry->bytes    -= entry->imageSize;
+    entry->image     = NULL;
+    entry->imageSize = 0;
+
+    while (cache->held + imageSize > cache->limit)
+	if (dropLeastRecent(cache, entry) != 0) {
+	    free(image);
+	    return;
+	}
+
+    entry->color     = color;
+    entry->format    = format;
+    entry->image     = image;
+    entry->imageSize = imageSize;
+    entry->bytes    += imageSize;
+    cache->held     += imageSize;
+}
@@ -0,0 +1,103 @@
+/*
+ * A cache of escape-time buffers, part of an exercise program that draws
+ * mandelbrot sets.
+ *
+ * Working out the escape times is nearly all of the cost of an image, and
+ * coloring them takes no iterating at all. A server that keeps the escape
+ * times of recent images can draw the same view again in new colors, or send
+ * the very same image again, without working anything out. The cache keeps
+ * as many images as fit in its limit, and makes room by dropping the one
+ * that was used the longest time ago. Each image also keeps the last picture
+ * made of it, already encoded, so a request for it can be answered as is.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef ESCAPE_CACHE_MODULE
+#define ESCAPE_CACHE_MODULE
+
+#include <stddef.h>
+#include "mandelbrotRender.h"
+#include "escapeBuffer.h"
+
+// Most images a cache holds, however small.
+#define ESCAPE_CACHE_ENTRIES 256
+
+
+
+/* One image in the cache. The settings are the ones its escape times were
+   drawn with, and only the ones that change them are compared. image holds
+   the picture last made of it, with the colors and format it was made with,
+   or is NULL. */
+typedef struct {
+    renderSettings renderInput;
+    tEscapeBuffer  escapes;
+    colorSettings  color;
+    imageFormat    format;
+    char          *image;
+    size_t         imageSize;
+    size_t         bytes;    // Memory held, escape times and image together.
+    unsigned long  lastUsed; // Time of last use, or 0 if the slot is free.
+} escapeCacheEntry;
+
+
+
+/* The cache itself. Not for use by more than one thread at a time. The slots
+   stay where they are, so an entry can be held on to until the next call
+   that adds to the cache. */
+typedef struct {
+    escapeCacheEntry entries[ESCAPE_CACHE_ENTRIES];
+    size_t           held;  // Bytes held, over every entry.
+    size_t           limit;
+    unsigned long    clock; // Counts up with every use, for lastUsed.
+    unsigned long    hits;
+    unsigned long    misses;
+} escapeCache;
+
+
+
+/* Tools for creating a cache, holding up to limit bytes. Freeing a cache
+   deallocates every image still in it, giving the escape times back to their
+   pools. */
+void escapeCacheInit(escapeCache *cache, const size_t limit);
+void escapeCacheFree(escapeCache *cache);
+
+/* Finds the image drawn with the same settings (size, view, iterations,
+   fractal and smoothing) as renderInput, or returns NULL. A found image
+   becomes the most recently used. */
+escapeCacheEntry *escapeCacheFind(escapeCache          *cache,
+				  const renderSettings *renderInput);
+
+/*
+ * Adds the escape times of an image drawn with renderInput, and a picture of
+ * them, which may be NULL. The cache takes both over, and frees them itself,
+ * at once if they do not fit in its limit. Room is made by dropping the least
+ * recently used images.
+ */
+void escapeCacheAdd(escapeCache          *cache,
+		    const renderSettings *renderInput,
+		    tEscapeBuffer        *escapes,
+		    const colorSettings   color,
+		    const imageFormat     format,
+		    char                 *image,
+		    const size_t          imageSize);
+
+/* Swaps the picture kept for an image for a new one, which the cache takes
+   over, as escapeCacheAdd does. Never drops the image itself. */
+void escapeCacheKeepImage(escapeCache         *cache,
+			  escapeCacheEntry    *entry,
+			  const colorSettings  color,
+			  const imageFormat    format,
+			  char                *image,
+			  const size_t         imageSize);
+
+/* Whether the picture kept for an image was made with these colors and
+   format. */
+int escapeCacheImageMatches(const escapeCacheEntry *entry,
+			    const colorSettings     color,
+			    const imageFormat       format);
+
+#endif // ESCAPE_CACHE_MODULE
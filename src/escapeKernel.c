@@ -0,0 +1,904 @@
+/*
+ * Escape-time kernels, part of an exercise program that draws mandelbrot sets.
+ *
+ * This file, 'escapeKernel.c', holds the innermost loop of the program: the
+ * iteration of z^2 + c (or whichever fractal was asked for) until a point
+ * escapes. Everything else about drawing an image is left to
+ * 'mandelbrotRender.c'.
+ *
+ * Every kernel is written once, as an inline function that takes the fractal
+ * type and power as arguments, and is then compiled over again for every type
+ * and power, with those as constants. The compiler folds away every test on
+ * them, so each copy runs only its own fractal's loop, and the right copy is
+ * picked from a table once per render. A new fractal type only needs a case in
+ * fractalStep (and the vector kernels), and a line in FOR_EACH_KERNEL; none
+ * of the other types' loops change at all.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "escapeKernel.h"
+
+#include <math.h>
+#include "perturbation.h"
+
+/* The vector kernels are written with x86 intrinsics, so they are only built
+   for x86. Anywhere else, the scalar kernels are all there is. */
+#if defined(__x86_64__) || defined(__i386__)
+#define X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define X86_KERNELS 0
+#endif
+
+// Number of points spanByPoints hands to a points kernel at once.
+#define POINTS_CHUNK 64
+
+// Forces the kernel bodies into every copy, where their arguments are known.
+#define KERNEL_BODY static inline __attribute__((always_inline))
+
+/* Runs a macro over every fractal type, and every power of each, handing it
+   the instruction set, the type, a name for the type, and the power. Every
+   power from 2 to FRACTAL_POWER_MAX has to be listed. */
+#define FOR_EACH_KERNEL(macro, isa)                                    \
+    FOR_EACH_POWER(macro, isa, FRACTAL_MANDELBROT,   mandelbrot)        \
+    FOR_EACH_POWER(macro, isa, FRACTAL_JULIA,        julia)             \
+    FOR_EACH_POWER(macro, isa, FRACTAL_BURNING_SHIP, ship)
+
+#define FOR_EACH_POWER(macro, isa, fractal, name)                      \
+    macro(isa, fractal, name, 2) macro(isa, fractal, name, 3)          \
+    macro(isa, fractal, name, 4) macro(isa, fractal, name, 5)          \
+    macro(isa, fractal, name, 6) macro(isa, fractal, name, 7)          \
+    macro(isa, fractal, name, 8)
+
+_Static_assert(FRACTAL_POWER_MAX == 8, "FOR_EACH_POWER must list every power");
+
+// The instruction set each copy of a kernel is compiled for.
+#define TARGET_scalar
+#if X86_KERNELS
+#define TARGET_sse2   __attribute__((target("sse2")))
+#define TARGET_avx2   __attribute__((target("avx2")))
+#define TARGET_avx512 __attribute__((target("avx512f")))
+#endif
+
+
+
+
+/*
+ * One iteration of a fractal, z -> f(z) + c. Squaring is done the same way
+ * as it always has been, so Mandelbrot and Julia sets come out unchanged, and
+ * higher powers multiply by z a step at a time. The burning ship folds z into
+ * the first quadrant before raising it to the power.
+ */
+KERNEL_BODY tComplex fractalStep(const tComplex    z,
+				 const tComplex    c,
+				 const fractalType fractal,
+				 const int         power)
+{
+    tComplex base = z;
+    tComplex newZ;
+
+    if (fractal == FRACTAL_BURNING_SHIP) {
+	base.real = fabs(z.real);
+	base.imag = fabs(z.imag);
+    }
+
+    if (power == 2) {
+	newZ.real = base.real * base.real - base.imag * base.imag + c.real;
+	newZ.imag = 2 * base.real * base.imag + c.imag;
+
+	return newZ;
+    }
+
+    tComplex raised = base;
+
+    for (int i = 1; i < power; i++) {
+	const double real = raised.real * base.real - raised.imag * base.imag;
+
+	raised.imag = raised.real * base.imag + raised.imag * base.real;
+	raised.real = real;
+    }
+
+    newZ.real = raised.real + c.real;
+    newZ.imag = raised.imag + c.imag;
+
+    return newZ;
+}
+
+
+
+
+/*
+ * Checks whether a point lies inside the main cardioid or the period-2 bulb of
+ * the Mandelbrot set. Every such point is in the set, so it can be skipped.
+ * Only true of the Mandelbrot set itself, not the other fractals.
+ *
+ * en.wikipedia.org/wiki/Plotting_algorithms_for_the_Mandelbrot_set -> source
+ * of both tests.
+ */
+static int inMainBulbs(const double real, const double imag)
+{
+    const double imag2 = imag * imag;
+
+    // The period-2 bulb is a circle of radius 1/4 around -1.
+    if ((real + 1) * (real + 1) + imag2 < 0.0625)
+	return 1;
+
+    // The main cardioid.
+    const double shifted = real - 0.25;
+    const double q       = shifted * shifted + imag2;
+
+    return q * (q + shifted) < 0.25 * imag2;
+}
+
+
+
+
+// Whether the bulb test can be used on a fractal, with the checks asked for.
+KERNEL_BODY int bulbCheck(const calcSettings calc,
+			  const fractalType  fractal,
+			  const int          power)
+{
+    return fractal == FRACTAL_MANDELBROT && power == 2 &&
+	(calc.interiorChecks & INTERIOR_BULBS);
+}
+
+
+
+
+/*
+ * Finds out how many iterations it takes for a complex point to diverge, and
+ * where its orbit ended up. Shared by every scalar kernel and the smooth
+ * kernel, so they all count iterations the same way. Mandelbrot-like sets
+ * start z at 0 and add the point, and Julia sets start z at the point and add
+ * a constant.
+ */
+KERNEL_BODY int escapeOrbit(const int          maxIterations,
+			    const tComplex     c,
+			    const calcSettings calc,
+			    tComplex          *last,
+			    const fractalType  fractal,
+			    const int          power)
+{
+    // The two largest parts of the set can be spotted without iterating.
+    if (bulbCheck(calc, fractal, power) && inMainBulbs(c.real, c.imag))
+	return 0;
+
+    const tComplex added = (fractal == FRACTAL_JULIA) ? calc.juliaConstant : c;
+    tComplex       z     = (fractal == FRACTAL_JULIA) ? c : (tComplex) {0, 0};
+
+    /* For periodicity checking, z is saved every so often (at doubling
+       intervals, as in Brent's cycle detection). If z ever lands exactly on
+       the saved value, the orbit is stuck in a cycle and never escapes. The
+       comparison is exact, so the escape times come out unchanged. */
+    const int periodCheck = calc.interiorChecks & INTERIOR_PERIODICITY;
+    tComplex  saved       = z;
+    int       interval    = 1;
+    int       countdown   = 1;
+
+    // Counts down the number of iterations it takes for a point to escape.
+    for (int iterations = maxIterations; iterations > 0; iterations--) {
+	z = fractalStep(z, added, fractal, power);
+
+	if ((z.real * z.real + z.imag * z.imag) >= 4) {
+	    *last = z;
+	    return iterations;
+	}
+
+	if (periodCheck) {
+	    if (z.real == saved.real && z.imag == saved.imag)
+		return 0;
+
+	    if (--countdown == 0) {
+		saved     = z;
+		interval *= 2;
+		countdown = interval;
+	    }
+	}
+    }
+
+    // If the point did not diverge, an empty value is returned.
+    return 0;
+}
+
+
+
+
+// A copy of escapeOrbit for one fractal type and power.
+typedef int (*orbitFunction)(const int          maxIterations,
+			     const tComplex     c,
+			     const calcSettings calc,
+			     tComplex          *last);
+
+#define DEFINE_ORBIT(isa, fractal, name, power)                         \
+    static int orbit_##name##power(const int          maxIterations,    \
+				   const tComplex     c,                \
+				   const calcSettings calc,             \
+				   tComplex          *last)             \
+    {                                                                   \
+	return escapeOrbit(maxIterations, c, calc, last, fractal, power); \
+    }
+
+FOR_EACH_KERNEL(DEFINE_ORBIT, scalar)
+
+#define ORBIT_ENTRY(isa, fractal, name, power) \
+    [fractal][power - 2] = orbit_##name##power,
+
+static const orbitFunction orbits[FRACTAL_TYPES][FRACTAL_POWER_MAX - 1] = {
+    FOR_EACH_KERNEL(ORBIT_ENTRY, scalar)
+};
+
+
+
+
+// Looks up the copy of escapeOrbit for the settings.
+static orbitFunction orbitSelect(const calcSettings calc)
+{
+    return orbits[calc.fractal][calc.power - 2];
+}
+
+
+
+
+// Finds out how many iterations it takes for a complex point to diverge.
+int escapeTime(const int maxIterations, const tComplex c, calcSettings calc)
+{
+    tComplex last;
+
+    return orbitSelect(calc)(maxIterations, c, calc, &last);
+}
+
+
+
+
+// Points kernel that works out every point with escapeOrbit.
+KERNEL_BODY void scalarPoints(const int          maxIterations,
+			      const calcSettings calc,
+			      const double      *reals,
+			      const double      *imags,
+			      const int          count,
+			      int               *escapes,
+			      const fractalType  fractal,
+			      const int          power)
+{
+    for (int i = 0; i < count; i++) {
+	tComplex c, last;
+	c.real = reals[i];
+	c.imag = imags[i];
+
+	escapes[i] = escapeOrbit(maxIterations, c, calc, &last, fractal,
+				 power);
+    }
+}
+
+
+
+
+/* Runs a span through a points kernel, a chunk at a time. The points are
+   worked out with the same sums as everywhere else, realStart + step * x, so
+   the escape times do not change. */
+static inline void spanByPoints(escapePointsKernel points,
+				const int          maxIterations,
+				const calcSettings calc,
+				const double       realStart,
+				const double       step,
+				const int          x,
+				const double       imag,
+				const int          count,
+				int               *escapes)
+{
+    double reals[POINTS_CHUNK];
+    double imags[POINTS_CHUNK];
+
+    for (int start = 0; start < count; start += POINTS_CHUNK) {
+	const int chunk = (count - start < POINTS_CHUNK) ?
+	    count - start : POINTS_CHUNK;
+
+	for (int i = 0; i < chunk; i++) {
+	    reals[i] = realStart + step * (x + start + i);
+	    imags[i] = imag;
+	}
+
+	points(maxIterations, calc, reals, imags, chunk, escapes + start);
+    }
+}
+
+
+
+
+/*
+ * Works out smooth escape times along with the normal ones. How far past the
+ * escape radius a point lands says how close it came to escaping an iteration
+ * sooner: an orbit that only just passed |z| = 2 almost lasted one iteration
+ * more, while one that reached |z| = 2^power almost escaped one iteration
+ * sooner. So the smooth time runs from one less than the normal escape time,
+ * up to the escape time itself.
+ *
+ * en.wikipedia.org/wiki/Plotting_algorithms_for_the_Mandelbrot_set -> source
+ * of the formula (the "continuous coloring" section).
+ */
+void escapeSpanSmooth(const int          maxIterations,
+		      const calcSettings calc,
+		      const double       realStart,
+		      const double       step,
+		      const int          x,
+		      const double       imag,
+		      const int          count,
+		      int               *escapes,
+		      float             *smooth)
+{
+    const orbitFunction orbit = orbitSelect(calc);
+
+    for (int i = 0; i < count; i++) {
+	tComplex c, last;
+	c.real = realStart + step * (x + i);
+	c.imag = imag;
+
+	escapes[i] = orbit(maxIterations, c, calc, &last);
+	smooth[i]  = 0;
+
+	if (escapes[i] != 0) {
+	    /* log_power(ln|z| / ln 2), which is 0 at |z| = 2 and 1 at
+	       |z| = 2^power. */
+	    const double magnitude = last.real * last.real + last.imag * last.imag;
+	    const double ratio     = log(magnitude) / log(4.0);
+	    double       fraction  = (calc.power == 2) ?
+		log2(ratio) : log(ratio) / log(calc.power);
+
+	    if (fraction > 1)
+		fraction = 1;
+
+	    smooth[i] = (float) (escapes[i] - 1 + fraction);
+	}
+    }
+}
+
+
+
+
+#if X86_KERNELS
+/*
+ * The vector kernels. Each one loads a group of points into the lanes of a
+ * vector register and iterates them all together. When a lane
+ * escapes, the current iteration count is recorded for it and the lane is
+ * masked off; the group is done once every lane is masked off or the
+ * iterations run out. Points left over at the end, too few to fill a group,
+ * go through scalarPoints.
+ *
+ * The squares of z are kept from the escape check and reused on the next
+ * iteration when squaring, which escapeOrbit works out again. They are the
+ * same products either way, so the escape times come out the same. Higher
+ * powers are multiplied out in the same order as fractalStep does.
+ *
+ * The interior checks work as in escapeOrbit. Lanes inside the main bulbs start
+ * out masked off, and since every lane of a group is on the same iteration,
+ * the whole group shares one periodicity-checking schedule.
+ */
+KERNEL_BODY TARGET_sse2 void sse2Points(const int          maxIterations,
+					const calcSettings calc,
+					const double      *reals,
+					const double      *imags,
+					const int          count,
+					int               *escapes,
+					const fractalType  fractal,
+					const int          power)
+{
+    const int     lanes = 2;
+    const __m128d four  = _mm_set1_pd(4.0);
+    const __m128d sign  = _mm_set1_pd(-0.0);
+    int           i;
+
+    for (i = 0; i + lanes <= count; i += lanes) {
+	// Loads the lanes' points.
+	const __m128d real = _mm_loadu_pd(reals + i);
+	const __m128d imag = _mm_loadu_pd(imags + i);
+
+	/* A Mandelbrot-like set starts z at 0 with each lane's own c, and a
+	   Julia set starts z at the lane's point with a shared c. */
+	__m128d zr, zi, cr, ci;
+	if (fractal != FRACTAL_JULIA) {
+	    zr = _mm_setzero_pd();
+	    zi = _mm_setzero_pd();
+	    cr = real;
+	    ci = imag;
+	} else {
+	    zr = real;
+	    zi = imag;
+	    cr = _mm_set1_pd(calc.juliaConstant.real);
+	    ci = _mm_set1_pd(calc.juliaConstant.imag);
+	}
+
+	__m128d zr2    = _mm_mul_pd(zr, zr);
+	__m128d zi2    = _mm_mul_pd(zi, zi);
+	__m128d result = _mm_setzero_pd();
+	__m128d active = _mm_cmpeq_pd(zr, zr);
+
+	// Masks off the lanes inside the main bulbs.
+	if (bulbCheck(calc, fractal, power)) {
+	    long long inside[2];
+	    for (int lane = 0; lane < lanes; lane++)
+		inside[lane] = -(long long) inMainBulbs(reals[i + lane],
+							imags[i + lane]);
+
+	    active = _mm_andnot_pd(_mm_castsi128_pd(_mm_set_epi64x(inside[1],
+								     inside[0])),
+				   active);
+	}
+
+	const int periodCheck = calc.interiorChecks & INTERIOR_PERIODICITY;
+	__m128d   savedR      = zr;
+	__m128d   savedI      = zi;
+	int       interval    = 1;
+	int       countdown   = 1;
+
+	for (int iterations = maxIterations;
+	     iterations > 0 && _mm_movemask_pd(active) != 0;
+	     iterations--) {
+	    if (power == 2) {
+		__m128d product = _mm_mul_pd(_mm_add_pd(zr, zr), zi);
+
+		if (fractal == FRACTAL_BURNING_SHIP)
+		    product = _mm_andnot_pd(sign, product);
+
+		zr = _mm_add_pd(_mm_sub_pd(zr2, zi2), cr);
+		zi = _mm_add_pd(product, ci);
+	    } else {
+		if (fractal == FRACTAL_BURNING_SHIP) {
+		    zr = _mm_andnot_pd(sign, zr);
+		    zi = _mm_andnot_pd(sign, zi);
+		}
+
+		__m128d raisedR = zr;
+		__m128d raisedI = zi;
+
+		for (int n = 1; n < power; n++) {
+		    const __m128d next = _mm_sub_pd(_mm_mul_pd(raisedR, zr),
+						    _mm_mul_pd(raisedI, zi));
+		    raisedI = _mm_add_pd(_mm_mul_pd(raisedR, zi),
+					 _mm_mul_pd(raisedI, zr));
+		    raisedR = next;
+		}
+
+		zr = _mm_add_pd(raisedR, cr);
+		zi = _mm_add_pd(raisedI, ci);
+	    }
+
+	    zr2 = _mm_mul_pd(zr, zr);
+	    zi2 = _mm_mul_pd(zi, zi);
+
+	    // Records the iteration count for lanes that just escaped.
+	    __m128d escaped = _mm_cmpge_pd(_mm_add_pd(zr2, zi2), four);
+	    escaped = _mm_and_pd(escaped, active);
+	    result  = _mm_or_pd(_mm_andnot_pd(escaped, result),
+				_mm_and_pd(escaped, _mm_set1_pd(iterations)));
+	    active  = _mm_andnot_pd(escaped, active);
+
+	    // Masks off the lanes that cycled back to their saved value.
+	    if (periodCheck) {
+		const __m128d cycled = _mm_and_pd(_mm_cmpeq_pd(zr, savedR),
+						  _mm_cmpeq_pd(zi, savedI));
+		active = _mm_andnot_pd(cycled, active);
+
+		if (--countdown == 0) {
+		    savedR    = zr;
+		    savedI    = zi;
+		    interval *= 2;
+		    countdown = interval;
+		}
+	    }
+	}
+
+	double laneResults[2];
+	_mm_storeu_pd(laneResults, result);
+	for (int lane = 0; lane < lanes; lane++)
+	    escapes[i + lane] = (int) laneResults[lane];
+    }
+
+    // Finishes off the points that did not fill a whole group.
+    scalarPoints(maxIterations, calc, reals + i, imags + i, count - i,
+		 escapes + i, fractal, power);
+}
+
+
+
+
+// Same as sse2Points, but four lanes wide.
+KERNEL_BODY TARGET_avx2 void avx2Points(const int          maxIterations,
+					const calcSettings calc,
+					const double      *reals,
+					const double      *imags,
+					const int          count,
+					int               *escapes,
+					const fractalType  fractal,
+					const int          power)
+{
+    const int     lanes = 4;
+    const __m256d four  = _mm256_set1_pd(4.0);
+    const __m256d sign  = _mm256_set1_pd(-0.0);
+    int           i;
+
+    for (i = 0; i + lanes <= count; i += lanes) {
+	// Loads the lanes' points.
+	const __m256d real = _mm256_loadu_pd(reals + i);
+	const __m256d imag = _mm256_loadu_pd(imags + i);
+
+	__m256d zr, zi, cr, ci;
+	if (fractal != FRACTAL_JULIA) {
+	    zr = _mm256_setzero_pd();
+	    zi = _mm256_setzero_pd();
+	    cr = real;
+	    ci = imag;
+	} else {
+	    zr = real;
+	    zi = imag;
+	    cr = _mm256_set1_pd(calc.juliaConstant.real);
+	    ci = _mm256_set1_pd(calc.juliaConstant.imag);
+	}
+
+	__m256d zr2    = _mm256_mul_pd(zr, zr);
+	__m256d zi2    = _mm256_mul_pd(zi, zi);
+	__m256d result = _mm256_setzero_pd();
+	__m256d active = _mm256_cmp_pd(zr, zr, _CMP_EQ_OQ);
+
+	// Masks off the lanes inside the main bulbs.
+	if (bulbCheck(calc, fractal, power)) {
+	    long long inside[4];
+	    for (int lane = 0; lane < lanes; lane++)
+		inside[lane] = -(long long) inMainBulbs(reals[i + lane],
+							imags[i + lane]);
+
+	    const __m256i insideMask = _mm256_set_epi64x(inside[3], inside[2],
+							  inside[1], inside[0]);
+	    active = _mm256_andnot_pd(_mm256_castsi256_pd(insideMask), active);
+	}
+
+	const int periodCheck = calc.interiorChecks & INTERIOR_PERIODICITY;
+	__m256d   savedR      = zr;
+	__m256d   savedI      = zi;
+	int       interval    = 1;
+	int       countdown   = 1;
+
+	for (int iterations = maxIterations;
+	     iterations > 0 && _mm256_movemask_pd(active) != 0;
+	     iterations--) {
+	    if (power == 2) {
+		__m256d product = _mm256_mul_pd(_mm256_add_pd(zr, zr), zi);
+
+		if (fractal == FRACTAL_BURNING_SHIP)
+		    product = _mm256_andnot_pd(sign, product);
+
+		zr = _mm256_add_pd(_mm256_sub_pd(zr2, zi2), cr);
+		zi = _mm256_add_pd(product, ci);
+	    } else {
+		if (fractal == FRACTAL_BURNING_SHIP) {
+		    zr = _mm256_andnot_pd(sign, zr);
+		    zi = _mm256_andnot_pd(sign, zi);
+		}
+
+		__m256d raisedR = zr;
+		__m256d raisedI = zi;
+
+		for (int n = 1; n < power; n++) {
+		    const __m256d next =
+			_mm256_sub_pd(_mm256_mul_pd(raisedR, zr),
+				      _mm256_mul_pd(raisedI, zi));
+		    raisedI = _mm256_add_pd(_mm256_mul_pd(raisedR, zi),
+					    _mm256_mul_pd(raisedI, zr));
+		    raisedR = next;
+		}
+
+		zr = _mm256_add_pd(raisedR, cr);
+		zi = _mm256_add_pd(raisedI, ci);
+	    }
+
+	    zr2 = _mm256_mul_pd(zr, zr);
+	    zi2 = _mm256_mul_pd(zi, zi);
+
+	    // Records the iteration count for lanes that just escaped.
+	    __m256d escaped = _mm256_cmp_pd(_mm256_add_pd(zr2, zi2), four,
+					    _CMP_GE_OQ);
+	    escaped = _mm256_and_pd(escaped, active);
+	    result  = _mm256_blendv_pd(result, _mm256_set1_pd(iterations),
+				       escaped);
+	    active  = _mm256_andnot_pd(escaped, active);
+
+	    // Masks off the lanes that cycled back to their saved value.
+	    if (periodCheck) {
+		const __m256d cycled =
+		    _mm256_and_pd(_mm256_cmp_pd(zr, savedR, _CMP_EQ_OQ),
+				  _mm256_cmp_pd(zi, savedI, _CMP_EQ_OQ));
+		active = _mm256_andnot_pd(cycled, active);
+
+		if (--countdown == 0) {
+		    savedR    = zr;
+		    savedI    = zi;
+		    interval *= 2;
+		    countdown = interval;
+		}
+	    }
+	}
+
+	double laneResults[4];
+	_mm256_storeu_pd(laneResults, result);
+	for (int lane = 0; lane < lanes; lane++)
+	    escapes[i + lane] = (int) laneResults[lane];
+    }
+
+    // Finishes off the points that did not fill a whole group.
+    scalarPoints(maxIterations, calc, reals + i, imags + i, count - i,
+		 escapes + i, fractal, power);
+}
+
+
+
+
+// Same as sse2Points, but eight lanes wide, with mask registers.
+KERNEL_BODY TARGET_avx512 void avx512Points(const int          maxIterations,
+					    const calcSettings calc,
+					    const double      *reals,
+					    const double      *imags,
+					    const int          count,
+					    int               *escapes,
+					    const fractalType  fractal,
+					    const int          power)
+{
+    const int     lanes = 8;
+    const __m512d four  = _mm512_set1_pd(4.0);
+    int           i;
+
+    for (i = 0; i + lanes <= count; i += lanes) {
+	// Loads the lanes' points.
+	const __m512d real = _mm512_loadu_pd(reals + i);
+	const __m512d imag = _mm512_loadu_pd(imags + i);
+
+	__m512d zr, zi, cr, ci;
+	if (fractal != FRACTAL_JULIA) {
+	    zr = _mm512_setzero_pd();
+	    zi = _mm512_setzero_pd();
+	    cr = real;
+	    ci = imag;
+	} else {
+	    zr = real;
+	    zi = imag;
+	    cr = _mm512_set1_pd(calc.juliaConstant.real);
+	    ci = _mm512_set1_pd(calc.juliaConstant.imag);
+	}
+
+	__m512d   zr2    = _mm512_mul_pd(zr, zr);
+	__m512d   zi2    = _mm512_mul_pd(zi, zi);
+	__m512d   result = _mm512_setzero_pd();
+	__mmask8  active = 0xFF;
+
+	// Masks off the lanes inside the main bulbs.
+	if (bulbCheck(calc, fractal, power)) {
+	    for (int lane = 0; lane < lanes; lane++)
+		if (inMainBulbs(reals[i + lane], imags[i + lane]))
+		    active &= ~(1 << lane);
+	}
+
+	const int periodCheck = calc.interiorChecks & INTERIOR_PERIODICITY;
+	__m512d   savedR      = zr;
+	__m512d   savedI      = zi;
+	int       interval    = 1;
+	int       countdown   = 1;
+
+	for (int iterations = maxIterations;
+	     iterations > 0 && active != 0;
+	     iterations--) {
+	    if (power == 2) {
+		__m512d product = _mm512_mul_pd(_mm512_add_pd(zr, zr), zi);
+
+		if (fractal == FRACTAL_BURNING_SHIP)
+		    product = _mm512_abs_pd(product);
+
+		zr = _mm512_add_pd(_mm512_sub_pd(zr2, zi2), cr);
+		zi = _mm512_add_pd(product, ci);
+	    } else {
+		if (fractal == FRACTAL_BURNING_SHIP) {
+		    zr = _mm512_abs_pd(zr);
+		    zi = _mm512_abs_pd(zi);
+		}
+
+		__m512d raisedR = zr;
+		__m512d raisedI = zi;
+
+		for (int n = 1; n < power; n++) {
+		    const __m512d next =
+			_mm512_sub_pd(_mm512_mul_pd(raisedR, zr),
+				      _mm512_mul_pd(raisedI, zi));
+		    raisedI = _mm512_add_pd(_mm512_mul_pd(raisedR, zi),
+					    _mm512_mul_pd(raisedI, zr));
+		    raisedR = next;
+		}
+
+		zr = _mm512_add_pd(raisedR, cr);
+		zi = _mm512_add_pd(raisedI, ci);
+	    }
+
+	    zr2 = _mm512_mul_pd(zr, zr);
+	    zi2 = _mm512_mul_pd(zi, zi);
+
+	    // Records the iteration count for lanes that just escaped.
+	    const __mmask8 escaped =
+		_mm512_mask_cmp_pd_mask(active, _mm512_add_pd(zr2, zi2), four,
+					_CMP_GE_OQ);
+	    result = _mm512_mask_blend_pd(escaped, result,
+					  _mm512_set1_pd(iterations));
+	    active = active & ~escaped;
+
+	    // Masks off the lanes that cycled back to their saved value.
+	    if (periodCheck) {
+		active &= ~(_mm512_cmp_pd_mask(zr, savedR, _CMP_EQ_OQ) &
+			    _mm512_cmp_pd_mask(zi, savedI, _CMP_EQ_OQ));
+
+		if (--countdown == 0) {
+		    savedR    = zr;
+		    savedI    = zi;
+		    interval *= 2;
+		    countdown = interval;
+		}
+	    }
+	}
+
+	double laneResults[8];
+	_mm512_storeu_pd(laneResults, result);
+	for (int lane = 0; lane < lanes; lane++)
+	    escapes[i + lane] = (int) laneResults[lane];
+    }
+
+    // Finishes off the points that did not fill a whole group.
+    scalarPoints(maxIterations, calc, reals + i, imags + i, count - i,
+		 escapes + i, fractal, power);
+}
+#endif // X86_KERNELS
+
+
+
+
+/* Compiles a points kernel and a span kernel from the bodies above, for one
+   instruction set, fractal type and power. */
+#define DEFINE_KERNELS(isa, fractal, name, power)                          \
+    TARGET_##isa                                                           \
+    static void escapePoints_##isa##_##name##power(                        \
+	const int          maxIterations,                                  \
+	const calcSettings calc,                                           \
+	const double      *reals,                                          \
+	const double      *imags,                                          \
+	const int          count,                                          \
+	int               *escapes)                                        \
+    {                                                                      \
+	isa##Points(maxIterations, calc, reals, imags, count, escapes,     \
+		    fractal, power);                                       \
+    }                                                                      \
+									   \
+    static void escapeSpan_##isa##_##name##power(                          \
+	const int          maxIterations,                                  \
+	const calcSettings calc,                                           \
+	const double       realStart,                                      \
+	const double       step,                                           \
+	const int          x,                                              \
+	const double       imag,                                           \
+	const int          count,                                          \
+	int               *escapes)                                        \
+    {                                                                      \
+	spanByPoints(escapePoints_##isa##_##name##power, maxIterations,    \
+		     calc, realStart, step, x, imag, count, escapes);      \
+    }
+
+FOR_EACH_KERNEL(DEFINE_KERNELS, scalar)
+#if X86_KERNELS
+FOR_EACH_KERNEL(DEFINE_KERNELS, sse2)
+FOR_EACH_KERNEL(DEFINE_KERNELS, avx2)
+FOR_EACH_KERNEL(DEFINE_KERNELS, avx512)
+#endif
+
+
+
+
+// The kernels of each instruction set, by fractal type and power.
+typedef struct {
+    escapeSpanKernel   span;
+    escapePointsKernel points;
+} kernelEntry;
+
+#define KERNEL_ENTRY(isa, fractal, name, power)  \
+    [fractal][power - 2] = {escapeSpan_##isa##_##name##power, \
+			    escapePoints_##isa##_##name##power},
+
+static const kernelEntry
+kernels[KERNEL_AVX512 + 1][FRACTAL_TYPES][FRACTAL_POWER_MAX - 1] = {
+    [KERNEL_SCALAR] = {FOR_EACH_KERNEL(KERNEL_ENTRY, scalar)},
+#if X86_KERNELS
+    [KERNEL_SSE2]   = {FOR_EACH_KERNEL(KERNEL_ENTRY, sse2)},
+    [KERNEL_AVX2]   = {FOR_EACH_KERNEL(KERNEL_ENTRY, avx2)},
+    [KERNEL_AVX512] = {FOR_EACH_KERNEL(KERNEL_ENTRY, avx512)}
+#endif
+};
+
+
+
+
+/* Asks the CPU whether it has the instructions a kernel needs. Off x86, the
+   vector kernels were never built, so only the scalar ones are there. */
+int escapeKernelSupported(const kernelType kernel)
+{
+    switch (kernel) {
+    case KERNEL_AUTO:
+    case KERNEL_SCALAR:
+	return 1;
+
+#if X86_KERNELS
+    case KERNEL_SSE2:
+	return __builtin_cpu_supports("sse2") != 0;
+
+    case KERNEL_AVX2:
+	return __builtin_cpu_supports("avx2") != 0;
+
+    case KERNEL_AVX512:
+	return __builtin_cpu_supports("avx512f") != 0;
+#else
+    default:
+	return 0;
+#endif
+    }
+
+    return 0;
+}
+
+
+
+
+// Goes through the kernels from widest to narrowest.
+kernelType escapeKernelBest(void)
+{
+    if (escapeKernelSupported(KERNEL_AVX512))
+	return KERNEL_AVX512;
+
+    if (escapeKernelSupported(KERNEL_AVX2))
+	return KERNEL_AVX2;
+
+    if (escapeKernelSupported(KERNEL_SSE2))
+	return KERNEL_SSE2;
+
+    return KERNEL_SCALAR;
+}
+
+
+
+
+// Looks up the kernels for the settings' instruction set, fractal and power.
+static const kernelEntry *kernelLookup(const calcSettings calc)
+{
+    kernelType kernel = calc.kernel;
+    if (kernel == KERNEL_AUTO)
+	kernel = escapeKernelBest();
+
+    return &kernels[kernel][calc.fractal][calc.power - 2];
+}
+
+
+
+
+// Matches the settings to a kernel function.
+escapeSpanKernel escapeKernelSelect(const calcSettings calc)
+{
+    if (calc.deepZoom)
+	return escapeSpan_perturbation;
+
+    return kernelLookup(calc)->span;
+}
+
+
+
+
+// Matches the settings to a points kernel, the same way as escapeKernelSelect.
+escapePointsKernel escapePointsSelect(const calcSettings calc)
+{
+    if (calc.deepZoom)
+	return escapePoints_perturbation;
+
+    return kernelLookup(calc)->points;
+}
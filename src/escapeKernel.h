@@ -0,0 +1,95 @@
+/*
+ * Escape-time kernels, part of an exercise program that draws mandelbrot sets.
+ *
+ * Besides the plain one-point-at-a-time escapeTime, this module has vector
+ * kernels that iterate a whole group of points at once with SSE2, AVX2 or
+ * AVX-512. Which of them can be used is decided while the program runs, by
+ * asking the CPU what it supports.
+ *
+ * Every kernel gives exactly the same escape times as escapeTime. They do the
+ * same floating-point operations in the same order, just several at a time.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef ESCAPE_KERNEL_MODULE
+#define ESCAPE_KERNEL_MODULE
+
+#include "mandelbrotRender.h"
+
+
+
+// Finds out how many iterations it takes for a single point to diverge.
+int escapeTime(const int maxIterations, const tComplex c, calcSettings calc);
+
+
+
+/*
+ * A kernel that finds the escape times of a span of points on one row of the
+ * image. Point i of the span lies at
+ *
+ *     (realStart + step * (x + i)) + (imag)i
+ *
+ * which is the same mapping the renderers use for single pixels. The escape
+ * times are written to escapes[0] through escapes[count - 1].
+ */
+typedef void (*escapeSpanKernel)(const int          maxIterations,
+				 const calcSettings calc,
+				 const double       realStart,
+				 const double       step,
+				 const int          x,
+				 const double       imag,
+				 const int          count,
+				 int               *escapes);
+
+
+
+/*
+ * A kernel that finds the escape times of any points at all, the i-th one
+ * being (real[i]) + (imag[i])i. Used where the points needed do not lie along
+ * a row, such as the columns and edges the fill modes work out. Gives the
+ * same escape times as a span kernel would for the same points.
+ */
+typedef void (*escapePointsKernel)(const int          maxIterations,
+				   const calcSettings calc,
+				   const double      *real,
+				   const double      *imag,
+				   const int          count,
+				   int               *escapes);
+
+
+
+/* Like a span kernel, but also works out smooth (fractional) escape times, for
+   coloring without bands. Always runs one point at a time, and does not work
+   in deep-zoom mode. The whole-number escape times are the same as any other
+   kernel's. */
+void escapeSpanSmooth(const int          maxIterations,
+		      const calcSettings calc,
+		      const double       realStart,
+		      const double       step,
+		      const int          x,
+		      const double       imag,
+		      const int          count,
+		      int               *escapes,
+		      float             *smooth);
+
+
+
+// Checks whether the running CPU can use a kernel. Returns 1 if so, 0 if not.
+int escapeKernelSupported(const kernelType kernel);
+
+// Picks the fastest kernel the running CPU supports.
+kernelType escapeKernelBest(void);
+
+/* Gets the span kernel for the calculation settings: the deep-zoom kernel in
+   deep-zoom mode, or else the one for calc.kernel, with KERNEL_AUTO picking
+   the best one. The kernel must be supported by the CPU. */
+escapeSpanKernel escapeKernelSelect(const calcSettings calc);
+
+// Gets the points kernel for the calculation settings, in the same way.
+escapePointsKernel escapePointsSelect(const calcSettings calc);
+
+#endif // ESCAPE_KERNEL_MODULE
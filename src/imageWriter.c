@@ -0,0 +1,235 @@
+/*
+ * Image output, part of an exercise program that draws mandelbrot sets.
+ *
+ * This module only hands each job off to the module of the format being
+ * written. How images are written in segments is explained in
+ * 'imageWriter.h'.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "imageWriter.h"
+
+#include <stdlib.h>
+#include "qoi.h"
+
+
+
+
+// Picks the extension of a format.
+const char *imageFormatExtension(const imageFormat format)
+{
+    switch (format) {
+    case IMAGE_QOI:
+	return "qoi";
+    case IMAGE_PNG:
+	return "png";
+    default:
+	return "tga";
+    }
+}
+
+
+
+
+// Fits as many rows as it can in IMAGE_SEGMENT_BYTES.
+int imageSegmentRows(const int width)
+{
+    const size_t rowBytes = 3 * (size_t) width;
+
+    return (rowBytes >= IMAGE_SEGMENT_BYTES) ?
+	1 : (int) (IMAGE_SEGMENT_BYTES / rowBytes);
+}
+
+
+
+
+// Looks up the worst case of the format.
+size_t imageSegmentBytes(const imageFormat format,
+			 const int         width,
+			 const int         rows)
+{
+    switch (format) {
+    case IMAGE_TGA_RLE:
+	return TARGA_RLE_ROW_BYTES(width) * rows;
+    case IMAGE_QOI:
+	return QOI_SEGMENT_BYTES(width, rows);
+    case IMAGE_PNG:
+	return PNG_SEGMENT_BYTES(width, rows);
+    default:
+	return 3 * (size_t) width * rows;
+    }
+}
+
+
+
+
+// Only PNG needs anything more than the bytes it encodes into.
+int imageWorkspaceAllocate(imageWorkspace   *workspace,
+			   const imageFormat format,
+			   const int         width,
+			   const int         rows)
+{
+    workspace->format = format;
+
+    if (format == IMAGE_PNG)
+	return pngWorkspaceAllocate(&workspace->png, width, rows);
+
+    return 0;
+}
+
+
+
+
+// Frees the memory of a workspace.
+void imageWorkspaceFree(imageWorkspace *workspace)
+{
+    if (workspace->format == IMAGE_PNG)
+	pngWorkspaceFree(&workspace->png);
+}
+
+
+
+
+// Encodes a segment in the format of the workspace.
+imageSegment imageEncodeSegment(const tRGB     *pixels,
+				const int       width,
+				const int       rows,
+				imageWorkspace *workspace,
+				unsigned char  *bytes)
+{
+    imageSegment segment = {0, rows, 1};
+
+    switch (workspace->format) {
+    case IMAGE_TGA:
+	for (int y = 0; y < rows; y++)
+	    targaPackRow_RGB24(pixels + (size_t) y * width, width,
+			       bytes + (size_t) y * width * 3);
+
+	segment.length = 3 * (size_t) width * rows;
+	break;
+
+    case IMAGE_TGA_RLE:
+	// Every row is encoded on its own anyway.
+	for (int y = 0; y < rows; y++)
+	    segment.length += targaPackRow_RLE24(pixels + (size_t) y * width,
+						 width, bytes + segment.length);
+	break;
+
+    case IMAGE_QOI:
+	segment.length = qoiPackSegment(pixels, width, rows, bytes);
+	break;
+
+    case IMAGE_PNG:
+	segment.length = pngPackSegment(pixels, width, rows, &workspace->png,
+					bytes, &segment.adler);
+	break;
+    }
+
+    return segment;
+}
+
+
+
+
+// Writes the header of the format.
+void imageWriterStart(imageWriter      *writer,
+		      const imageFormat format,
+		      const int         width,
+		      const int         height,
+		      FILE             *file)
+{
+    writer->format = format;
+    writer->width  = width;
+    writer->height = height;
+    writer->adler  = 1; // The check of no bytes at all.
+    writer->file   = file;
+
+    switch (format) {
+    case IMAGE_TGA:
+	targaWriteHeader_RGB24(width, height, TARGA_RAW, file);
+	break;
+    case IMAGE_TGA_RLE:
+	targaWriteHeader_RGB24(width, height, TARGA_RLE, file);
+	break;
+    case IMAGE_QOI:
+	qoiWriteHeader(width, height, file);
+	break;
+    case IMAGE_PNG:
+	pngWriteHeader(width, height, file);
+	break;
+    }
+}
+
+
+
+
+/* Writes a segment out. PNG also carries its check on through the rows of the
+   segment. */
+void imageWriteSegment(imageWriter         *writer,
+		       const imageSegment  *segment,
+		       const unsigned char *bytes)
+{
+    fwrite(bytes, 1, segment->length, writer->file);
+
+    if (writer->format == IMAGE_PNG)
+	writer->adler = pngAdlerCombine(writer->adler, segment->adler,
+					PNG_FILTERED_BYTES(writer->width,
+							   segment->rows));
+}
+
+
+
+
+// Writes the end of the format. TARGA images just stop.
+void imageWriterFinish(imageWriter *writer)
+{
+    if (writer->format == IMAGE_QOI)
+	qoiWriteEnd(writer->file);
+    else if (writer->format == IMAGE_PNG)
+	pngWriteEnd(writer->adler, writer->file);
+}
+
+
+
+
+// Encodes the image a segment at a time, into a single buffer.
+int imageWritePixels(const imageFormat format,
+		     const tRGB       *pixels,
+		     const int         width,
+		     const int         height,
+		     FILE             *file)
+{
+    const int      segmentRows = imageSegmentRows(width);
+    imageWorkspace workspace;
+    imageWriter    writer;
+
+    if (imageWorkspaceAllocate(&workspace, format, width, segmentRows) != 0)
+	return 1;
+
+    unsigned char *bytes = malloc(imageSegmentBytes(format, width,
+						    segmentRows));
+    if (bytes == NULL) {
+	imageWorkspaceFree(&workspace);
+	return 1;
+    }
+
+    imageWriterStart(&writer, format, width, height, file);
+
+    for (int y = 0; y < height; y += segmentRows) {
+	const int rows = (height - y < segmentRows) ? height - y : segmentRows;
+	const imageSegment segment = imageEncodeSegment(
+	    pixels + (size_t) y * width, width, rows, &workspace, bytes);
+
+	imageWriteSegment(&writer, &segment, bytes);
+    }
+
+    imageWriterFinish(&writer);
+    free(bytes);
+    imageWorkspaceFree(&workspace);
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Image output, part of an exercise program that draws mandelbrot sets.
+ *
+ * The renderers can save their images in a few formats, which this module
+ * puts behind one interface. Every format is written the same way: a header,
+ * then the rows of the image in segments, top to bottom, then an end. Each
+ * segment is a run of whole rows, encoded on its own, so segments can be
+ * encoded by different threads at once, into memory, and just have to be
+ * written out in order. What each format does to keep its segments apart is
+ * explained in its own module.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef IMAGE_WRITER_MODULE
+#define IMAGE_WRITER_MODULE
+
+#include <stdio.h>
+#include <stdint.h>
+#include "targa.h"
+#include "png.h"
+
+
+
+/* Rough size of the pixels in a segment, when the caller gets to choose. The
+   compressed formats find less to squeeze in short segments. */
+#define IMAGE_SEGMENT_BYTES (256 * 1024)
+
+
+
+// The formats images can be saved in.
+typedef enum {
+    IMAGE_TGA = 0, // TARGA, uncompressed.
+    IMAGE_TGA_RLE, // TARGA, run-length encoded.
+    IMAGE_QOI,     // QOI. Quick to encode, and nearly as small as PNG.
+    IMAGE_PNG      // PNG. Read by everything.
+} imageFormat;
+
+
+
+// An encoded segment of rows, as imageEncodeSegment leaves it.
+typedef struct {
+    size_t   length; // Bytes it took.
+    int      rows;
+    uint32_t adler;  // PNG only: the check of its filtered rows.
+} imageSegment;
+
+
+
+// Scratch space for encoding segments. Each thread needs its own.
+typedef struct {
+    imageFormat  format;
+    pngWorkspace png;
+} imageWorkspace;
+
+
+
+// An image being written out, segment by segment.
+typedef struct {
+    imageFormat format;
+    int         width;
+    int         height;
+    uint32_t    adler; // PNG only: the check of every filtered row so far.
+    FILE       *file;
+} imageWriter;
+
+
+
+// The usual file name extension of a format, without the dot.
+const char *imageFormatExtension(const imageFormat format);
+
+/* Rows to put in a segment of an image this wide, for about
+   IMAGE_SEGMENT_BYTES of pixels. Never less than one. */
+int imageSegmentRows(const int width);
+
+// Most bytes a segment of rows can take once encoded.
+size_t imageSegmentBytes(const imageFormat format,
+			 const int         width,
+			 const int         rows);
+
+/* Tools for creating a workspace, for segments of up to the given number of
+   rows. Allocation returns 1 on failure. */
+int  imageWorkspaceAllocate(imageWorkspace   *workspace,
+			    const imageFormat format,
+			    const int         width,
+			    const int         rows);
+void imageWorkspaceFree(imageWorkspace *workspace);
+
+/* Encodes a segment of rows, width pixels wide and one after another, into
+   bytes, which must have room for imageSegmentBytes of them. */
+imageSegment imageEncodeSegment(const tRGB     *pixels,
+				const int       width,
+				const int       rows,
+				imageWorkspace *workspace,
+				unsigned char  *bytes);
+
+/*
+ * Tools for writing an image out: starting writes the header, and finishing
+ * writes the end, once every segment has been written in order. Write errors
+ * are left for the caller to find, as with the TARGA tools.
+ */
+void imageWriterStart(imageWriter      *writer,
+		      const imageFormat format,
+		      const int         width,
+		      const int         height,
+		      FILE             *file);
+void imageWriteSegment(imageWriter         *writer,
+		       const imageSegment  *segment,
+		       const unsigned char *bytes);
+void imageWriterFinish(imageWriter *writer);
+
+/* Writes a whole image held in memory, a segment at a time, on the calling
+   thread. Returns 1 if memory could not be allocated. */
+int imageWritePixels(const imageFormat format,
+		     const tRGB       *pixels,
+		     const int         width,
+		     const int         height,
+		     FILE             *file);
+
+#endif // IMAGE_WRITER_MODULE
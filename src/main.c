@@ -17,14 +17,42 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/stat.h>
 #include "mandelbrotRender.h"
+#include "targa.h"
+#include "escapeKernel.h"
+#include "bigFixed.h"
+#include "renderOptions.h"
 
 // For whenever the version number is mentioned by the program.
 #define MANDELBROT_VERSION_NUMBER 18
 #define MANDELBROT_VERSION_DATE   "2017-05-06"
 
-// Name of the file that the output is saved to.
-#define FILENAME "mandelbrot.tga"
+/* Name of the file that the output is saved to, unless -O names one: a base
+   name, with the extension of its format. The name "-" is standard output. */
+#define FILENAME      "%s.%s"
+#define FILENAME_BASE "mandelbrot"
+#define STREAM_NAME   "-"
+
+/* Names of the preview images of progressive rendering, numbered by pass, and
+   the most passes allowed (the first then draws 1 pixel in 128 across). */
+#define PREVIEW_FILENAME "%s.pass%d.%s"
+#define PASSES_MAX       8
+
+// Names of the frames of an animation, numbered from 0.
+#define FRAME_FILENAME "%s.frame%05d.%s"
+
+/* Names of the thumbnails of a Julia atlas saved with -S, numbered from 0, and
+   the most thumbnails an atlas can have. */
+#define THUMBNAIL_FILENAME "%s.julia%05d.%s"
+#define ATLAS_COUNT_MAX    (1 << 20)
+
+/* Names of the tiles of a pyramid, by level, column and row, inside the
+   directory named by -O, and of each tile while it is being written. */
+#define TILE_FILENAME         "%s/%d/%d/%d.%s"
+#define TILE_PARTIAL_FILENAME "%s/%d/%d/%d.%s.part"
 
 
 
@@ -32,24 +60,1559 @@
 // Seperated out for cleanliness.
 void helpMenu()
 {
-    printf(
-	"Usage:\n"
-	"    mandelbrot [options] width height\n"
-	"Available options:\n"
-	"        -z : Zoom level.\n"
-	"        -x : Real part of the graph center.\n"
-	"        -y : Imaginary part of the graph center.\n"
-	"        -i : Max iteration count.\n"
-	"        -o : Hue offset.\n"
-	"        -l : Hue limiter.\n"
-	"        -m : Low memory mode (write straight to disk).\n"
-	"        -t : Threadcount (overrides lowmem).\n"
-	"        -c : Sets a constant brightness value. If set to 0:\n"
-	"            -b : Maximum brightness (on a scale of 0 to 1).\n"
-	"            -d : Distribution of light (higher -> more spread out).\n"
-	"        -v : Version number.\n"
-	"        -h : Invokes this help menu.\n"
-	);
+    printf(
+	"Usage:\n"
+	"    mandelbrot [options] width height\n"
+	"    mandelbrot [color options] -u escapefile\n"
+	"    mandelbrot [color options] -u mapfile -a frames [-Z zoom] width height\n"
+	"Available options:\n"
+	"        -z : Zoom level.\n"
+	"        -x : Real part of the graph center.\n"
+	"        -y : Imaginary part of the graph center.\n"
+	"        -i : Max iteration count.\n"
+	"        -o : Hue offset.\n"
+	"        -l : Hue limiter.\n"
+	"        -m : Low memory mode (write straight to disk).\n"
+	"        -t : Threadcount (with -m, streams bands to disk).\n"
+	"        -M : Memory-mapped output (threads write into the file).\n"
+	"        -s : Print per-thread render statistics.\n"
+	"        -k : Escape-time kernel (auto, scalar, sse2, avx2, avx512).\n"
+	"        -T : Fractal (mandelbrot, julia, ship).\n"
+	"        -P : Power z is raised to (2 to 8). Multibrot sets, past 2.\n"
+	"        -w : Output write buffer size, in megabytes.\n"
+	"        -F : Output format (tga, rle, qoi, png, tiff). tiff has no size limit.\n"
+	"        -O : Output file, or - for standard output.\n"
+	"        -e : Interior checks (all, bulbs, period, none).\n"
+	"        -p : Deep-zoom mode, for zoom levels past about 1e13.\n"
+	"        -f : Smooth coloring (fractional escape times).\n"
+	"        -r : Also save the raw escape times to this file.\n"
+	"        -u : Recolor escape times saved with -r (no size needed).\n"
+	"        -g : Solid-region fill (subdivide, trace, none).\n"
+	"        -n : Progressive passes, each saved as a preview image.\n"
+	"        -A : Supersampling, on this size of grid, for pixels on edges.\n"
+	"        -q : Exponential map, for rebuilding zooms with -u and -a.\n"
+	"        -J : Julia atlas, of a grid of constants (r0,i0,r1,i1,cols,rows)\n"
+	"             or a file listing them. Width and height are each one's.\n"
+	"            -S : Save each thumbnail to its own numbered file.\n"
+	"        -G : Tile pyramid, of levels (min,max), or of the tiles of them\n"
+	"             over a region (min,max,x0,y0,x1,y1), saved as dir/z/x/y\n"
+	"             in -O's directory. Width and height are each tile's.\n"
+	"        -a : Zoom animation, with this many frames. Ends at:\n"
+	"            -X : Real part of the last frame's center.\n"
+	"            -Y : Imaginary part of the last frame's center.\n"
+	"            -Z : Zoom level of the last frame.\n"
+	"        -c : Sets a constant brightness value. If set to 0:\n"
+	"            -b : Maximum brightness (on a scale of 0 to 1).\n"
+	"            -d : Distribution of light (higher -> more spread out).\n"
+	"        -v : Version number.\n"
+	"        -h : Invokes this help menu.\n"
+	);
+}
+
+
+
+
+/* Opens an image to write to, which for the name "-" is standard output, so
+   that it can be piped straight into another program. */
+FILE *openOutput(const char *name, const char *mode)
+{
+    if (strcmp(name, STREAM_NAME) == 0)
+	return stdout;
+
+    return fopen(name, mode);
+}
+
+
+
+
+/* Closes an image, which is the last chance to find write errors. Standard
+   output is only flushed, as the next frame of an animation may follow it.
+   Returns 1 if anything failed to be written. */
+int closeOutput(FILE *file)
+{
+    if (file == stdout)
+	return fflush(file) != 0 || ferror(file);
+
+    return fclose(file) != 0;
+}
+
+
+
+
+/* Reads escape times saved with -r, for -u. Returns the program's exit status,
+   which is 0 if they were read. */
+int readEscapes(const char *escapeFileName, tEscapeBuffer *escapes)
+{
+    FILE *escapeFile = fopen(escapeFileName, "rb");
+
+    if (escapeFile == NULL) {
+	fprintf(
+	    stderr,
+	    "Error: Could not open the escape time file (-u).\n"
+	    );
+
+	return 3;
+    }
+
+    const int readStatus = escapeBufferRead(escapes, escapeFile);
+    fclose(escapeFile);
+
+    if (readStatus != 0) {
+	fprintf(
+	    stderr,
+	    "Error: \"%s\" is not a readable escape time file (-u).\n",
+	    escapeFileName
+	    );
+
+	return 3;
+    }
+
+    return 0;
+}
+
+
+
+
+/* Reads escape times saved with -r, and colors them into the image of the
+   given name, in the given format. Returns the program's exit status. */
+int recolorEscapes(const char         *escapeFileName,
+		   const char         *imageName,
+		   const colorSettings color,
+		   const imageFormat   format,
+		   const int           threadCount)
+{
+    tEscapeBuffer escapes;
+    const int     readStatus = readEscapes(escapeFileName, &escapes);
+
+    if (readStatus != 0)
+	return readStatus;
+
+    if (escapes.width > TARGA_SIZE_MAX || escapes.height > TARGA_SIZE_MAX) {
+	fprintf(
+	    stderr,
+	    "Error: These escape times are too big for an image (-u).\n"
+	    );
+	escapeBufferDeallocate(&escapes);
+
+	return 1;
+    }
+
+    FILE *imageFile = openOutput(imageName, "wb");
+
+    if (imageFile == NULL) {
+	fprintf(
+	    stderr,
+	    "Error: Could not open \"%s\" (-O).\n",
+	    imageName
+	    );
+	escapeBufferDeallocate(&escapes);
+
+	return 3;
+    }
+
+    const int status = colorizeToTarga(&escapes, color, format, threadCount,
+				       imageFile);
+    const int closeStatus = closeOutput(imageFile);
+    escapeBufferDeallocate(&escapes);
+
+    if (status != 0) {
+	fprintf(
+	    stderr,
+	    "Error: Could not allocate memory for recoloring.\n"
+	    );
+
+	return 2;
+    }
+
+    if (closeStatus != 0) {
+	fprintf(
+	    stderr,
+	    "Error: Could not write the image.\n"
+	    );
+
+	return 3;
+    }
+
+    return 0;
+}
+
+
+
+
+/* What openFrame needs to name the frames, and where it and closeFrame note
+   down any failure. With a base name of "-", every frame goes to standard
+   output, one after another. The thumbnails of an atlas, and the tiles of a
+   pyramid, use it too. */
+typedef struct {
+    imageFormat format;
+    const char *base;
+    int         status;
+} frameContext;
+
+
+
+
+// Opens the file for a frame of an animation, noting down any failure.
+FILE *openFrame(void *context, const int frame)
+{
+    frameContext *frames = context;
+    char          name[strlen(frames->base) + sizeof FRAME_FILENAME + 16];
+
+    if (strcmp(frames->base, STREAM_NAME) == 0)
+	return stdout;
+
+    snprintf(name, sizeof name, FRAME_FILENAME, frames->base, frame,
+	     imageFormatExtension(frames->format));
+
+    FILE *frameFile = fopen(name, "wb");
+
+    if (frameFile == NULL)
+	frames->status = 1;
+
+    return frameFile;
+}
+
+
+
+
+// Closes the file of a finished frame, which is the last chance to find errors.
+void closeFrame(void *context, const int frame, FILE *frameFile)
+{
+    frameContext *frames = context;
+
+    (void) frame;
+
+    if (closeOutput(frameFile) != 0)
+	frames->status = 1;
+}
+
+
+
+
+/*
+ * Reads the Julia constants of an atlas, for -J. The spec is either a grid of
+ * them, "real0,imag0,real1,imag1,columns,rows", swept evenly from the first
+ * corner to the second, or the name of a file listing them (or "-" for
+ * standard input), a real and an imaginary part for each. A list is packed
+ * into a square-ish atlas. Returns the program's exit status, which is 0 if
+ * they were read.
+ */
+int readJuliaConstants(const char *spec,
+		       tComplex  **constants,
+		       int        *count,
+		       int        *columns)
+{
+    tComplex first, last;
+    int      rows, length;
+
+    *constants = NULL;
+    *count     = 0;
+
+    if (sscanf(spec, "%lf,%lf,%lf,%lf,%d,%d%n", &first.real, &first.imag,
+	       &last.real, &last.imag, columns, &rows, &length) == 6 &&
+	spec[length] == '\0') {
+	if (*columns < 1 || rows < 1 ||
+	    (long) *columns * rows > ATLAS_COUNT_MAX) {
+	    fprintf(
+		stderr,
+		"Error: A grid of Julia constants (-J) must have from 1 to "
+		"%d of them.\n",
+		ATLAS_COUNT_MAX
+		);
+
+	    return 1;
+	}
+
+	*count     = *columns * rows;
+	*constants = malloc(*count * sizeof **constants);
+
+	if (*constants == NULL) {
+	    fprintf(
+		stderr,
+		"Error: Could not allocate memory for the Julia constants.\n"
+		);
+
+	    return 2;
+	}
+
+	// Goes across the columns by real part, and down the rows by imaginary.
+	for (int y = 0; y < rows; y++) {
+	    for (int x = 0; x < *columns; x++) {
+		tComplex *constant = &(*constants)[y * *columns + x];
+
+		constant->real = (*columns > 1) ? first.real +
+		    (last.real - first.real) * x / (*columns - 1) : first.real;
+		constant->imag = (rows > 1) ? first.imag +
+		    (last.imag - first.imag) * y / (rows - 1) : first.imag;
+	    }
+	}
+
+	return 0;
+    }
+
+    FILE *listFile = (strcmp(spec, STREAM_NAME) == 0) ?
+	stdin : fopen(spec, "r");
+
+    if (listFile == NULL) {
+	fprintf(
+	    stderr,
+	    "Error: \"%s\" (-J) is neither a grid of Julia constants nor a "
+	    "file listing them.\n",
+	    spec
+	    );
+
+	return 3;
+    }
+
+    // The list grows by doubling, as its length is not known until the end.
+    int      capacity = 0;
+    int      scanned;
+    tComplex constant;
+
+    while ((scanned = fscanf(listFile, "%lf %lf", &constant.real,
+			     &constant.imag)) == 2 &&
+	   *count < ATLAS_COUNT_MAX) {
+	if (*count == capacity) {
+	    capacity = (capacity > 0) ? 2 * capacity : 256;
+
+	    tComplex *grown = realloc(*constants, capacity * sizeof *grown);
+
+	    if (grown == NULL) {
+		fprintf(
+		    stderr,
+		    "Error: Could not allocate memory for the Julia "
+		    "constants.\n"
+		    );
+		free(*constants);
+		if (listFile != stdin)
+		    fclose(listFile);
+
+		return 2;
+	    }
+
+	    *constants = grown;
+	}
+
+	(*constants)[(*count)++] = constant;
+    }
+
+    const int readError = ferror(listFile);
+
+    if (listFile != stdin)
+	fclose(listFile);
+
+    if (scanned != EOF || readError || *count == 0) {
+	fprintf(
+	    stderr,
+	    "Error: \"%s\" is not a list of 1 to %d Julia constants (-J).\n",
+	    spec,
+	    ATLAS_COUNT_MAX
+	    );
+	free(*constants);
+
+	return 3;
+    }
+
+    // Packs the list into as many columns as it has rows, or one fewer.
+    *columns = (int) ceil(sqrt(*count));
+
+    return 0;
+}
+
+
+
+
+// Opens the file for a thumbnail of an atlas, noting down any failure.
+FILE *openThumbnail(void *context, const int index)
+{
+    frameContext *thumbnails = context;
+    char          name[strlen(thumbnails->base) + sizeof THUMBNAIL_FILENAME +
+		       16];
+
+    snprintf(name, sizeof name, THUMBNAIL_FILENAME, thumbnails->base, index,
+	     imageFormatExtension(thumbnails->format));
+
+    FILE *thumbnailFile = fopen(name, "wb");
+
+    // Every rendering thread opens thumbnails, so this has to be atomic.
+    if (thumbnailFile == NULL) {
+	#pragma omp atomic write
+	thumbnails->status = 1;
+    }
+
+    return thumbnailFile;
+}
+
+
+
+
+// Closes the file of a finished thumbnail, noting down any write errors.
+void closeThumbnail(void *context, const int index, FILE *thumbnailFile)
+{
+    frameContext *thumbnails = context;
+
+    (void) index;
+
+    if (fclose(thumbnailFile) != 0) {
+	#pragma omp atomic write
+	thumbnails->status = 1;
+    }
+}
+
+
+
+
+/* Reads the levels of a tile pyramid, for -G, and the region it covers, if
+   any. Returns 1 if the spec is not "min,max" or "min,max,x0,y0,x1,y1". */
+int readPyramidLevels(const char *spec, pyramidSettings *pyramid)
+{
+    int length = 0;
+
+    pyramid->bounded = 0;
+
+    if (sscanf(spec, "%d,%d,%lf,%lf,%lf,%lf%n", &pyramid->minLevel,
+	       &pyramid->maxLevel, &pyramid->regionStart.real,
+	       &pyramid->regionStart.imag, &pyramid->regionEnd.real,
+	       &pyramid->regionEnd.imag, &length) == 6 &&
+	spec[length] == '\0')
+	pyramid->bounded = 1;
+    else if (sscanf(spec, "%d,%d%n", &pyramid->minLevel, &pyramid->maxLevel,
+		    &length) != 2 || spec[length] != '\0')
+	return 1;
+
+    return pyramid->minLevel < 0 || pyramid->minLevel > pyramid->maxLevel ||
+	pyramid->maxLevel > PYRAMID_LEVEL_MAX;
+}
+
+
+
+
+// Checks whether a tile of a pyramid was finished by an earlier run.
+int tileExists(void *context, const int level, const int x, const int y)
+{
+    frameContext *tiles = context;
+    char          name[strlen(tiles->base) + sizeof TILE_FILENAME + 48];
+    struct stat   status;
+
+    snprintf(name, sizeof name, TILE_FILENAME, tiles->base, level, x, y,
+	     imageFormatExtension(tiles->format));
+
+    return stat(name, &status) == 0;
+}
+
+
+
+
+/* Opens the file for a tile of a pyramid, making its directories if they are
+   not there yet, and noting down any failure. The tile is written under a
+   name of its own, and only takes its real name once it is whole, so a tile
+   cut short by an interruption is never taken as finished. */
+FILE *openTile(void *context, const int level, const int x, const int y)
+{
+    frameContext *tiles = context;
+    char          name[strlen(tiles->base) + sizeof TILE_PARTIAL_FILENAME +
+		       48];
+
+    // Several threads may make the same directory at once, which is fine.
+    const char *directories[] = {"%s", "%s/%d", "%s/%d/%d"};
+    int         made          = 1;
+
+    for (int i = 0; i < 3 && made; i++) {
+	snprintf(name, sizeof name, directories[i], tiles->base, level, x);
+	made = mkdir(name, 0777) == 0 || errno == EEXIST;
+    }
+
+    snprintf(name, sizeof name, TILE_PARTIAL_FILENAME, tiles->base, level, x,
+	     y, imageFormatExtension(tiles->format));
+
+    FILE *tileFile = made ? fopen(name, "wb") : NULL;
+
+    // Every rendering thread opens tiles, so this has to be atomic.
+    if (tileFile == NULL) {
+	#pragma omp atomic write
+	tiles->status = 1;
+    }
+
+    return tileFile;
+}
+
+
+
+
+// Closes the file of a finished tile, and gives it its real name.
+void closeTile(void *context, const int level, const int x, const int y,
+	       FILE *tileFile)
+{
+    frameContext *tiles = context;
+    const char   *extension = imageFormatExtension(tiles->format);
+    char          partial[strlen(tiles->base) + sizeof TILE_PARTIAL_FILENAME +
+			  48];
+    char          name[sizeof partial];
+
+    snprintf(partial, sizeof partial, TILE_PARTIAL_FILENAME, tiles->base,
+	     level, x, y, extension);
+    snprintf(name, sizeof name, TILE_FILENAME, tiles->base, level, x, y,
+	     extension);
+
+    if (fclose(tileFile) != 0 || rename(partial, name) != 0) {
+	#pragma omp atomic write
+	tiles->status = 1;
+    }
+}
+
+
+
+
+/*
+ * Rebuilds the frames of a zoom from an exponential map saved with -q and -r,
+ * starting at the view the map was drawn for, and zooming in by the same
+ * factor every frame, to endZoom times deeper. With no endZoom, it goes as
+ * deep as the map allows: until the rows near the center are a pixel apart.
+ * Returns the program's exit status.
+ */
+int zoomExpMap(const char         *escapeFileName,
+	       const colorSettings color,
+	       frameContext       *frames,
+	       const int           frameCount,
+	       const char         *endZoom,
+	       const int           width,
+	       const int           height)
+{
+    tEscapeBuffer strip;
+    const int     readStatus = readEscapes(escapeFileName, &strip);
+
+    if (readStatus != 0)
+	return readStatus;
+
+    // Any other escape times would give frames that look right, but are not.
+    if (strip.expMap == 0) {
+	fprintf(
+	    stderr,
+	    "Error: \"%s\" was not saved from an exponential map (-q, -r).\n",
+	    escapeFileName
+	    );
+	escapeBufferDeallocate(&strip);
+
+	return 3;
+    }
+
+    const double deepest = 4 * expMapDepth(strip.width, strip.height) /
+	(width * EXP_MAP_OUTER);
+    const double zoom    = (endZoom == NULL) ? deepest : atof(endZoom);
+
+    if (zoom < 1 || zoom > deepest) {
+	fprintf(
+	    stderr,
+	    "Error: This map can zoom (-Z) from 1 to %g at this width.\n",
+	    deepest
+	    );
+	escapeBufferDeallocate(&strip);
+
+	return 1;
+    }
+
+    for (int frame = 0; frame < frameCount; frame++) {
+	const double t = (frameCount > 1) ?
+	    (double) frame / (frameCount - 1) : 0;
+
+	FILE *frameFile = openFrame(frames, frame);
+
+	if (frameFile == NULL) {
+	    escapeBufferDeallocate(&strip);
+	    return 3;
+	}
+
+	const int status = expMapToTarga(&strip, color, pow(zoom, t), width,
+					 height, frames->format, frameFile);
+	closeFrame(frames, frame, frameFile);
+
+	if (frames->status != 0 && status == 0) {
+	    fprintf(
+		stderr,
+		"Error: Could not write the animation frames (-a).\n"
+		);
+	    escapeBufferDeallocate(&strip);
+
+	    return 3;
+	}
+
+	if (status != 0) {
+	    fprintf(
+		stderr,
+		"Error: Could not allocate memory for the frames.\n"
+		);
+	    escapeBufferDeallocate(&strip);
+
+	    return 2;
+	}
+    }
+
+    escapeBufferDeallocate(&strip);
+
+    return 0;
+}
+
+
+
+
+/* What writePreview needs to name and color the previews, and where it notes
+   down any failure to save them. */
+typedef struct {
+    colorSettings color;
+    imageFormat   format;
+    const char   *base;
+    int           status;
+} previewContext;
+
+
+
+
+/* Saves the escape times after a pass of progressive rendering as a preview
+   image of its own. */
+void writePreview(void *context, const int pass, const tEscapeBuffer *escapes)
+{
+    previewContext *preview = context;
+    char            name[strlen(preview->base) + sizeof PREVIEW_FILENAME + 16];
+
+    snprintf(name, sizeof name, PREVIEW_FILENAME, preview->base, pass + 1,
+	     imageFormatExtension(preview->format));
+
+    FILE *previewFile = fopen(name, "wb");
+
+    if (previewFile == NULL ||
+	colorizeToTarga(escapes, preview->color, preview->format, 1,
+			previewFile) != 0)
+	preview->status = 1;
+
+    if (previewFile != NULL && fclose(previewFile) != 0)
+	preview->status = 1;
+}
+
+
+
+
+/* The options main gathers besides the render settings, for the checks and
+   the renderers to look at. */
+typedef struct {
+    int   lowMemoryFlag; // A flag on whether or not to use low-memory mode.
+    int   statsFlag;     // A flag on whether or not to print statistics.
+    int   bufferSize;    // Size of the output buffer in MB (0 -> default).
+
+    int   frameCount;    // Frames of the animation (0 -> no animation).
+    int   expMapFlag;    // A flag on whether to draw an exponential map.
+    int   tiffFlag;      // A flag on whether to save a TIFF, not a TARGA.
+    int   mappedFlag;    // A flag on whether to write through a memory map.
+    int   formatFlag;    // A flag on whether -F picked the format.
+    int   separateFlag;  // A flag on whether atlas thumbnails get files.
+    int   streamFlag;    // A flag on whether the image goes to stdout.
+
+    char *escapeSave; // File to save escape times to (-r), if any.
+    char *endReal;    // Where the animation ends (-X, -Y, -Z). Left
+    char *endImag;    // at NULL, they stay the same as the start.
+    char *endZoom;
+    char *escapeLoad; // File to recolor escape times from (-u), if any.
+    char *outputPath; // File to save the image to (-O), if not the usual.
+    char *atlasSpec;  // Julia constants of an atlas (-J), if any.
+    char *tileLevels; // Levels of a tile pyramid (-G), if any.
+} programOptions;
+
+
+
+
+/* Says which option was not recognized. Checks primarily for options which
+   require arguments, but had none were provided. */
+static void reportOptionError(const int option)
+{
+    if (option == 'x')
+	fprintf(
+	    stderr,
+	    "Error: Center real value (-x) not recognized.\n"
+	    );
+
+    else if (option == 'y')
+	fprintf(
+	    stderr,
+	    "Error: Center imaginary value (-y) not recognized.\n"
+	    );
+
+    else if (option == 'z')
+	fprintf(
+	    stderr,
+	    "Error: Zoom level (-z) not recognized.\n"
+	    );
+
+    else if (option == 'i')
+	fprintf(
+	    stderr,
+	    "Error: Iteration count (-i) not recognized.\n"
+	    );
+
+    else if (option == 'o')
+	fprintf(
+	    stderr,
+	    "Error: Hue offset value (-o) not recognized.\n"
+	    );
+
+    else if (option == 'l')
+	fprintf(
+	    stderr,
+	    "Error: Hue limiter value (-l) not recognized.\n"
+	    );
+
+    else if (option == 't')
+	fprintf(
+	    stderr,
+	    "Error: Thread amount (-t) not recognized.\n"
+	    );
+
+    else if (option == 'b')
+	fprintf(
+	    stderr,
+	    "Error: Maximum brightness value (-b) not recognized.\n"
+	    );
+
+    else if (option == 'd')
+	fprintf(
+	    stderr,
+	    "Error: Light distribution value (-d) not recognized.\n"
+	    );
+
+    else if (option == 'c')
+	fprintf(
+	    stderr,
+	    "Error: Constant brightness value (-c) not recognized.\n"
+	    );
+
+    else if (option == 'e')
+	fprintf(
+	    stderr,
+	    "Error: Interior checks (-e) not recognized.\n"
+	    );
+
+    else if (option == 'w')
+	fprintf(
+	    stderr,
+	    "Error: Write buffer size (-w) not recognized.\n"
+	    );
+
+    else if (option == 'F')
+	fprintf(
+	    stderr,
+	    "Error: Output format (-F) not recognized.\n"
+	    );
+
+    else if (option == 'k')
+	fprintf(
+	    stderr,
+	    "Error: Kernel (-k) not recognized.\n"
+	    );
+
+    else if (option == 'g')
+	fprintf(
+	    stderr,
+	    "Error: Fill mode (-g) not recognized.\n"
+	    );
+
+    else if (option == 'n')
+	fprintf(
+	    stderr,
+	    "Error: Progressive pass count (-n) not recognized.\n"
+	    );
+
+    else if (option == 'A')
+	fprintf(
+	    stderr,
+	    "Error: Supersampling grid (-A) not recognized.\n"
+	    );
+
+    else if (option == 'T')
+	fprintf(
+	    stderr,
+	    "Error: Fractal type (-T) not recognized.\n"
+	    );
+
+    else if (option == 'P')
+	fprintf(
+	    stderr,
+	    "Error: Power (-P) not recognized.\n"
+	    );
+
+    else if (option == 'a')
+	fprintf(
+	    stderr,
+	    "Error: Animation frame count (-a) not recognized.\n"
+	    );
+
+    else if (option == 'X')
+	fprintf(
+	    stderr,
+	    "Error: Last frame's real value (-X) not recognized.\n"
+	    );
+
+    else if (option == 'Y')
+	fprintf(
+	    stderr,
+	    "Error: Last frame's imaginary value (-Y) not recognized.\n"
+	    );
+
+    else if (option == 'Z')
+	fprintf(
+	    stderr,
+	    "Error: Last frame's zoom level (-Z) not recognized.\n"
+	    );
+
+    else if (option == 'r')
+	fprintf(
+	    stderr,
+	    "Error: Escape time file to save (-r) not recognized.\n"
+	    );
+
+    else if (option == 'u')
+	fprintf(
+	    stderr,
+	    "Error: Escape time file to recolor (-u) not recognized.\n"
+	    );
+
+    else if (option == 'O')
+	fprintf(
+	    stderr,
+	    "Error: Output file (-O) not recognized.\n"
+	    );
+
+    else if (option == 'J')
+	fprintf(
+	    stderr,
+	    "Error: Julia constants of the atlas (-J) not recognized.\n"
+	    );
+
+    else if (option == 'G')
+	fprintf(
+	    stderr,
+	    "Error: Levels of the tile pyramid (-G) not recognized.\n"
+	    );
+
+    else
+	fprintf(
+	    stderr,
+	    "Error: Option (-%c) not recognized.\n",
+	    option
+	    );
+
+}
+
+
+
+
+/*
+ * Recolors escape times saved with -r (-u), or rebuilds a zoom from an
+ * exponential map saved with them (-u, -a). Only the color settings are
+ * needed, since the size and iteration count come from the file, and the
+ * frames of a zoom take their size from the two arguments left over. Returns
+ * the program's exit status.
+ */
+static int recolorWithOptions(const renderSettings  renderInput,
+			      const programOptions *options,
+			      const int             argErrorFlag,
+			      const char           *imageName,
+			      const char           *outputBase,
+			      const int             sizeCount,
+			      char                 *sizes[])
+{
+    if (argErrorFlag == 1) {
+	fprintf(
+	    stderr,
+	    "Use -h for additional help.\n"
+	    );
+
+	return 1;
+    }
+
+    if (renderInput.draw.samples != 1) {
+	// Supersampling works out new points, which takes the whole view.
+	fprintf(
+	    stderr,
+	    "Error: Escape times (-u) cannot be recolored with "
+	    "supersampling (-A).\n"
+	    "Use -h for additional help.\n"
+	    );
+
+	return 1;
+    }
+
+    if (options->atlasSpec != NULL || options->separateFlag == 1 ||
+	options->tileLevels != NULL) {
+	// A packed atlas is recolored like any other image, without -J.
+	fprintf(
+	    stderr,
+	    "Error: Escape times (-u) cannot be recolored into an atlas "
+	    "or a pyramid (-J, -S, -G).\n"
+	    "Use -h for additional help.\n"
+	    );
+
+	return 1;
+    }
+
+    if (options->tiffFlag == 1) {
+	// Recolored images are built from a whole buffer anyway.
+	fprintf(
+	    stderr,
+	    "Error: Escape times (-u) can only be recolored into TARGA "
+	    "images.\n"
+	    "Use -h for additional help.\n"
+	    );
+
+	return 1;
+    }
+
+    if (options->frameCount < 1)
+	return recolorEscapes(options->escapeLoad, imageName,
+			      renderInput.color, renderInput.format,
+			      (renderInput.draw.threadCount > 0) ?
+			      (int) renderInput.draw.threadCount : 1);
+
+    // Rebuilding a zoom from a map needs the size of the frames.
+    if (sizeCount < 2 || atoi(sizes[0]) < 1 || atoi(sizes[1]) < 1 ||
+	atoi(sizes[0]) > TARGA_SIZE_MAX || atoi(sizes[1]) > TARGA_SIZE_MAX) {
+	fprintf(
+	    stderr,
+	    "Error: Rebuilding a zoom (-u, -a) needs a frame size, of at "
+	    "most %d.\n"
+	    "Use -h for additional help.\n",
+	    TARGA_SIZE_MAX
+	    );
+
+	return 1;
+    }
+
+    frameContext mapFrames = {renderInput.format, outputBase, 0};
+
+    return zoomExpMap(options->escapeLoad, renderInput.color, &mapFrames,
+		      options->frameCount, options->endZoom, atoi(sizes[0]),
+		      atoi(sizes[1]));
+}
+
+
+
+
+/* Checks the settings every image has: its size, view and iteration count,
+   how its escape times are worked out, and how it is drawn. Prints out each
+   problem found, and returns 1 if there were any. */
+static int checkImageOptions(const renderSettings  renderInput,
+			     const programOptions *options)
+{
+    int argErrorFlag = 0;
+
+    if (renderInput.draw.width == 0) {
+	/* A negative or 0 width would cause no image to render.
+	   A 0 width would also cause FP exceptions (used as a divisor). */
+	fprintf(
+	    stderr,
+	    "Error: Width cannot be 0.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.draw.height == 0) {
+	// A negative or 0 height would cause no image to render.
+	fprintf(
+	    stderr,
+	    "Error: Height cannot be 0.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.draw.width > IMAGE_SIZE_MAX ||
+	renderInput.draw.height > IMAGE_SIZE_MAX) {
+	// Pixels are counted with ints, which this keeps well clear of.
+	fprintf(
+	    stderr,
+	    "Error: Width and height cannot be over %d.\n",
+	    IMAGE_SIZE_MAX
+	    );
+
+	argErrorFlag = 1;
+
+    } else if (options->tiffFlag == 0 &&
+	       (renderInput.draw.width > TARGA_SIZE_MAX ||
+		renderInput.draw.height > TARGA_SIZE_MAX)) {
+	/* The TARGA header only has 16 bits for each, so anything more wraps.
+	   The other formats are held to the same, as the renderers that write
+	   them are the ones that hold the whole image in memory. */
+	fprintf(
+	    stderr,
+	    "Error: Images cannot be over %d pixels either way, except with "
+	    "-F tiff.\n",
+	    TARGA_SIZE_MAX
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.draw.zoomLevel == 0) {
+	/* A zoom level of 0 would cause FP exceptions, as the value is used
+	   as a divisor.
+	*/
+	fprintf(
+	    stderr,
+	    "Error: Cannot have 0 zoom.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.color.maxIterations < 1) {
+	// An iteration count less than 1 can only paint black images.
+	fprintf(
+	    stderr,
+	    "Error: Iteration count cannot be less than 1.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.calc.power < 2 ||
+	renderInput.calc.power > FRACTAL_POWER_MAX) {
+	// There is a kernel compiled for each of these powers, and no others.
+	fprintf(
+	    stderr,
+	    "Error: Power (-P) must be from 2 to %d.\n",
+	    FRACTAL_POWER_MAX
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.calc.deepZoom == 1) {
+	// The deep-zoom mode re-reads the center with every digit it has.
+	tBigFixed check;
+
+	if (bigFixedParse(&check, renderInput.calc.deepReal, 2) != 0 ||
+	    bigFixedParse(&check, renderInput.calc.deepImag, 2) != 0) {
+	    fprintf(
+		stderr,
+		"Error: Deep-zoom mode could not read the center (-x, -y).\n"
+		);
+
+	    argErrorFlag = 1;
+	}
+
+	// It only knows how to follow Mandelbrot orbits, squared.
+	if (renderInput.calc.fractal != FRACTAL_MANDELBROT ||
+	    renderInput.calc.power != 2) {
+	    fprintf(
+		stderr,
+		"Error: Deep-zoom mode can only render the Mandelbrot set, at "
+		"a power (-P) of 2.\n"
+		);
+
+	    argErrorFlag = 1;
+	}
+    }
+
+    if (renderInput.calc.smooth == 1 && renderInput.calc.deepZoom == 1) {
+	// The deep-zoom kernel does not keep track of how far points escape.
+	fprintf(
+	    stderr,
+	    "Error: Smooth coloring (-f) does not work in deep-zoom mode.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.calc.smooth == 1 && renderInput.draw.fill != FILL_NONE) {
+	// Smooth escape times never repeat, so there is nothing to fill.
+	fprintf(
+	    stderr,
+	    "Error: Smooth coloring (-f) cannot be used with a fill mode (-g).\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (options->escapeSave != NULL && options->lowMemoryFlag == 1 &&
+	renderInput.draw.fill == FILL_NONE) {
+	// Low-memory mode never holds the escape times of the whole image.
+	fprintf(
+	    stderr,
+	    "Error: Escape times (-r) cannot be saved in low-memory mode.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.draw.passes < 1 ||
+	renderInput.draw.passes > PASSES_MAX) {
+	// Much past this, the first pass has too few pixels to show anything.
+	fprintf(
+	    stderr,
+	    "Error: Progressive passes (-n) must be from 1 to %d.\n",
+	    PASSES_MAX
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.draw.passes > 1 &&
+	(options->lowMemoryFlag == 1 || renderInput.draw.fill != FILL_NONE)) {
+	// Each pass fills in the gaps of the last, so it keeps every pixel.
+	fprintf(
+	    stderr,
+	    "Error: Progressive passes (-n) cannot be used with -m or -g.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.draw.samples < 1 ||
+	renderInput.draw.samples > SUPERSAMPLE_MAX) {
+	// Past this, a pixel's samples no longer fit in one batch.
+	fprintf(
+	    stderr,
+	    "Error: Supersampling grid (-A) must be from 1 to %d.\n",
+	    SUPERSAMPLE_MAX
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.draw.samples > 1 &&
+	(options->lowMemoryFlag == 1 || options->mappedFlag == 1 ||
+	 options->tiffFlag == 1 || options->expMapFlag == 1)) {
+	/* Edges are found from the escape times of the neighbours of each
+	   pixel, so the whole image has to be kept. */
+	fprintf(
+	    stderr,
+	    "Error: Supersampling (-A) cannot be used with -m, -M, -q or "
+	    "-F tiff.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (escapeKernelSupported(renderInput.calc.kernel) == 0) {
+	// Running a kernel without its instruction set would crash.
+	fprintf(
+	    stderr,
+	    "Error: This CPU does not support the chosen kernel (-k).\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.draw.threadCount < 1) {
+	// A 0 or negative threadcount isn't going to be usable.
+	fprintf(
+	    stderr,
+	    "Error: Threadcount cannot be less than 1.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    return argErrorFlag;
+}
+
+
+
+
+/* Checks the options of a Julia atlas (-J, -S), given its constants, against
+   the rest. Prints out each problem found, and returns 1 if there were any. */
+static int checkAtlasOptions(const renderSettings  renderInput,
+			     const programOptions *options,
+			     const int             atlasCount,
+			     const int             atlasColumns)
+{
+    int argErrorFlag = 0;
+
+    if (options->atlasSpec != NULL &&
+	(renderInput.calc.deepZoom == 1 || options->lowMemoryFlag == 1 ||
+	 options->mappedFlag == 1 || options->tiffFlag == 1 ||
+	 renderInput.draw.passes > 1 || options->frameCount > 0 ||
+	 options->expMapFlag == 1 || renderInput.draw.fill != FILL_NONE ||
+	 renderInput.draw.samples > 1 ||
+	 renderInput.calc.fractal == FRACTAL_BURNING_SHIP)) {
+	// Each thumbnail is a plain Julia set, drawn whole by a single thread.
+	fprintf(
+	    stderr,
+	    "Error: Julia atlases (-J) cannot be used with -p, -m, -M, -n, -a, "
+	    "-q, -g, -A, -T ship or -F tiff.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (options->separateFlag == 1 &&
+	(options->atlasSpec == NULL || options->escapeSave != NULL ||
+	 options->streamFlag == 1)) {
+	/* Separate thumbnails are written by whichever thread drew them, in no
+	   set order, so each needs a file of its own. */
+	fprintf(
+	    stderr,
+	    "Error: Separate thumbnails (-S) need an atlas (-J), and cannot be "
+	    "used with -r or -O -.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (options->atlasSpec != NULL && options->separateFlag == 0 &&
+	atlasCount > 0 &&
+	(renderInput.draw.width * atlasColumns > TARGA_SIZE_MAX ||
+	 renderInput.draw.height * ((atlasCount + atlasColumns - 1) /
+				    atlasColumns) > TARGA_SIZE_MAX)) {
+	// The thumbnails of a packed atlas make up a single image.
+	fprintf(
+	    stderr,
+	    "Error: A packed atlas (-J) cannot be over %d pixels either way. "
+	    "Save the thumbnails separately with -S.\n",
+	    TARGA_SIZE_MAX
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    return argErrorFlag;
+}
+
+
+
+
+/* Reads the levels of a tile pyramid (-G), and the region it covers, if any,
+   and checks them against the rest of the options. Prints out each problem
+   found, and returns 1 if there were any. */
+static int checkPyramidOptions(const renderSettings  renderInput,
+			       const programOptions *options,
+			       pyramidSettings      *pyramid)
+{
+    int argErrorFlag = 0;
+
+    if (options->tileLevels == NULL)
+	return 0;
+
+    if (readPyramidLevels(options->tileLevels, pyramid) != 0) {
+	fprintf(
+	    stderr,
+	    "Error: Levels of a tile pyramid (-G) must be min,max or "
+	    "min,max,x0,y0,x1,y1, from 0 to %d.\n",
+	    PYRAMID_LEVEL_MAX
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (renderInput.calc.deepZoom == 1 || options->lowMemoryFlag == 1 ||
+	options->mappedFlag == 1 || options->tiffFlag == 1 ||
+	renderInput.draw.passes > 1 || options->frameCount > 0 ||
+	options->expMapFlag == 1 || renderInput.draw.samples > 1 ||
+	options->atlasSpec != NULL || options->escapeSave != NULL ||
+	options->streamFlag == 1) {
+	/* Each tile is a plain image, drawn whole by a single thread, and
+	   written to a file of its own. */
+	fprintf(
+	    stderr,
+	    "Error: Tile pyramids (-G) cannot be used with -p, -m, -M, -n, -a, "
+	    "-q, -A, -J, -r, -F tiff or -O -.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    return argErrorFlag;
+}
+
+
+
+
+/* Works out where an animation (-a) starts and ends, which is where a single
+   image would be, unless told otherwise (-X, -Y, -Z), and checks it against
+   the rest of the options. Prints out each problem found, and returns 1 if
+   there were any. */
+static int checkAnimationOptions(const renderSettings  renderInput,
+				 const programOptions *options,
+				 animationSettings    *animation)
+{
+    int argErrorFlag = 0;
+
+    animation->startOffset = renderInput.draw.offset;
+    animation->startZoom   = renderInput.draw.zoomLevel;
+    animation->endOffset   = renderInput.draw.offset;
+    animation->endZoom     = renderInput.draw.zoomLevel;
+    animation->frameCount  = options->frameCount;
+
+    if (options->endReal != NULL)
+	animation->endOffset.real = atof(options->endReal);
+    if (options->endImag != NULL)
+	animation->endOffset.imag = atof(options->endImag);
+    if (options->endZoom != NULL)
+	animation->endZoom = atof(options->endZoom);
+
+    if (options->frameCount < 0 ||
+	(options->frameCount == 0 && (options->endReal != NULL ||
+				      options->endImag != NULL ||
+				      options->endZoom != NULL))) {
+	// The end of an animation means nothing without one.
+	fprintf(
+	    stderr,
+	    "Error: -X, -Y and -Z need a positive frame count (-a).\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (options->frameCount > 0 &&
+	(animation->endZoom <= 0 || renderInput.draw.zoomLevel <= 0)) {
+	// Zoom levels are interpolated by their logarithms.
+	fprintf(
+	    stderr,
+	    "Error: Zoom levels (-z, -Z) of an animation must be positive.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (options->frameCount > 0 &&
+	(renderInput.calc.deepZoom == 1 || options->lowMemoryFlag == 1 ||
+	 options->escapeSave != NULL || renderInput.draw.passes > 1)) {
+	// Each frame is a whole new image, kept in memory, at double precision.
+	fprintf(
+	    stderr,
+	    "Error: Animations (-a) cannot be used with -p, -m, -r or -n.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    return argErrorFlag;
+}
+
+
+
+
+/* Checks the options that draw or write the image in a way of their own (-q,
+   -F tiff, -M, -O -) against the rest. Prints out each problem found, and
+   returns 1 if there were any. */
+static int checkOutputOptions(const renderSettings  renderInput,
+			      const programOptions *options)
+{
+    int argErrorFlag = 0;
+
+    if (options->expMapFlag == 1 &&
+	(renderInput.calc.smooth == 1 || options->lowMemoryFlag == 1 ||
+	 renderInput.draw.passes > 1 || options->frameCount > 0)) {
+	// The map is drawn in tiles, like -g, and the frames come from -u.
+	fprintf(
+	    stderr,
+	    "Error: Exponential maps (-q) cannot be used with -f, -m, -n or -a.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (options->tiffFlag == 1 &&
+	(options->escapeSave != NULL || renderInput.draw.passes > 1 ||
+	 options->frameCount > 0 || options->expMapFlag == 1)) {
+	// TIFF images go to disk a tile at a time, and are never held whole.
+	fprintf(
+	    stderr,
+	    "Error: TIFF output (-F) cannot be used with -r, -n, -a or -q.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (options->mappedFlag == 1 &&
+	(options->escapeSave != NULL || renderInput.draw.passes > 1 ||
+	 options->frameCount > 0 || options->expMapFlag == 1 ||
+	 options->tiffFlag == 1 || renderInput.format != IMAGE_TGA)) {
+	/* Mapped images are drawn straight into colors, in the TARGA file,
+	   where every row has to have a fixed place. */
+	fprintf(
+	    stderr,
+	    "Error: Memory-mapped output (-M) cannot be used with -r, -n, -a, "
+	    "-q or -F with anything but tga.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    if (options->streamFlag == 1 &&
+	(options->tiffFlag == 1 || options->mappedFlag == 1 ||
+	 renderInput.draw.passes > 1)) {
+	/* A pipe can only be written front to back, which TIFF and mapped
+	   images are not, and previews need names of their own. */
+	fprintf(
+	    stderr,
+	    "Error: Standard output (-O -) cannot be used with -M, -n or "
+	    "-F tiff.\n"
+	    );
+
+	argErrorFlag = 1;
+    }
+
+    return argErrorFlag;
+}
+
+
+
+
+/*
+ * Renders a Mandelbrot set, either normally, in parallel, in parallel with
+ * solid regions filled in, in progressive passes, or with minimized RAM usage
+ * (streamed out by several threads, or by one, tile by tile into a TIFF, or
+ * straight into the file through a memory map). Atlases, pyramids and
+ * animations have renderers of their own. Returns the renderer's status.
+ */
+static int renderWithOptions(renderSettings           renderInput,
+			     const programOptions    *options,
+			     const atlasSettings      atlas,
+			     const pyramidSettings    pyramid,
+			     const animationSettings  animation,
+			     previewContext          *preview)
+{
+    if (options->tiffFlag == 1)
+	return renderToTiff(renderInput);
+
+    else if (options->mappedFlag == 1)
+	return renderToTarga_mapped(renderInput);
+
+    else if (options->atlasSpec != NULL)
+	return renderAtlas(renderInput, atlas);
+
+    else if (options->tileLevels != NULL)
+	return renderPyramid(renderInput, pyramid);
+
+    else if (options->frameCount > 0)
+	return renderAnimation(renderInput, animation);
+
+    else if (options->expMapFlag == 1)
+	return renderToTarga_expMap(renderInput);
+
+    else if (renderInput.draw.fill != FILL_NONE)
+	return renderToTarga_fill(renderInput);
+
+    else if (renderInput.draw.passes > 1) {
+	// Progressive rendering saves a preview after every pass but the last.
+	renderInput.passDone    = writePreview;
+	renderInput.passContext = preview;
+	return renderToTarga_progressive(renderInput);
+    }
+
+    else if (renderInput.draw.threadCount > 1 && options->lowMemoryFlag == 1)
+	return renderToTarga_stream(renderInput);
+
+    else if (renderInput.draw.threadCount > 1)
+	return renderToTarga_parallel(renderInput);
+
+    else if (options->lowMemoryFlag == 0)
+	return renderToTarga(renderInput);
+
+    else if (options->lowMemoryFlag == 1)
+	return renderToTarga_lowMem(renderInput);
+
+    fprintf(
+	stderr,
+	"Impossible State: Low-memory flag is invalid (neither 0 or 1).\n"
+	);
+
+    return 0;
+}
+
+
+
+
+/* Works out the program's exit status from the renderer's, saying what went
+   wrong, if anything did. */
+static int renderExitStatus(const int             status,
+			    const renderSettings  renderInput,
+			    const programOptions *options)
+{
+    /* Tiled and mapped images are written as they are drawn, so they fail
+       here, as does any image that did not make it out of the buffer. */
+    if (status == 2) {
+	fprintf(
+	    stderr,
+	    "Error: Could not write the image.\n"
+	    );
+
+	return 3;
+    }
+
+    // Checks for memory allocation errors, if memory is allocated.
+    if (status == 1 && (options->tiffFlag == 1 || options->mappedFlag == 1)) {
+	fprintf(
+	    stderr,
+	    "Error: Could not allocate memory for the image tiles.\n"
+	    );
+
+	return 2;
+    } else if (status == 1 && options->atlasSpec != NULL) {
+	fprintf(
+	    stderr,
+	    "Error: Could not allocate memory for the atlas.\n"
+	    );
+
+	return 2;
+    } else if (status == 1 && options->tileLevels != NULL) {
+	fprintf(
+	    stderr,
+	    "Error: Could not allocate memory for the pyramid.\n"
+	    );
+
+	return 2;
+    } else if (status == 1 && options->lowMemoryFlag == 0) {
+	fprintf(
+	    stderr,
+	    "Error: Could not allocate memory for image (approx. %zu bytes).\n",
+	    (size_t) renderInput.draw.height * renderInput.draw.width * 3
+	    );
+
+	return 2;
+    } else if (status == 1 && options->lowMemoryFlag == 1) {
+	fprintf(
+	    stderr,
+	    "Warning: Abornal exit status from low-memory rendering function.\n"
+	    );
+
+	return 2;
+    }
+
+    return 0;
+}
+
+
+
+
+/* Prints out how long rendering took, and how each thread spent its time,
+   and for a pyramid, how each tile was come by. */
+static void printStats(const renderStats   *stats,
+		       const pyramidCounts *tileCounts)
+{
+    fprintf(stderr, "Render time: %.3f s\n", stats->renderTime);
+
+    for (unsigned int i = 0; i < stats->threadCount; i++) {
+	const threadStats thread = stats->thread[i];
+	const double      busy   = (stats->renderTime > 0) ?
+	    100 * thread.busyTime / stats->renderTime : 100;
+
+	fprintf(
+	    stderr,
+	    "Thread %u: %.3f s busy, %.3f s idle (%.1f%% busy), "
+	    "%lu tiles (%lu stolen).\n",
+	    i, thread.busyTime, thread.idleTime, busy,
+	    thread.tileCount, thread.stealCount
+	    );
+    }
+
+    if (tileCounts != NULL)
+	fprintf(
+	    stderr,
+	    "Tiles: %lu drawn, %lu known to be one escape time, %lu "
+	    "taken to be from their edges, %lu already there.\n",
+	    tileCounts->drawn, tileCounts->known, tileCounts->uniform,
+	    tileCounts->existing
+	    );
 }
 
 
@@ -65,41 +1628,19 @@ int main(int argc, char *argv[])
 	return 1;
     }
 
-    /* 
-     * Sets up the default render settings, which may be modified by optargs.
-     * 
-     * The two main draw settings, offset and zoomlevel, are set to show the
-     * whole mandelbrot set by default. The other draw setting, threadCount, is
-     * by default 1, as most computers have at least 1 thread nowadays.
-     *
-     * For the color settings, I've defaulted it to something fairly light on
-     * processing power that will produce a fairly decent looking image.
-     */
-    renderSettings renderInput;
-    renderInput.draw.offset.real        = 0;
-    renderInput.draw.offset.imag        = 0;
-    renderInput.draw.zoomLevel          = 1;
-    renderInput.draw.threadCount        = 1;
-    renderInput.color.maxIterations     = 360;
-    renderInput.color.constantLight     = 0.5;
-    renderInput.color.hueOffset         = 0;
-    renderInput.color.hueLimiter        = 1;
-    renderInput.color.lightMax          = 1;
-    renderInput.color.lightDistribution = 4;
-    renderInput.calc.juliaFlag          = 0;     // Currently hidden Julia set
-    renderInput.calc.juliaConstant.real = -0.8;  // flag and option. Needs 
-    renderInput.calc.juliaConstant.imag = 0.156; // cli options for the const.
+    // Sets up the default render settings, which may be modified by optargs.
+    renderSettings renderInput = renderOptionsDefaults();
 
     // Vars for dealing with optional arguments.
-    int arg;               // Holds the current optional arg.
-    int lowMemoryFlag = 0; // A flag on whether or not to use low-memory mode.
-    int argErrorFlag  = 0; // A flag on whether or not optargs had any failures.
+    int            arg;              // Holds the current optional arg.
+    int            argErrorFlag = 0; // A flag on whether optargs had failures.
+    programOptions options      = {0};
 
     // Parses optional args (breaks from loop below).
     while (1) {
 
 	// Attempts to get an optarg.
-	arg = getopt(argc, argv, "x:y:z:i:o:l:t:b:d:c:mjvh");
+	arg = getopt(argc, argv, "x:y:z:i:o:l:t:b:d:c:k:w:e:r:u:g:n:a:X:Y:Z:F:O:A:T:P:J:G:mMspfjqSvh");
 
 	// Quits if there are no more remaining optargs.
 	if (arg == -1)
@@ -118,11 +1659,13 @@ int main(int argc, char *argv[])
 	case 'x':
 	    // 'x' is the real value of the graph center.
 	    renderInput.draw.offset.real = atof(optarg);
+	    renderInput.calc.deepReal    = optarg;
 	    break;
 	    
 	case 'y':
 	    // 'y' is the imag value of the graph center.
 	    renderInput.draw.offset.imag = atof(optarg);
+	    renderInput.calc.deepImag    = optarg;
 	    break;
 	    
 	case 'z':
@@ -172,83 +1715,215 @@ int main(int argc, char *argv[])
 	    
 	case 'm':
 	    // 'm' sets low memory mode.
-	    lowMemoryFlag = 1;
+	    options.lowMemoryFlag = 1;
 	    break;
 
-	case 'j':
-	    // 'j' sets Julia mode. Renders a Julia set instead of a mandelbrot.
-	    renderInput.calc.juliaFlag = 1;
-	    break;
-	    
-	case '?':
-	    /* Case of an error in optarg parsing. Checks primarily for options
-	       which require arguments, but had none were provided. */
-	    if (optopt == 'x')
-		fprintf(
-		    stderr,
-		    "Error: Center real value (-x) not recognized.\n"
-		    );
-	    
-	    else if (optopt == 'y')
-		fprintf(
-		    stderr,
-		    "Error: Center imaginary value (-y) not recognized.\n"
-		    );
-	    
-	    else if (optopt == 'z')
-		fprintf(
-		    stderr,
-		    "Error: Zoom level (-z) not recognized.\n"
-		    );
-	    
-	    else if (optopt == 'i')
-		fprintf(
-		    stderr,
-		    "Error: Iteration count (-i) not recognized.\n"
-		    );
-	    
-	    else if (optopt == 'o')
-		fprintf(
-		    stderr,
-		    "Error: Hue offset value (-o) not recognized.\n"
-		    );
-	    
-	    else if (optopt == 'l')
+	case 'k':
+	    // 'k' picks the escape-time kernel by name.
+	    if (strcmp(optarg, "auto") == 0)
+		renderInput.calc.kernel = KERNEL_AUTO;
+	    else if (strcmp(optarg, "scalar") == 0)
+		renderInput.calc.kernel = KERNEL_SCALAR;
+	    else if (strcmp(optarg, "sse2") == 0)
+		renderInput.calc.kernel = KERNEL_SSE2;
+	    else if (strcmp(optarg, "avx2") == 0)
+		renderInput.calc.kernel = KERNEL_AVX2;
+	    else if (strcmp(optarg, "avx512") == 0)
+		renderInput.calc.kernel = KERNEL_AVX512;
+	    else {
 		fprintf(
 		    stderr,
-		    "Error: Hue limiter value (-l) not recognized.\n"
+		    "Error: Kernel (-k) \"%s\" not recognized.\n",
+		    optarg
 		    );
+		argErrorFlag = 1;
+	    }
+	    break;
+
+	case 'F':
+	    // 'F' picks the format of the output image, by name.
+	    options.tiffFlag   = 0;
+	    options.formatFlag = 1;
 
-	    else if (optopt == 't')
+	    if (strcmp(optarg, "tga") == 0)
+		renderInput.format = IMAGE_TGA;
+	    else if (strcmp(optarg, "rle") == 0)
+		renderInput.format = IMAGE_TGA_RLE;
+	    else if (strcmp(optarg, "qoi") == 0)
+		renderInput.format = IMAGE_QOI;
+	    else if (strcmp(optarg, "png") == 0)
+		renderInput.format = IMAGE_PNG;
+	    else if (strcmp(optarg, "tiff") == 0)
+		options.tiffFlag = 1;
+	    else {
 		fprintf(
 		    stderr,
-		    "Error: Thread amount (-t) not recognized.\n"
+		    "Error: Output format (-F) \"%s\" not recognized.\n",
+		    optarg
 		    );
+		argErrorFlag = 1;
+	    }
+	    break;
 
-	    else if (optopt == 'b')
+	case 'e':
+	    // 'e' picks which interior checks to use, by name.
+	    if (strcmp(optarg, "all") == 0)
+		renderInput.calc.interiorChecks = INTERIOR_ALL;
+	    else if (strcmp(optarg, "bulbs") == 0)
+		renderInput.calc.interiorChecks = INTERIOR_BULBS;
+	    else if (strcmp(optarg, "period") == 0)
+		renderInput.calc.interiorChecks = INTERIOR_PERIODICITY;
+	    else if (strcmp(optarg, "none") == 0)
+		renderInput.calc.interiorChecks = INTERIOR_NONE;
+	    else {
 		fprintf(
 		    stderr,
-		    "Error: Maximum brightness value (-b) not recognized.\n"
+		    "Error: Interior checks (-e) \"%s\" not recognized.\n",
+		    optarg
 		    );
+		argErrorFlag = 1;
+	    }
+	    break;
 
-	    else if (optopt == 'd')
+	case 'g':
+	    // 'g' picks the solid-region fill mode, by name.
+	    if (strcmp(optarg, "subdivide") == 0)
+		renderInput.draw.fill = FILL_SUBDIVIDE;
+	    else if (strcmp(optarg, "trace") == 0)
+		renderInput.draw.fill = FILL_TRACE;
+	    else if (strcmp(optarg, "none") == 0)
+		renderInput.draw.fill = FILL_NONE;
+	    else {
 		fprintf(
 		    stderr,
-		    "Error: Light distribution value (-d) not recognized.\n"
+		    "Error: Fill mode (-g) \"%s\" not recognized.\n",
+		    optarg
 		    );
+		argErrorFlag = 1;
+	    }
+	    break;
+
+	case 'n':
+	    // 'n' sets the number of progressive passes.
+	    renderInput.draw.passes = atoi(optarg);
+	    break;
+
+	case 'A':
+	    // 'A' sets the grid of samples taken across each pixel on an edge.
+	    renderInput.draw.samples = atoi(optarg);
+	    break;
+
+	case 'a':
+	    // 'a' renders a zoom animation of this many frames.
+	    options.frameCount = atoi(optarg);
+	    break;
+
+	case 'X':
+	    // 'X' is the real value of the last frame's center.
+	    options.endReal = optarg;
+	    break;
+
+	case 'Y':
+	    // 'Y' is the imag value of the last frame's center.
+	    options.endImag = optarg;
+	    break;
+
+	case 'Z':
+	    // 'Z' is the zoom multiplier of the last frame.
+	    options.endZoom = optarg;
+	    break;
+
+	case 'w':
+	    // 'w' sets the size of the output buffer.
+	    options.bufferSize = abs(atoi(optarg));
+	    break;
+
+	case 's':
+	    // 's' asks for render statistics once the image is done.
+	    options.statsFlag = 1;
+	    break;
+
+	case 'p':
+	    // 'p' sets deep-zoom (perturbation) mode.
+	    renderInput.calc.deepZoom = 1;
+	    break;
+
+	case 'f':
+	    // 'f' asks for smooth (fractional) escape times.
+	    renderInput.calc.smooth = 1;
+	    break;
+
+	case 'r':
+	    // 'r' saves the raw escape times to a file as well.
+	    options.escapeSave = optarg;
+	    break;
+
+	case 'O':
+	    // 'O' names the output image, or sends it to standard output.
+	    options.outputPath = optarg;
+	    break;
+
+	case 'u':
+	    // 'u' recolors saved escape times, instead of rendering.
+	    options.escapeLoad = optarg;
+	    break;
+
+	case 'q':
+	    // 'q' draws an exponential map, instead of an ordinary view.
+	    options.expMapFlag = 1;
+	    break;
+
+	case 'M':
+	    // 'M' writes the image through a memory map of the file.
+	    options.mappedFlag = 1;
+	    break;
+
+	case 'j':
+	    // 'j' sets Julia mode. Renders a Julia set instead of a mandelbrot.
+	    renderInput.calc.fractal = FRACTAL_JULIA;
+	    break;
 
-	    else if (optopt == 'c')
+	case 'T':
+	    // 'T' picks the fractal to render, by name.
+	    if (strcmp(optarg, "mandelbrot") == 0)
+		renderInput.calc.fractal = FRACTAL_MANDELBROT;
+	    else if (strcmp(optarg, "julia") == 0)
+		renderInput.calc.fractal = FRACTAL_JULIA;
+	    else if (strcmp(optarg, "ship") == 0)
+		renderInput.calc.fractal = FRACTAL_BURNING_SHIP;
+	    else {
 		fprintf(
 		    stderr,
-		    "Error: Constant brightness value (-c) not recognized.\n"
+		    "Error: Fractal type (-T) \"%s\" not recognized.\n",
+		    optarg
 		    );
+		argErrorFlag = 1;
+	    }
+	    break;
+
+	case 'P':
+	    // 'P' sets the power z is raised to, for multibrot sets and such.
+	    renderInput.calc.power = atoi(optarg);
+	    break;
+
+	case 'J':
+	    // 'J' renders an atlas of Julia sets, one for each constant given.
+	    options.atlasSpec = optarg;
+	    break;
+
+	case 'S':
+	    // 'S' saves each thumbnail of an atlas to its own file.
+	    options.separateFlag = 1;
+	    break;
+
+	case 'G':
+	    // 'G' renders a pyramid of map tiles, over the levels given.
+	    options.tileLevels = optarg;
+	    break;
 	    
-	    else
-		fprintf(
-		    stderr,
-		    "Error: Option (-%c) not recognized.\n",
-		    optopt
-		    );
+	case '?':
+	    // Case of an error in optarg parsing.
+	    reportOptionError(optopt);
 
 	    // Sets the argument failure flag.
 	    argErrorFlag = 1;
@@ -262,79 +1937,114 @@ int main(int argc, char *argv[])
 	}
     }
 
-    /* Checks if there are enough non-optional arguments. Sets the arg-error
-       flag if not. */
-    if (optind > argc - 2) {
-	fprintf(
-	    stderr,
-	    "Error: Resolution is missing one or more arguments.\n"
-	    );
-	argErrorFlag = 1;
-	
-    } else {
-	// If there are enough arguments for height and width, it retrieves them.
-	renderInput.draw.width  = abs(atoi(argv[optind]));
-	renderInput.draw.height = abs(atoi(argv[optind+1]));
-    }
+    /* Works out where the output goes. A name given with -O picks the format
+       by its extension, unless -F picked one, and the previews and frames are
+       named after it, less the extension. */
+    const char *extension = NULL;
 
-    
+    options.streamFlag = (options.outputPath != NULL &&
+			  strcmp(options.outputPath, STREAM_NAME) == 0);
 
-    // Checks for bad arguments.
-    if (renderInput.draw.width == 0) {
-	/* A negative or 0 width would cause no image to render.
-	   A 0 width would also cause FP exceptions (used as a divisor). */
-	fprintf(
-	    stderr,
-	    "Error: Width cannot be 0.\n"
-	    );
-	
-	argErrorFlag = 1;
-    }
-    
-    if (renderInput.draw.height == 0) {
-	// A negative or 0 height would cause no image to render.
+    if (options.outputPath != NULL && options.streamFlag == 0)
+	extension = renderOptionsExtension(options.outputPath);
+
+    if (extension != NULL && options.formatFlag == 0 &&
+	renderOptionsFormat(options.outputPath, &renderInput.format,
+			    &options.tiffFlag) != 0) {
 	fprintf(
 	    stderr,
-	    "Error: Height cannot be 0.\n"
+	    "Error: The format of \"%s\" (-O) is not known. Pick one with "
+	    "-F.\n",
+	    options.outputPath
 	    );
-	
+
 	argErrorFlag = 1;
     }
-    
-    if (renderInput.draw.zoomLevel == 0) {
-	/* A zoom level of 0 would cause FP exceptions, as the value is used
-	   as a divisor.
-	*/
+
+    if (options.streamFlag == 1 && isatty(STDOUT_FILENO)) {
+	// An image would only fill the screen with garbage.
 	fprintf(
 	    stderr,
-	    "Error: Cannot have 0 zoom.\n"
+	    "Error: Standard output (-O -) must be a file or a pipe.\n"
 	    );
-	
+
 	argErrorFlag = 1;
     }
-    
-    if (renderInput.color.maxIterations < 1) {
-	// An iteration count less than 1 can only paint black images.
+
+    const char  *baseName   = (options.outputPath != NULL) ?
+	options.outputPath : FILENAME_BASE;
+    const size_t baseLength = (extension != NULL) ?
+	(size_t) (extension - options.outputPath) : strlen(baseName);
+    char         outputBase[baseLength + 1];
+    char         defaultName[sizeof FILENAME_BASE + 16];
+
+    memcpy(outputBase, baseName, baseLength);
+    outputBase[baseLength] = '\0';
+
+    snprintf(defaultName, sizeof defaultName, FILENAME, FILENAME_BASE,
+	     options.tiffFlag ? "tif" :
+	     imageFormatExtension(renderInput.format));
+
+    const char *imageName = (options.outputPath != NULL) ?
+	options.outputPath : defaultName;
+
+    /* Recoloring only needs the color settings, since the size and iteration
+       count come from the file, so it is dealt with before anything else. */
+    if (options.escapeLoad != NULL)
+	return recolorWithOptions(renderInput, &options, argErrorFlag,
+				  imageName, outputBase, argc - optind,
+				  argv + optind);
+
+    /* Checks if there are enough non-optional arguments. Sets the arg-error
+       flag if not. */
+    if (optind > argc - 2) {
 	fprintf(
 	    stderr,
-	    "Error: Iteration count cannot be less than 1.\n"
+	    "Error: Resolution is missing one or more arguments.\n"
 	    );
-	
 	argErrorFlag = 1;
+
+    } else {
+	/* If there are enough arguments for height and width, it retrieves them.
+	   They are read as longs, so that sizes past what an int can hold are
+	   caught below, rather than wrapping around. */
+	renderInput.draw.width  = labs(strtol(argv[optind], NULL, 10));
+	renderInput.draw.height = labs(strtol(argv[optind+1], NULL, 10));
     }
-    
-    if (renderInput.draw.threadCount < 1) {
-	// A 0 or negative threadcount isn't going to be usable.
-	fprintf(
-	    stderr,
-	    "Error: Threadcount cannot be less than 1.\n"
-	    );
-	
-	argErrorFlag = 1;
+
+
+    /* Reads the constants of a Julia atlas, which the size of a packed atlas
+       depends on. */
+    tComplex *juliaConstants = NULL;
+    int       atlasCount     = 0;
+    int       atlasColumns   = 1;
+
+    if (options.atlasSpec != NULL) {
+	const int atlasStatus = readJuliaConstants(options.atlasSpec,
+						   &juliaConstants,
+						   &atlasCount, &atlasColumns);
+
+	if (atlasStatus == 1)
+	    argErrorFlag = 1;
+	else if (atlasStatus != 0)
+	    return atlasStatus;
     }
 
 
-    
+
+    // Checks for bad arguments, each mode's against the rest.
+    pyramidSettings   pyramid;
+    animationSettings animation;
+
+    argErrorFlag |= checkImageOptions(renderInput, &options);
+    argErrorFlag |= checkAtlasOptions(renderInput, &options, atlasCount,
+				      atlasColumns);
+    argErrorFlag |= checkPyramidOptions(renderInput, &options, &pyramid);
+    argErrorFlag |= checkAnimationOptions(renderInput, &options, &animation);
+    argErrorFlag |= checkOutputOptions(renderInput, &options);
+
+
+
     /* Exits the program if an input error occured, to prevent abnormal
        behavior.
     */
@@ -343,63 +2053,200 @@ int main(int argc, char *argv[])
 	    stderr,
 	    "Use -h for additional help.\n"
 	    );
-	
+	free(juliaConstants);
+
 	return 1;
     }
-    
-    
 
-    // Opens up the image to be written to.
-    renderInput.imageFile = fopen(FILENAME, "wb");
 
-    // Ensures that the file exists to prevent the program from writing to null.
-    if (renderInput.imageFile == NULL) {
-	return 3;
+
+    /* Makes room for the renderer to report back how each thread spent its
+       time, if statistics were asked for. */
+    renderStats stats;
+    renderInput.stats = NULL;
+
+    if (options.statsFlag == 1) {
+	stats.thread = calloc(renderInput.draw.threadCount, sizeof (threadStats));
+	if (stats.thread == NULL) {
+	    fprintf(
+		stderr,
+		"Error: Could not allocate memory for statistics.\n"
+		);
+
+	    return 2;
+	}
+
+	renderInput.stats = &stats;
+    }
+
+
+
+    /* Opens up the image to be written to, unless an animation's frames, an
+       atlas's thumbnails or a pyramid's tiles are all there is. A memory map of
+       it has to be able to read the file as well. */
+    renderInput.imageFile = NULL;
+
+    if (options.frameCount == 0 && options.separateFlag == 0 &&
+	options.tileLevels == NULL) {
+	renderInput.imageFile = openOutput(imageName, options.mappedFlag ?
+					   "wb+" : "wb");
+
+	// Ensures that the file exists to prevent the program writing to null.
+	if (renderInput.imageFile == NULL) {
+	    fprintf(
+		stderr,
+		"Error: Could not open \"%s\" (-O).\n",
+		imageName
+		);
+
+	    return 3;
+	}
+    }
+
+    /* Gives the file a large buffer, if asked for, so that the image goes to
+       disk in a few big writes instead of many small ones. */
+    char *writeBuffer = NULL;
+
+    if (options.bufferSize > 0 && renderInput.imageFile != NULL) {
+	writeBuffer = malloc((size_t) options.bufferSize << 20);
+
+	if (writeBuffer == NULL) {
+	    fprintf(
+		stderr,
+		"Error: Could not allocate the write buffer (-w).\n"
+		);
+	    closeOutput(renderInput.imageFile);
+
+	    return 2;
+	}
+
+	setvbuf(renderInput.imageFile, writeBuffer, _IOFBF,
+		(size_t) options.bufferSize << 20);
+    }
+
+    // Opens the file for the escape times, if they are to be saved.
+    renderInput.escapeFile = NULL;
+
+    if (options.escapeSave != NULL) {
+	renderInput.escapeFile = fopen(options.escapeSave, "wb");
+
+	if (renderInput.escapeFile == NULL) {
+	    fprintf(
+		stderr,
+		"Error: Could not open the escape time file (-r).\n"
+		);
+	    if (renderInput.imageFile != NULL)
+		closeOutput(renderInput.imageFile);
+	    free(writeBuffer);
+
+	    return 3;
+	}
     }
 
 
-    
+
     /* This section is where the actual rendering occurs, by making calls to
        the library to render the image.
      */
     int status = 0;
-    
-    /* Renders a Mandelbrot set, either normally, in parallel, or with minimized
-       RAM usage. */
-    if (renderInput.draw.threadCount > 1)
-	status = renderToTarga_parallel(renderInput);
-    
-    else if (lowMemoryFlag == 0)
-	status = renderToTarga(renderInput);
-   
-    else if (lowMemoryFlag == 1)
-	status = renderToTarga_lowMem(renderInput);
-    
-    else
+
+    // Progressive rendering saves a preview after every pass but the last.
+    previewContext preview = {renderInput.color, renderInput.format,
+			      outputBase, 0};
+
+    // The frames of an animation are named after the image.
+    frameContext frames  = {renderInput.format, outputBase, 0};
+    animation.openFrame  = openFrame;
+    animation.closeFrame = closeFrame;
+    animation.context    = &frames;
+
+    // Separate thumbnails of an atlas are named after the image.
+    frameContext  thumbnails = {renderInput.format, outputBase, 0};
+    atlasSettings atlas;
+    atlas.constants      = juliaConstants;
+    atlas.count          = atlasCount;
+    atlas.columns        = atlasColumns;
+    atlas.openThumbnail  = options.separateFlag ? openThumbnail : NULL;
+    atlas.closeThumbnail = closeThumbnail;
+    atlas.context        = &thumbnails;
+
+    // The tiles of a pyramid go in the directory named after the image.
+    frameContext  tiles = {renderInput.format, outputBase, 0};
+    pyramidCounts tileCounts;
+    pyramid.tileExists = tileExists;
+    pyramid.openTile   = openTile;
+    pyramid.closeTile  = closeTile;
+    pyramid.context    = &tiles;
+    pyramid.counts     = &tileCounts;
+
+    status = renderWithOptions(renderInput, &options, atlas, pyramid,
+			       animation, &preview);
+
+    /* Closes the image, flushing the write buffer before freeing it, which
+       means closing standard output too, as nothing else is written there. */
+    if (renderInput.imageFile != NULL &&
+	fclose(renderInput.imageFile) != 0 && status == 0)
+	status = 2;
+    free(writeBuffer);
+    free(juliaConstants);
+
+    // Closing the escape time file is the last chance to find write errors.
+    if (renderInput.escapeFile != NULL &&
+	fclose(renderInput.escapeFile) != 0 && status == 0) {
 	fprintf(
 	    stderr,
-	    "Impossible State: Low-memory flag is invalid (neither 0 or 1).\n"
+	    "Error: Could not write the escape time file (-r).\n"
 	    );
 
-    // Closes the targa image.
-    fclose(renderInput.imageFile);
+	return 3;
+    }
 
-    // Checks for memory allocation errors, if memory is allocated.
-    if (status == 1 && lowMemoryFlag == 0) {
+    if (frames.status != 0) {
 	fprintf(
 	    stderr,
-	    "Error: Could not allocate memory for image (approx. %lu bytes).\n",
-	    renderInput.draw.height * renderInput.draw.width * 3
+	    "Error: Could not write the animation frames (-a).\n"
 	    );
-	
-	return 2;
-    } else if (status == 1 && lowMemoryFlag == 1) {
+
+	return 3;
+    }
+
+    if (thumbnails.status != 0) {
 	fprintf(
 	    stderr,
-	    "Warning: Abornal exit status from low-memory rendering function.\n"
+	    "Error: Could not write the atlas thumbnails (-S).\n"
 	    );
-	
-	return 2;
+
+	return 3;
+    }
+
+    if (tiles.status != 0) {
+	fprintf(
+	    stderr,
+	    "Error: Could not write the pyramid tiles (-G).\n"
+	    );
+
+	return 3;
+    }
+
+    if (preview.status != 0 && status == 0) {
+	fprintf(
+	    stderr,
+	    "Error: Could not save the preview images (-n).\n"
+	    );
+
+	return 3;
+    }
+
+    // Says what went wrong with the renderer, if anything did.
+    const int exitStatus = renderExitStatus(status, renderInput, &options);
+
+    if (exitStatus != 0)
+	return exitStatus;
+
+    // Prints out the statistics, if asked for.
+    if (renderInput.stats != NULL) {
+	printStats(&stats, (options.tileLevels != NULL) ? &tileCounts : NULL);
+	free(stats.thread);
     }
 
     // If rendering has been successful, the program exits normally.
@@ -16,212 +16,523 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <math.h>
 #include <omp.h>
 #include "targa.h"
+#include "tileScheduler.h"
+#include "escapeKernel.h"
+#include "perturbation.h"
+#include "palette.h"
+#include "regionFill.h"
+#include "bandRing.h"
+#include "tiff.h"
+#include "imageWriter.h"
+#include "bufferPool.h"
 
 
 
+/* Number of pixels the renderers hand to the escape-time kernel at once. Long
+   enough to keep the vector kernels busy, short enough to sit on the stack. */
+#define SPAN_LENGTH 64
 
-// Mandelbrot transform, f(z) = z^2 + c, for making an escape-time algorithm.
-tComplex mandelbrot(const tComplex c, const tComplex z)
+// Width and height of the tiles renderToTarga_fill cuts the image into.
+#define FILL_TILE_SIZE 128
+
+/* Width and height of the tiles renderAnimation cuts frames into. Small enough
+   that most of a frame can be guessed from the last one tile by tile. */
+#define ANIMATION_TILE_SIZE 64
+
+/* Width and height of the tiles renderToTiff writes. TIFF wants a multiple of
+   16, and a tile this big makes for a short list of tiles in the header. */
+#define TIFF_TILE_SIZE 256
+
+/* Width and height of the tiles renderToTarga_mapped cuts the image into. Each
+   row of a tile lands on its own page of the file, so wide tiles touch fewer
+   pages for the pixels they cover. */
+#define MAPPED_TILE_SIZE 128
+
+// Once around a circle, for exponential maps.
+#define TWO_PI 6.28318530717958647692
+
+/* Rough size of a band of rows in renderToTarga_stream, and how many bands
+   each worker thread gets in the ring. A band is never less than one row. */
+#define STREAM_BAND_BYTES       (256 * 1024)
+#define STREAM_SLOTS_PER_THREAD 2
+
+
+
+
+/*
+ * Everything a renderer needs for turning pixels into colors: where the image
+ * lies on the complex plane, the kernel to iterate it with, and the palette to
+ * color it with. Worked out once per image by planRender, and cleaned up by
+ * finishRender.
+ */
+typedef struct {
+    calcSettings       calc;
+    escapeSpanKernel   escapeSpan;
+    escapePointsKernel escapePoints; // For pixels that are not in a row.
+    double             step;         // Distance between neighbouring pixels.
+    double             realStart;    // Real part of the left-most column.
+    double             imagStart;    // Imaginary part of the top row.
+    referenceOrbit     orbit;        // Only used in deep-zoom mode.
+    tPalette           palette;      // Colors of every escape time.
+    int                samples;      // Supersampling grid (draw.samples).
+
+    /* For exponential maps, where pixels are laid out by angle and distance
+       from a center, instead of on a grid. See planExpMap. */
+    int                expMap;
+    double             centerReal;
+    double             centerImag;
+    double             outerLog;     // Log of the radius of the top row.
+} renderPlan;
+
+
+
+
+/* Pre-calculates the constants needed for mapping the X-Y values of the image
+   to the desired location on the complex plane, and picks the kernels. Kept
+   apart from planRender, so the frames of an animation can share a palette. */
+static void planMapping(const renderSettings renderInput, renderPlan *plan)
+{
+    const double   dwidth    = (double) renderInput.draw.width;
+    const double   dheight   = (double) renderInput.draw.height;
+    const double   zoomLevel = renderInput.draw.zoomLevel;
+    const tComplex offset    = renderInput.draw.offset;
+
+    plan->calc      = renderInput.calc;
+    plan->expMap    = 0;
+    plan->samples   = renderInput.draw.samples;
+    plan->step      = 4 / (dwidth * zoomLevel);
+    plan->realStart = (-2.0 / zoomLevel) + offset.real;
+    plan->imagStart = (2.0 / zoomLevel) * dheight / dwidth + offset.imag;
+
+    // Picks the escape-time kernels once, for the whole image.
+    plan->escapeSpan   = escapeKernelSelect(plan->calc);
+    plan->escapePoints = escapePointsSelect(plan->calc);
+}
+
+
+
+
+/* Works out the mapping and kernels of the image, builds the palette, and in
+   deep-zoom mode, the reference orbit. Returns 1 if memory could not be
+   allocated. */
+static int planRender(const renderSettings renderInput, renderPlan *plan)
+{
+    const double dwidth    = (double) renderInput.draw.width;
+    const double dheight   = (double) renderInput.draw.height;
+    const double zoomLevel = renderInput.draw.zoomLevel;
+
+    // Works out every color the image can have, before drawing any of it.
+    if (paletteBuild(&plan->palette, renderInput.color) != 0)
+	return 1;
+
+    planMapping(renderInput, plan);
+
+    /* In deep-zoom mode, the kernel is handed distances from a reference
+       point instead (normally the center of the image), and the reference
+       orbit through it to measure them against. */
+    if (plan->calc.deepZoom) {
+	if (perturbationOrbit(&plan->orbit, plan->calc, renderInput.draw,
+			      renderInput.color.maxIterations) != 0) {
+	    paletteFree(&plan->palette);
+	    return 1;
+	}
+
+	plan->calc.reference = &plan->orbit;
+	plan->realStart      = -2.0 / zoomLevel - plan->orbit.offsetReal;
+	plan->imagStart      = (2.0 / zoomLevel) * dheight / dwidth -
+	    plan->orbit.offsetImag;
+    }
+
+    return 0;
+}
+
+
+
+
+/*
+ * Turns a plan into one for an exponential map of the view in renderInput.
+ * Column x is at an angle of step * x around the center, and row y at a
+ * distance of e^(outerLog - step * y) from it, so each pixel is as tall as it
+ * is wide, and every row is a zoom of e^step on the one above. The top row
+ * passes through the corners of the view. In deep-zoom mode, the center is
+ * given as a distance from the reference point, like everything else.
+ */
+static void planExpMap(const renderSettings renderInput, renderPlan *plan)
+{
+    plan->expMap   = 1;
+    plan->samples  = 1; // Supersampling only knows about grids of pixels.
+    plan->step     = TWO_PI / renderInput.draw.width;
+    plan->outerLog = log(EXP_MAP_OUTER / renderInput.draw.zoomLevel);
+
+    if (plan->calc.deepZoom) {
+	plan->centerReal = -plan->orbit.offsetReal;
+	plan->centerImag = -plan->orbit.offsetImag;
+    } else {
+	plan->centerReal = renderInput.draw.offset.real;
+	plan->centerImag = renderInput.draw.offset.imag;
+    }
+}
+
+
+
+
+// Frees anything planRender allocated.
+static void finishRender(renderPlan *plan)
+{
+    paletteFree(&plan->palette);
+
+    if (plan->calc.deepZoom)
+	perturbationFreeOrbit(&plan->orbit);
+}
+
+
+
+
+// Fills in the statistics for a renderer that only ever uses one thread.
+static void reportSerialStats(renderStats *stats, const double renderTime)
+{
+    if (stats == NULL)
+	return;
+
+    stats->renderTime  = renderTime;
+    stats->threadCount = 1;
+    stats->thread[0]   = (threadStats) {renderTime, 0, 0, 0};
+}
+
+
+
+
+/* Works out the escape times of a span of pixels, and their smooth escape
+   times too if those were asked for. */
+static void renderSpan(const renderPlan *plan,
+		       const int         maxIterations,
+		       const int         x,
+		       const double      imag,
+		       const int         count,
+		       int              *escapes,
+		       float            *smooth)
+{
+    if (plan->calc.smooth)
+	escapeSpanSmooth(maxIterations, plan->calc, plan->realStart,
+			 plan->step, x, imag, count, escapes, smooth);
+    else
+	plan->escapeSpan(maxIterations, plan->calc, plan->realStart,
+			 plan->step, x, imag, count, escapes);
+}
+
+
+
+
+/* Works out a span of pixels straight into colors, for the renderers that
+   never keep the escape times around. Spans are at most SPAN_LENGTH long. */
+static void renderColorSpan(const renderPlan *plan,
+			    const int         maxIterations,
+			    const int         x,
+			    const double      imag,
+			    const int         count,
+			    tRGB             *pixels)
+{
+    int   escapes[SPAN_LENGTH];
+    float smooth[SPAN_LENGTH];
+
+    renderSpan(plan, maxIterations, x, imag, count, escapes, smooth);
+
+    for (int i = 0; i < count; i++)
+	pixels[i] = plan->calc.smooth ?
+	    paletteSmoothColor(&plan->palette, escapes[i], smooth[i]) :
+	    paletteColor(&plan->palette, escapes[i]);
+}
+
+
+
+
+// Colors one row of an escape buffer, looking every pixel up in the palette.
+static void colorizeRow(const tEscapeBuffer *escapes,
+			const tPalette      *palette,
+			const int            y,
+			tRGB                *row)
+{
+    const size_t start = (size_t) y * escapes->width;
+
+    if (escapes->smooth != NULL) {
+	const float *smooth = escapes->smooth + start;
+
+	for (int x = 0; x < escapes->width; x++)
+	    row[x] = paletteSmoothColor(palette,
+					escapeBufferGet(escapes, x, y),
+					smooth[x]);
+
+    } else if (escapes->countSize == 2) {
+	const uint16_t *counts = escapes->counts16 + start;
+
+	for (int x = 0; x < escapes->width; x++)
+	    row[x] = paletteColor(palette, counts[x]);
+
+    } else {
+	const uint32_t *counts = escapes->counts32 + start;
+
+	for (int x = 0; x < escapes->width; x++)
+	    row[x] = paletteColor(palette, counts[x]);
+    }
+}
+
+
+
+
+/* Where a sample goes within its own square of a pixel, from 0 to 1 either
+   way. Picked by hashing the pixel and the sample, rather than at random, so
+   that the same image always comes out the same. */
+static inline double sampleJitter(const int x, const int y, const int i)
 {
-    tComplex newZ;
-    newZ.real = z.real * z.real - z.imag * z.imag + c.real;
-    newZ.imag = 2 * z.real * z.imag + c.imag;
+    uint32_t hash = (uint32_t) x * 0x9e3779b1u ^ (uint32_t) y * 0x85ebca77u ^
+	(uint32_t) i * 0xc2b2ae3du;
+
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    hash ^= hash >> 16;
 
-    return newZ;
+    return hash / 4294967296.0;
 }
 
 
 
 
-// Finds out how many iterations it takes for a complex point to diverge.
-int escapeTime(const int maxIterations, const tComplex c, calcSettings calc)
+/*
+ * Smooths the edges of a colored row, for plans with more than one sample.
+ * Any pixel with an escape time that differs from one of its four neighbours
+ * is worked out again at a grid of samples, one jittered about each square of
+ * the grid, and gets the average of their colors. Every other pixel keeps its
+ * one color, so the extra work is only done where there are edges, and the
+ * samples are averaged as soon as they are worked out, so there is never an
+ * image any bigger than the output.
+ */
+static void supersampleRow(const tEscapeBuffer *escapes,
+			   const renderPlan    *plan,
+			   const tPalette      *palette,
+			   const int            y,
+			   tRGB                *row)
 {
-    // If not rendering a Julia set, render a Mandelbrot set.
-    if (calc.juliaFlag == 0) {
-	tComplex z;
-	z.real = 0;
-	z.imag = 0;
+    const int width   = escapes->width;
+    const int height  = escapes->height;
+    const int grid    = plan->samples;
+    const int samples = grid * grid;
+    double    real[SPAN_LENGTH];
+    double    imag[SPAN_LENGTH];
+    int       sampleEscapes[SPAN_LENGTH];
+    float     sampleSmooth[SPAN_LENGTH];
+    int       columns[SPAN_LENGTH]; // Pixel each group of samples is for.
+    int       count = 0;            // Pixels in the batch so far.
+
+    // Functions for mapping a point of the image onto the complex plane.
+    double scaleX(double x) {
+	return plan->realStart + plan->step * x;
+    }
+    double scaleY(double y) {
+	return plan->imagStart - plan->step * y;
+    }
+
+    // Works out a batch of samples, and colors their pixels with them.
+    void finishBatch(void) {
+	const int points = count * samples;
+
+	if (plan->calc.smooth) {
+	    for (int i = 0; i < points; i++)
+		escapeSpanSmooth(escapes->maxIterations, plan->calc, real[i],
+				 plan->step, 0, imag[i], 1, &sampleEscapes[i],
+				 &sampleSmooth[i]);
+	} else {
+	    plan->escapePoints(escapes->maxIterations, plan->calc, real, imag,
+			       points, sampleEscapes);
+	}
+
+	for (int pixel = 0; pixel < count; pixel++) {
+	    int red = 0, green = 0, blue = 0;
 
-	// Counts down the number of iterations it takes for a point to escape.
-	for (int iterations = maxIterations; iterations > 0; iterations--) {
-	    z = mandelbrot(c, z);
+	    for (int i = pixel * samples; i < (pixel + 1) * samples; i++) {
+		const tRGB color = plan->calc.smooth ?
+		    paletteSmoothColor(palette, sampleEscapes[i],
+				       sampleSmooth[i]) :
+		    paletteColor(palette, sampleEscapes[i]);
+
+		red   += color.r;
+		green += color.g;
+		blue  += color.b;
+	    }
 
-	    if ((z.real * z.real + z.imag * z.imag) >= 4)
-		return iterations;
+	    row[columns[pixel]].r = (red + samples / 2) / samples;
+	    row[columns[pixel]].g = (green + samples / 2) / samples;
+	    row[columns[pixel]].b = (blue + samples / 2) / samples;
 	}
 
-	// If the point did not diverge, an empty value is returned.
-	return 0;
+	count = 0;
     }
-    
-    /*
-     * Otherwise, we are rendering a Julia set. This means changing the first
-     * argument of the mandelbrot function to a value that is the same for every
-     * point, and changing the initial value of Z to that of the input complex
-     * value.
-     */
-    else {
-	// Sets the initial value to the complex input value.
-	tComplex z = c;
 
-	// Counts down the number of iterations it takes for a point to escape.
-	for (int iterations = maxIterations; iterations > 0; iterations--) {
-	    z = mandelbrot(calc.juliaConstant, z);
+    for (int x = 0; x < width; x++) {
+	const int escape = escapeBufferGet(escapes, x, y);
+
+	if ((x == 0 || escapeBufferGet(escapes, x - 1, y) == escape) &&
+	    (x == width - 1 || escapeBufferGet(escapes, x + 1, y) == escape) &&
+	    (y == 0 || escapeBufferGet(escapes, x, y - 1) == escape) &&
+	    (y == height - 1 || escapeBufferGet(escapes, x, y + 1) == escape))
+	    continue;
 
-	    if ((z.real * z.real + z.imag * z.imag) >= 4)
-		return iterations;
+	if ((count + 1) * samples > SPAN_LENGTH)
+	    finishBatch();
+
+	for (int i = 0; i < samples; i++) {
+	    const double dx = (i % grid + sampleJitter(x, y, 2 * i)) / grid;
+	    const double dy = (i / grid + sampleJitter(x, y, 2 * i + 1)) / grid;
+
+	    real[count * samples + i] = scaleX(x + dx - 0.5);
+	    imag[count * samples + i] = scaleY(y + dy - 0.5);
 	}
 
-	// If the point did not diverge, an empty value is returned.
-	return 0;
+	columns[count++] = x;
     }
 
-    /* 
-     * If you ever need to add new Fractal types, modify the calcSettings type
-     * to add a new flag (or modify the old flag) to allow setting the new
-     * fractal type, and add in any additional parameters needed.
-     *
-     * Note: I'm aware that this setup means that I'm performing a few million
-     * more boolean operations, and that only 1 operation is really necessary;
-     * but the image itself already uses around a billion operations by default.
-     *
-     * It's simpler to check here instead of implementing whole new sets of
-     * functions, as this means you don't have to modify anything else about
-     * the renderer.
-     */
+    if (count > 0)
+	finishBatch();
 }
 
 
 
 
-// Outputs a color, based on the escape time.
-tRGB escapeColor(const int escapeTime,
-		 const colorSettings color)
+/*
+ * Colors an escape buffer into an image, a batch of segments at a time. The
+ * segments of a batch are colored and encoded by threadCount threads at once,
+ * then written out in order, so only a batch of segments is ever held in
+ * memory, besides the escape times. With a plan that takes more than one
+ * sample, the edges are supersampled along the way.
+ */
+static int colorizeWithPalette(const tEscapeBuffer *escapes,
+			       const tPalette      *palette,
+			       const renderPlan    *plan,
+			       const imageFormat    format,
+			       const int            threadCount,
+			       FILE                *imageFile)
 {
-    // Unpacks the used color settings.
-    int    maxIterations = color.maxIterations;
-    double constantLight = color.constantLight;
-    double hueLimiter    = color.hueLimiter;
-    double hueOffset     = color.hueOffset;
-    double lightMax      = color.lightMax;
-    double lightDist     = color.lightDistribution;
-    
-    // RGB color value to return.
-    tRGB colorReturn;
-
-    /* Points with zeroed-out escape time are assumed to be in the mandelbrot
-       set. */
-    if (escapeTime == 0) {
-	colorReturn.r = 0;
-	colorReturn.g = 0;
-	colorReturn.b = 0;
-	return colorReturn;
-    }
-
-    // Calculates the ratio between the escape time and maximum iteration count.
-    const double eTime  = (double) escapeTime;
-    const double mIter  = (double) maxIterations;
-    const double eRatio = eTime / mIter;
-
-    // The color is being calculated in an HSL color-space.
-    double hue;
-    double saturation;
-    double lightness;
-
-    // Calculates the hue, as a function of the escape-time ratio.
-    hue  = 360.0 - 360.0 * eRatio * hueLimiter;
-    hue  = fmod(hue, 360.0);
-    hue += hueOffset;
-    hue  = fmod(hue, 360.0);
-
-    // Calculates the saturation. This is currently a fixed value.
-    saturation = 1;
-
-    /* Calculates the lightness, either as a function of escape-time ratio, or
-       as a constant value. */
-    if (constantLight == 0) {
-	lightness   = lightMax * pow(eRatio, lightDist);
-	lightness   = lightMax - lightness;
-    } else {
-	lightness = constantLight;
+    const int    width        = escapes->width;
+    const int    height       = escapes->height;
+    const int    segmentRows  = imageSegmentRows(width);
+    const size_t segmentBytes = imageSegmentBytes(format, width, segmentRows);
+
+    /* Colors, encoded bytes and scratch space for each segment of a batch,
+       taken from the same pool as the escape times, if they came from one. */
+    bufferPool    *pool      = escapes->pool;
+    tRGB          *colors    = bufferPoolTake(pool, (size_t) threadCount *
+					      segmentRows * width *
+					      sizeof *colors);
+    unsigned char *encoded   = bufferPoolTake(pool,
+					      threadCount * segmentBytes);
+    imageWorkspace workspace[threadCount];
+    imageSegment   segment[threadCount];
+    int            allocated = 0;
+
+    while (allocated < threadCount &&
+	   imageWorkspaceAllocate(&workspace[allocated], format, width,
+				  segmentRows) == 0)
+	allocated++;
+
+    if (colors == NULL || encoded == NULL || allocated < threadCount) {
+	for (int i = 0; i < allocated; i++)
+	    imageWorkspaceFree(&workspace[i]);
+
+	bufferPoolGive(pool, colors);
+	bufferPoolGive(pool, encoded);
+	return 1;
     }
-    
-    /* en.wikipedia.org/wiki/HSL_and_HSV#From_HSL -> source of HSL to RGB color
-       conversion. */
-
-    // Calculates chroma value of the pixel.
-    double chroma;
-    chroma  = 1.0 - fabs(2.0 * lightness - 1.0);
-    chroma *= saturation;
-
-    // Because smaller numbers look neater. Or something like that.
-    hue /= 60.0;
-
-    // Calculates an intermediate value, X.
-    double X;
-    X  = 1.0 - fabs(fmod(hue, 2.0) - 1.0);
-    X *= chroma;
-
-    // Finds out the appropriate RGB values based on Hue.
-    double r = 0;
-    double g = 0;
-    double b = 0;
-    if (hue < 1.0) {
-	r = chroma;
-	g = X;
-    } else if (hue < 2.0) {
-	r = X;
-	g = chroma;
-    } else if (hue < 3.0) {
-	g = chroma;
-	b = X;
-    } else if (hue < 4.0) {
-	g = X;
-	b = chroma;
-    } else if (hue < 5.0) {
-	r = X;
-	b = chroma;
-    } else if (hue < 6.0) {
-	r = chroma;
-	b = X;
-    }
-
-    // Calculates an intermediate value, m, to translate the RGB values.
-    double m = lightness - 0.5 * chroma;
-
-    // Translates the RGB values.
-    r += m;
-    b += m;
-    g += m;
-
-    // Converts the RGB values to 8 bit integers and saves them to the output.
-    r *= 255;
-    g *= 255;
-    b *= 255;
-    colorReturn.r = ((unsigned int) ceil(r)) & 0x00FF;
-    colorReturn.g = ((unsigned int) ceil(g)) & 0x00FF;
-    colorReturn.b = ((unsigned int) ceil(b)) & 0x00FF;
-    
-    // Returns the final color value of the pixel.
-    return colorReturn;
+
+    imageWriter writer;
+    imageWriterStart(&writer, format, width, height, imageFile);
+
+    for (int top = 0; top < height; top += threadCount * segmentRows) {
+	const int left  = (height - top + segmentRows - 1) / segmentRows;
+	const int count = (left < threadCount) ? left : threadCount;
+
+	#pragma omp parallel for num_threads(threadCount) schedule(static, 1)
+	for (int i = 0; i < count; i++) {
+	    const int first  = top + i * segmentRows;
+	    const int rows   = (height - first < segmentRows) ?
+		height - first : segmentRows;
+	    tRGB     *pixels = colors + (size_t) i * segmentRows * width;
+
+	    for (int y = 0; y < rows; y++) {
+		colorizeRow(escapes, palette, first + y,
+			    pixels + (size_t) y * width);
+
+		if (plan != NULL && plan->samples > 1)
+		    supersampleRow(escapes, plan, palette, first + y,
+				   pixels + (size_t) y * width);
+	    }
+
+	    segment[i] = imageEncodeSegment(pixels, width, rows, &workspace[i],
+					    encoded + i * segmentBytes);
+	}
+
+	for (int i = 0; i < count; i++)
+	    imageWriteSegment(&writer, &segment[i], encoded + i * segmentBytes);
+    }
+
+    imageWriterFinish(&writer);
+
+    for (int i = 0; i < threadCount; i++)
+	imageWorkspaceFree(&workspace[i]);
+
+    bufferPoolGive(pool, colors);
+    bufferPoolGive(pool, encoded);
+
+    return 0;
+}
+
+
+
+
+/* Colors a finished escape buffer into an image. The iteration count of the
+   buffer is used in place of the one in the color settings, as that is what
+   the escape times were counted against. */
+int colorizeToTarga(const tEscapeBuffer *escapes,
+		    colorSettings        color,
+		    const imageFormat    format,
+		    const int            threadCount,
+		    FILE                *imageFile)
+{
+    tPalette palette;
+
+    color.maxIterations = escapes->maxIterations;
+
+    if (paletteBuild(&palette, color) != 0)
+	return 1;
+
+    const int status = colorizeWithPalette(escapes, &palette, NULL, format,
+					   threadCount, imageFile);
+    paletteFree(&palette);
+
+    return status;
 }
 
 
 
 
-// Calculates an RGB pixel value based off a complex point. 
-tRGB escapePixel(const tComplex      c,
-		 const colorSettings color,
-		 const calcSettings  calc)
+/* Saves the escape times, if asked for, then colors them into the image. Write
+   errors on the escape file are left for the caller to find, as with the
+   image. */
+static int finishEscapes(const renderSettings renderInput,
+			 const renderPlan    *plan,
+			 const tEscapeBuffer *escapes)
 {
-    // Calculates the escape-time value at the current complex point.
-    int eTime = escapeTime(color.maxIterations, c, calc);
+    if (renderInput.escapeFile != NULL)
+	escapeBufferWrite(escapes, renderInput.escapeFile);
 
-    // Calculates the color value based on escape time, and returns it.
-    return escapeColor(eTime, color);
+    return colorizeWithPalette(escapes, &plan->palette, plan,
+			       renderInput.format, renderInput.draw.threadCount,
+			       renderInput.imageFile);
 }
 
 
@@ -232,243 +543,2378 @@ tRGB escapePixel(const tComplex      c,
 int renderToTarga(const renderSettings renderInput)
 {
     // Unpacks the inputs.
-    FILE               *imageFile = renderInput.imageFile;
     const int           width     = renderInput.draw.width;
     const int           height    = renderInput.draw.height;
-    const tComplex      offset    = renderInput.draw.offset;
-    const double        zoomLevel = renderInput.draw.zoomLevel;
     const colorSettings color     = renderInput.color;
-    const calcSettings  calc      = renderInput.calc;
 
-    // Allocates a 2D tRGB array for temporarily storing the image render.
-    tRGB **mandelbrot;
-    tRGB  *mandelbrotData;
-    mandelbrotData = targaAllocateImage(&mandelbrot, width, height);
+    /* The escape times are worked out first, and only colored once the whole
+       image is done, so they can be saved as they are. */
+    tEscapeBuffer escapes;
 
     // Checks for memory allocation failure, and throws an error status if so.
-    if (mandelbrot == NULL || mandelbrotData == NULL)
+    if (escapeBufferAllocateFrom(&escapes, renderInput.pool, width, height,
+				 color.maxIterations,
+				 renderInput.calc.smooth) != 0)
 	return 1;
 
-    /* Pre-calculates the constants needed for mapping the X-Y values of the
-       image to the desired locaiton on the complex plane. */
-    const double dwidth    = (double) width;
-    const double dheight   = (double) height;
-    const double step      = 4 / (dwidth * zoomLevel);
-    const double realStart = (-2.0 / zoomLevel) + offset.real;
-    const double imagStart = (2.0 / zoomLevel) * dheight / dwidth - offset.imag;
-    
-    // Function for calculating the imaginary part of a point from the X value.
-    double scaleX(int x) {
-	return realStart + step * x;
+    // Works out where the image lies, and how to calculate it.
+    renderPlan plan;
+    if (planRender(renderInput, &plan) != 0) {
+	escapeBufferDeallocate(&escapes);
+	return 1;
     }
 
-    // Function for calculating the real part of a point from the Y value.
+    // Function for calculating the imaginary part of a point from the Y value.
     double scaleY(int y) {
-	return imagStart - step * y;
+	return plan.imagStart - plan.step * y;
     }
 
-    // Renders the mandelbrot to RAM, one pixel at a time.
+    const double startTime = omp_get_wtime();
+
+    // Renders the mandelbrot to RAM, one span of pixels at a time.
     for (int y = 0; y < height; y++) {
-	for (int x = 0; x < width; x++) {
-	    tComplex cursor;
-	    cursor.real = scaleX(x);
-	    cursor.imag = scaleY(y);
-	    
-	    // Calculates and saves a 24 bit RGB pixel to the image.
-	    mandelbrot[x][y] = escapePixel(cursor, color, calc);
+	for (int x = 0; x < width; x += SPAN_LENGTH) {
+	    const int spanLength = (width - x < SPAN_LENGTH) ?
+		width - x : SPAN_LENGTH;
+	    int       spanEscapes[SPAN_LENGTH];
+	    float     spanSmooth[SPAN_LENGTH];
+
+	    renderSpan(&plan, color.maxIterations, x, scaleY(y), spanLength,
+		       spanEscapes, spanSmooth);
+	    escapeBufferStore(&escapes, x, y, spanLength, spanEscapes,
+			      spanSmooth);
 	}
     }
 
-    // Saves the render to a TARGA file for viewing, and deallocates memory.
-    targaWriteImage_RGB24(mandelbrot, width, height, imageFile);
-    targaDeallocateImage(&mandelbrot, mandelbrotData);
+    reportSerialStats(renderInput.stats, omp_get_wtime() - startTime);
 
-    return 0;
+    // Saves the render to an image file for viewing, and deallocates memory.
+    const int status = finishEscapes(renderInput, &plan, &escapes);
+    finishRender(&plan);
+    escapeBufferDeallocate(&escapes);
+
+    return status;
 }
 
 
 
 
-// A concurrent version of renderToTarga.
-int renderToTarga_parallel(const renderSettings renderInput)
+/* What the fill routines need to work out a batch of pixels: the plan of the
+   image, and the iteration count. */
+typedef struct {
+    const renderPlan *plan;
+    int               maxIterations;
+} fillContext;
+
+
+
+
+/* Pixel function for the fill routines. Maps the pixels onto the complex plane
+   the same way the span kernels do, so every pixel gets the same escape time
+   either way, or by angle and distance for exponential maps. */
+static void fillPixels(const void *context, const int *x, const int *y,
+		       const int count, int *escapes)
+{
+    const fillContext *fill = context;
+    const renderPlan  *plan = fill->plan;
+
+    for (int start = 0; start < count; start += SPAN_LENGTH) {
+	const int n = (count - start < SPAN_LENGTH) ?
+	    count - start : SPAN_LENGTH;
+	double    real[SPAN_LENGTH];
+	double    imag[SPAN_LENGTH];
+
+	for (int i = 0; i < n; i++) {
+	    if (plan->expMap) {
+		const double radius = exp(plan->outerLog -
+					  plan->step * y[start + i]);
+		const double angle  = plan->step * x[start + i];
+
+		real[i] = plan->centerReal + radius * cos(angle);
+		imag[i] = plan->centerImag + radius * sin(angle);
+	    } else {
+		real[i] = plan->realStart + plan->step * x[start + i];
+		imag[i] = plan->imagStart - plan->step * y[start + i];
+	    }
+	}
+
+	plan->escapePoints(fill->maxIterations, plan->calc, real, imag, n,
+			   escapes + start);
+    }
+}
+
+
+
+
+/*
+ * Draws an image in parallel, tile by tile, into an escape buffer, which is
+ * left for the caller, along with the plan, once it returns 0. The image is
+ * cut into tiles, which are handed out to the threads by a work-stealing
+ * scheduler. Each tile is either worked out in full, or with one of the fill
+ * modes. Exponential maps have no rows for the span kernels to run along, so
+ * their tiles always go through the fill routines, which work out every pixel
+ * when there is no fill mode.
+ */
+static int drawTiles(const renderSettings renderInput,
+		     const int            tileSize,
+		     const fillMode       fill,
+		     const int            expMap,
+		     tEscapeBuffer       *escapes,
+		     renderPlan          *plan)
 {
     // Unpacks the inputs.
-    FILE               *imageFile   = renderInput.imageFile;
     const int           width       = renderInput.draw.width;
     const int           height      = renderInput.draw.height;
     const int           threadCount = renderInput.draw.threadCount;
-    const tComplex      offset      = renderInput.draw.offset;
-    const double        zoomLevel   = renderInput.draw.zoomLevel;
     const colorSettings color       = renderInput.color;
-    const calcSettings  calc        = renderInput.calc;
-    
+    renderStats        *stats       = renderInput.stats;
+
     // Sets the thread count to the input amount.
     omp_set_num_threads(threadCount);
 
     /* 
-     * The multithreading here works by giving each thread a row of the image
-     * to render. To prevent cache-swapping, and to keep the malloc calls low,
-     * each thread is given its own miniature image that it writes to.
-     *
-     * When done rendering, the miniature images are "interlaced" together to
-     * make the final complete image.
+     * Every thread draws straight into one shared escape buffer. Tiles never
+     * overlap, so no two threads ever write to the same pixel, and without a
+     * fill mode the finished image is exactly what renderToTarga would have
+     * drawn.
      */
-    tRGB **threadImages[threadCount];
-    tRGB  *threadImagesData[threadCount];
-    const int miniHeight = height / threadCount;
-
-    // Allocates the image for each thread.
-    for (int i = 0; i < threadCount; i++) {
-	threadImagesData[i] = targaAllocateImage(&threadImages[i],
-						 width,
-						 miniHeight);
-
-	/* If an image allocation failed, then we deallocate all previously
-	   allocated images (if any), and return an error. */
-	if (threadImagesData[i] == NULL || threadImages[i] == NULL) {
-	    for (int j = 0; j < i; j++)
-		targaDeallocateImage(&threadImages[j], threadImagesData[j]);
-	    
-	    return 1;
-	}
+
+    // Checks for memory allocation failure, and throws an error status if so.
+    if (escapeBufferAllocateFrom(escapes, renderInput.pool, width, height,
+				 color.maxIterations,
+				 renderInput.calc.smooth) != 0)
+	return 1;
+
+    // Marks the escape times as a map, for whoever reads them back.
+    escapes->expMap = expMap;
+
+    /* Each thread gets its own queue of tiles. If OpenMP gives us fewer
+       threads than asked for, the unowned queues just get stolen from. */
+    tileScheduler scheduler;
+    if (tileSchedulerInit(&scheduler, width, height,
+			  tileSize, threadCount) != 0) {
+	escapeBufferDeallocate(escapes);
+	return 1;
     }
 
-    /* Pre-calculates the constants needed for mapping the X-Y values of the
-       image to the desired locaiton on the complex plane. */
-    const double dwidth    = (double) width;
-    const double dheight   = (double) height;
-    const double step      = 4 / (dwidth * zoomLevel);
-    const double realStart = (-2.0 / zoomLevel) + offset.real;
-    const double imagStart = (2.0 / zoomLevel) * dheight / dwidth - offset.imag;
-    
-    // Function for calculating the imaginary part of a point from the X value.
-    double scaleX(int x) {
-	return realStart + step * x;
+    // The fill routines need some scratch space for each thread.
+    const int       regions        = fill != FILL_NONE || expMap;
+    regionWorkspace workspaces[threadCount];
+    int             workspaceCount = 0;
+    int             status         = 0;
+
+    if (regions) {
+	for (; workspaceCount < threadCount && status == 0; workspaceCount++)
+	    status = regionWorkspaceAllocate(&workspaces[workspaceCount],
+					     tileSize);
+    }
+
+    /* Works out where the image lies, and how to calculate it. A deep zoom's
+       reference orbit has to last all the way down an exponential map, so it
+       is worked out for the bottom row's zoom level. */
+    renderSettings planInput = renderInput;
+
+    if (expMap)
+	planInput.draw.zoomLevel *= expMapDepth(width, height);
+
+    if (status != 0 || planRender(planInput, plan) != 0) {
+	for (int i = 0; i < workspaceCount; i++)
+	    regionWorkspaceFree(&workspaces[i]);
+
+	tileSchedulerFree(&scheduler);
+	escapeBufferDeallocate(escapes);
+	return 1;
     }
 
-    // Function for calculating the real part of a point from the Y value.
+    if (expMap)
+	planExpMap(renderInput, plan);
+
+    const fillContext context = {plan, color.maxIterations};
+
+    // Function for calculating the imaginary part of a point from the Y value.
     double scaleY(int y) {
-	return imagStart - step * y;
+	return plan->imagStart - plan->step * y;
     }
 
-    /* 
-     * Starts a parallel block of code. A number of threads execute each 
-     * instruction, with the only differences occuring from the use of the
-     * thread's unique ID.
-     */
+    // Time spent drawing by each thread, for the statistics.
+    threadStats threadTimes[threadCount];
+    for (int i = 0; i < threadCount; i++)
+	threadTimes[i] = (threadStats) {0, 0, 0, 0};
+
+    const double startTime = omp_get_wtime();
+    
+    // Starts a parallel block of code, where each thread keeps taking tiles.
     #pragma omp parallel
     {
 	// Gets the thread number.
 	int threadID = omp_get_thread_num();
 
-	// Copies of external variables are created, to prevent race-conditions.
-	tRGB          **threadImage;
-	int             threadHeight;
-	int             threadWidth;
-	int             threadThreadCount;
-	colorSettings   threadColor;
-	calcSettings    threadCalc;
-	
-	// Gets needed outside variables in a mutual-exclusion block.
-	#pragma omp critical
-	{
-	    threadImage       = threadImages[threadID];
-	    threadHeight      = miniHeight;
-	    threadWidth       = width;
-	    threadColor       = color;
-	    threadCalc        = calc;
-	    threadThreadCount = threadCount;
-	}
-	
-	// Renders the mini-image unique to the thread.
-	for (int y = 0; y < threadHeight; y++) { 
-	    for (int x = 0; x < threadWidth; x++) {
-		// Finds the complex point that the X-Y position maps to.
-		tComplex threadCursor;
-		threadCursor.real = scaleX(x);
-		threadCursor.imag = scaleY(y * threadThreadCount + threadID);
-
-		// Calculates and saves a 24 bit RGB pixel to the local image.
-		threadImage[x][y] = escapePixel(threadCursor,
-						threadColor,
-						threadCalc);
+	threadStats *times = &threadTimes[threadID];
+	tTile        tile;
+	int          stolen;
+
+	while (tileSchedulerNext(&scheduler, threadID, &tile, &stolen)) {
+	    const double tileStart = omp_get_wtime();
+
+	    if (regions) {
+		// Fills the tile in, then copies it into the shared buffer.
+		regionWorkspace *workspace = &workspaces[threadID];
+
+		regionFill(fill, &tile, fillPixels, &context, workspace);
+
+		for (int y = 0; y < tile.height; y++)
+		    escapeBufferStore(escapes, tile.x, tile.y + y, tile.width,
+				      workspace->escapes + y * tile.width,
+				      NULL);
+	    } else {
+		// Renders the tile into the shared buffer, a row at a time.
+		for (int y = tile.y; y < tile.y + tile.height; y++) {
+		    int   spanEscapes[TILE_SIZE_DEFAULT];
+		    float spanSmooth[TILE_SIZE_DEFAULT];
+
+		    renderSpan(plan, color.maxIterations, tile.x, scaleY(y),
+			       tile.width, spanEscapes, spanSmooth);
+		    escapeBufferStore(escapes, tile.x, y, tile.width,
+				      spanEscapes, spanSmooth);
+		}
 	    }
+
+	    times->busyTime   += omp_get_wtime() - tileStart;
+	    times->tileCount  += 1;
+	    times->stealCount += stolen;
 	}
     } // End of parallel code.
 
-    // Writes a header for an uncompressed RGB 24 bit TARGA image to the file.
-    targaWriteHeader_RGB24(width, height, imageFile);
+    const double renderTime = omp_get_wtime() - startTime;
+    tileSchedulerFree(&scheduler);
 
-    // Writes out each threads' mini-image to the disk, interlaced together.
-    for (int y = 0; y < miniHeight; y++)
-	for (int i = 0; i < threadCount; i++)
-	    for (int x = 0; x < width; x++)
-		targaWritePixel_RGB24(threadImages[i][x][y], imageFile);
+    for (int i = 0; i < workspaceCount; i++)
+	regionWorkspaceFree(&workspaces[i]);
+
+    // Anything a thread did not spend drawing, it spent waiting.
+    if (stats != NULL) {
+	stats->renderTime  = renderTime;
+	stats->threadCount = threadCount;
+
+	for (int i = 0; i < threadCount; i++) {
+	    stats->thread[i]          = threadTimes[i];
+	    stats->thread[i].idleTime = renderTime - threadTimes[i].busyTime;
+	}
+    }
 
-    // Deallocates the threads' images.
-    for (int i = 0; i < threadCount; i++)
-	targaDeallocateImage(&threadImages[i], threadImagesData[i]);
-    
     return 0;
 }
 
 
 
 
-// Variant of renderToTarga, but writes directly to the disk.
-int renderToTarga_lowMem(const renderSettings renderInput)
+/* Renders an image in parallel, tile by tile, into an escape buffer, then
+   colors it into the image file. */
+static int renderTiles(const renderSettings renderInput,
+		       const int            tileSize,
+		       const fillMode       fill,
+		       const int            expMap)
 {
-    // Unpacks the inputs.
-    FILE               *imageFile = renderInput.imageFile;
-    const int           width     = renderInput.draw.width;
-    const int           height    = renderInput.draw.height;
-    const tComplex      offset    = renderInput.draw.offset;
-    const double        zoomLevel = renderInput.draw.zoomLevel;
-    const colorSettings color     = renderInput.color;
-    const calcSettings  calc      = renderInput.calc;
+    tEscapeBuffer escapes;
+    renderPlan    plan;
 
-    /* Pre-calculates the constants needed for mapping the X-Y values of the
-       image to the desired locaiton on the complex plane. */
-    const double dwidth    = (double) width;
-    const double dheight   = (double) height;
-    const double step      = 4 / (dwidth * zoomLevel);
-    const double realStart = (-2.0 / zoomLevel) + offset.real;
-    const double imagStart = (2.0 / zoomLevel) * dheight / dwidth - offset.imag;
+    if (drawTiles(renderInput, tileSize, fill, expMap, &escapes, &plan) != 0)
+	return 1;
 
-    // Function for calculating the imaginary part of a point from the X value.
-    double scaleX(int x) {
-	return realStart + step * x;
-    }
+    // Saves the render to an image file for viewing, and deallocates memory.
+    const int status = finishEscapes(renderInput, &plan, &escapes);
+    finishRender(&plan);
+    escapeBufferDeallocate(&escapes);
 
-    // Function for calculating the real part of a point from the Y value.
-    double scaleY(int y) {
-	return imagStart - step * y;
-    }
-    
-    // Writes a TARGA header to the file.
-    targaWriteHeader_RGB24(width, height, imageFile);
-    
-    /* Renders the mandelbrot, using a cursor to match the pixel plane to the
-       imaginary plane. */
-    for (int y = 0; y < height; y++) {
-	for (int x = 0; x < width; x++) {
-	    // Calculates the complex point.
-	    tComplex cursor;
-	    cursor.real = scaleX(x);
-	    cursor.imag = scaleY(y);
-	    
-	    // Calculates the 24 bit RGB value at the cursor.
-	    tRGB pixel;
-	    pixel = escapePixel(cursor, color, calc);
-	    
-	    // Writes the 24 bit RGB value to the image.
-	    targaWritePixel_RGB24(pixel, imageFile);
+    return status;
+}
+
+
+
+
+// A concurrent version of renderToTarga, working out every pixel.
+int renderToTarga_parallel(const renderSettings renderInput)
+{
+    return renderTiles(renderInput, TILE_SIZE_DEFAULT, FILL_NONE, 0);
+}
+
+
+
+
+/* A concurrent renderer that fills in solid regions rather than working them
+   out. Bigger tiles than usual are used, as the bigger a solid region is, the
+   more of it gets skipped. */
+int renderToTarga_fill(const renderSettings renderInput)
+{
+    return renderTiles(renderInput, FILL_TILE_SIZE, renderInput.draw.fill, 0);
+}
+
+
+
+
+/* Draws the escape times the way renderToTarga_parallel, or with a fill mode
+   renderToTarga_fill, would, but keeps them instead of coloring them. */
+int renderEscapes(const renderSettings renderInput, tEscapeBuffer *escapes)
+{
+    const fillMode fill     = renderInput.draw.fill;
+    const int      tileSize = (fill != FILL_NONE) ?
+	FILL_TILE_SIZE : TILE_SIZE_DEFAULT;
+    renderPlan     plan;
+
+    if (drawTiles(renderInput, tileSize, fill, 0, escapes, &plan) != 0)
+	return 1;
+
+    finishRender(&plan);
+
+    return 0;
+}
+
+
+
+
+/*
+ * Works out every stride-th pixel of a row, from column start on, into an
+ * escape buffer. Runs of neighbouring pixels go through the span kernel, and
+ * spaced-out pixels through the points kernel, in batches. Smooth escape times
+ * only come from the span kernel, so with those every pixel is a span of one.
+ */
+static void renderStrided(const renderPlan *plan,
+			  const int         maxIterations,
+			  const int         y,
+			  const int         start,
+			  const int         stride,
+			  tEscapeBuffer    *escapes)
+{
+    const int    width = escapes->width;
+    const double imag  = plan->imagStart - plan->step * y;
+    int          spanEscapes[SPAN_LENGTH];
+    float        spanSmooth[SPAN_LENGTH];
+
+    if (stride == 1) {
+	for (int x = start; x < width; x += SPAN_LENGTH) {
+	    const int spanLength = (width - x < SPAN_LENGTH) ?
+		width - x : SPAN_LENGTH;
+
+	    renderSpan(plan, maxIterations, x, imag, spanLength, spanEscapes,
+		       spanSmooth);
+	    escapeBufferStore(escapes, x, y, spanLength, spanEscapes,
+			      spanSmooth);
+	}
+
+    } else if (plan->calc.smooth) {
+	for (int x = start; x < width; x += stride) {
+	    renderSpan(plan, maxIterations, x, imag, 1, spanEscapes,
+		       spanSmooth);
+	    escapeBufferStore(escapes, x, y, 1, spanEscapes, spanSmooth);
+	}
+
+    } else {
+	double reals[SPAN_LENGTH];
+	double imags[SPAN_LENGTH];
+	int    count = 0;
+
+	// Same sums as fillPixels, so the escape times match a full render.
+	for (int x = start; x < width; x += stride) {
+	    reals[count] = plan->realStart + plan->step * x;
+	    imags[count] = imag;
+
+	    if (++count == SPAN_LENGTH || x + stride >= width) {
+		plan->escapePoints(maxIterations, plan->calc, reals, imags,
+				   count, spanEscapes);
+
+		for (int i = 0; i < count; i++)
+		    escapeBufferStore(escapes, x - (count - 1 - i) * stride, y,
+				      1, spanEscapes + i, NULL);
+		count = 0;
+	    }
 	}
     }
+}
 
-    // Returns no error.
-    return 0;
+
+
+
+/* Copies row fromY of an escape buffer to row toY, with every pixel taking the
+   escape time of the last column before it that is a multiple of stride. */
+static void spreadRow(tEscapeBuffer *escapes,
+		      const int      fromY,
+		      const int      toY,
+		      const int      stride)
+{
+    const int    width  = escapes->width;
+    const float *smooth = (escapes->smooth == NULL) ?
+	NULL : escapes->smooth + (size_t) fromY * width;
+
+    for (int x = 0; x < width; x += SPAN_LENGTH) {
+	const int spanLength = (width - x < SPAN_LENGTH) ?
+	    width - x : SPAN_LENGTH;
+	int       spanEscapes[SPAN_LENGTH];
+	float     spanSmooth[SPAN_LENGTH];
+
+	for (int i = 0; i < spanLength; i++) {
+	    const int gridX = x + i - (x + i) % stride;
+
+	    spanEscapes[i] = escapeBufferGet(escapes, gridX, fromY);
+	    spanSmooth[i]  = (smooth == NULL) ? 0 : smooth[gridX];
+	}
+
+	escapeBufferStore(escapes, x, toY, spanLength, spanEscapes,
+			  spanSmooth);
+    }
 }
 
 
 
+
+/* Makes every pixel off the grid of a pass a copy of the grid pixel above and
+   to the left of it, so the buffer can be shown as a blocky preview. The rows
+   of the grid are filled out first, then copied down over the rows between. */
+static void spreadPass(tEscapeBuffer *escapes, const int stride)
+{
+    const int height = escapes->height;
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y += stride)
+	spreadRow(escapes, y, y, stride);
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+	if (y % stride != 0)
+	    spreadRow(escapes, y - y % stride, y, 1);
+    }
+}
+
+
+
+
+/*
+ * Renders an image in passes, in parallel, into an escape buffer, then colors
+ * it into the image file. Each pass works out the pixels on a grid twice as
+ * fine as the last one's, skipping the ones the coarser grids already have:
+ * on rows the last grid had, that is every other column, and on the new rows
+ * in between, all of them. The rows of a pass are shared out between the
+ * threads as they go.
+ */
+int renderToTarga_progressive(const renderSettings renderInput)
+{
+    // Unpacks the inputs.
+    const int           width       = renderInput.draw.width;
+    const int           height      = renderInput.draw.height;
+    const int           threadCount = renderInput.draw.threadCount;
+    const int           passes      = renderInput.draw.passes;
+    const colorSettings color       = renderInput.color;
+    renderStats        *stats       = renderInput.stats;
+
+    // Sets the thread count to the input amount.
+    omp_set_num_threads(threadCount);
+
+    tEscapeBuffer escapes;
+
+    // Checks for memory allocation failure, and throws an error status if so.
+    if (escapeBufferAllocateFrom(&escapes, renderInput.pool, width, height,
+				 color.maxIterations,
+				 renderInput.calc.smooth) != 0)
+	return 1;
+
+    // Works out where the image lies, and how to calculate it.
+    renderPlan plan;
+    if (planRender(renderInput, &plan) != 0) {
+	escapeBufferDeallocate(&escapes);
+	return 1;
+    }
+
+    // Time spent drawing by each thread, for the statistics.
+    threadStats threadTimes[threadCount];
+    for (int i = 0; i < threadCount; i++)
+	threadTimes[i] = (threadStats) {0, 0, 0, 0};
+
+    const double startTime = omp_get_wtime();
+
+    for (int pass = 0; pass < passes; pass++) {
+	const int stride = 1 << (passes - 1 - pass);
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int y = 0; y < height; y += stride) {
+	    const double rowStart = omp_get_wtime();
+	    const int    oldRow   = pass > 0 && y % (2 * stride) == 0;
+
+	    renderStrided(&plan, color.maxIterations, y, oldRow ? stride : 0,
+			  oldRow ? 2 * stride : stride, &escapes);
+
+	    threadStats *times = &threadTimes[omp_get_thread_num()];
+	    times->busyTime  += omp_get_wtime() - rowStart;
+	    times->tileCount += 1;
+	}
+
+	// The last pass leaves nothing to spread, or to preview.
+	if (pass < passes - 1 && renderInput.passDone != NULL) {
+	    spreadPass(&escapes, stride);
+	    renderInput.passDone(renderInput.passContext, pass, &escapes);
+	}
+    }
+
+    const double renderTime = omp_get_wtime() - startTime;
+
+    // Anything a thread did not spend drawing, it spent waiting or previewing.
+    if (stats != NULL) {
+	stats->renderTime  = renderTime;
+	stats->threadCount = threadCount;
+
+	for (int i = 0; i < threadCount; i++) {
+	    stats->thread[i]          = threadTimes[i];
+	    stats->thread[i].idleTime = renderTime - threadTimes[i].busyTime;
+	}
+    }
+
+    // Saves the render to an image file for viewing, and deallocates memory.
+    const int status = finishEscapes(renderInput, &plan, &escapes);
+    finishRender(&plan);
+    escapeBufferDeallocate(&escapes);
+
+    return status;
+}
+
+
+
+
+// Escape time of a tile that is not all one, or not known to be.
+#define TILE_MIXED -1
+
+/* Slack added to both ends of every range, at every step of rectEscape. It is
+   far more than the rounding of a step while |z| < 2, so the ranges hold the
+   orbit the kernels work out for any point, and not just the exact one. */
+#define INTERVAL_SLACK 1e-12
+
+// A range of real numbers.
+typedef struct {
+    double low;
+    double high;
+} interval;
+
+// A rectangle of the complex plane, as a range of each part.
+typedef struct {
+    interval real;
+    interval imag;
+} intervalComplex;
+
+
+
+
+// Finds the range of the product of two ranges.
+static interval intervalProduct(const interval a, const interval b)
+{
+    const double lowLow   = a.low * b.low;
+    const double lowHigh  = a.low * b.high;
+    const double highLow  = a.high * b.low;
+    const double highHigh = a.high * b.high;
+
+    return (interval) {fmin(fmin(lowLow, lowHigh), fmin(highLow, highHigh)),
+		       fmax(fmax(lowLow, lowHigh), fmax(highLow, highHigh))};
+}
+
+
+
+
+// Finds the range of the square of a range, which is never negative.
+static interval intervalSquare(const interval a)
+{
+    const double low  = a.low * a.low;
+    const double high = a.high * a.high;
+
+    if (a.low <= 0 && a.high >= 0)
+	return (interval) {0, fmax(low, high)};
+
+    return (interval) {fmin(low, high), fmax(low, high)};
+}
+
+
+
+
+// Finds the range of the absolute value of a range.
+static interval intervalAbs(const interval a)
+{
+    if (a.low >= 0)
+	return a;
+
+    if (a.high <= 0)
+	return (interval) {-a.high, -a.low};
+
+    return (interval) {0, fmax(-a.low, a.high)};
+}
+
+
+
+
+/* Works out the pixels of a rectangle of pixels as a rectangle of the plane,
+   out to the outer edges of the pixels, so that rounding in where the pixels
+   fall cannot take one outside it. */
+static intervalComplex pixelRect(const renderPlan *plan,
+				 const int         left,
+				 const int         top,
+				 const int         width,
+				 const int         height)
+{
+    const double step = plan->step;
+
+    return (intervalComplex) {
+	{plan->realStart + step * (left - 0.5),
+	 plan->realStart + step * (left + width - 0.5)},
+	{plan->imagStart - step * (top + height - 0.5),
+	 plan->imagStart - step * (top - 0.5)}
+    };
+}
+
+
+
+
+/*
+ * Whether a rectangle lies wholly inside the main cardioid or the period-2
+ * bulb, which a Mandelbrot set of power 2 holds the whole of. The bulb is a
+ * disc, so the rectangle is in it when its corner furthest from the center
+ * is. The cardioid test of inMainBulbs, q (q + r - 1/4) < i^2 / 4 with
+ * q = (r - 1/4)^2 + i^2, is bounded a term at a time. q is never negative, so
+ * its product with q + r - 1/4 is largest at the greatest q when that sum can
+ * be positive, and at the least q when it cannot.
+ */
+static int rectInMainBulbs(const intervalComplex rect)
+{
+    const interval imag2 = intervalSquare(rect.imag);
+    const interval moved = {rect.real.low + 1, rect.real.high + 1};
+
+    if (intervalSquare(moved).high + imag2.high < 0.0625)
+	return 1;
+
+    const interval shifted  = {rect.real.low - 0.25, rect.real.high - 0.25};
+    const interval shifted2 = intervalSquare(shifted);
+    const interval q        = {shifted2.low + imag2.low,
+			       shifted2.high + imag2.high};
+    const double   sumMax   = q.high + shifted.high;
+    const double   product  = (sumMax >= 0) ? q.high * sumMax : q.low * sumMax;
+
+    return product < 0.25 * imag2.low;
+}
+
+
+
+
+/*
+ * Follows every orbit of a rectangle at once, as a rectangle holding all of
+ * them, for up to a number of steps. If the whole of it escapes at once, every
+ * point has the same escape time, and that is returned. If only part of it
+ * does, or none of it has by the last step, returns TILE_MIXED. The ranges
+ * only ever grow, so this only gets anywhere with rectangles well inside a
+ * band of one escape time.
+ */
+static int rectEscape(const calcSettings    calc,
+		      const intervalComplex rect,
+		      const int             maxIterations,
+		      const int             steps)
+{
+    const int             julia = calc.fractal == FRACTAL_JULIA;
+    const intervalComplex added = julia ?
+	(intervalComplex) {{calc.juliaConstant.real, calc.juliaConstant.real},
+			   {calc.juliaConstant.imag, calc.juliaConstant.imag}} :
+	rect;
+    intervalComplex       z     = julia ?
+	rect : (intervalComplex) {{0, 0}, {0, 0}};
+
+    for (int i = 0; i < steps && i < maxIterations; i++) {
+	intervalComplex base = z;
+
+	if (calc.fractal == FRACTAL_BURNING_SHIP) {
+	    base.real = intervalAbs(z.real);
+	    base.imag = intervalAbs(z.imag);
+	}
+
+	/* Squares are worked out as squares, not products of a range with
+	   itself, which keeps them from going negative. Higher powers multiply
+	   by z a step at a time, as in fractalStep. */
+	const interval real2 = intervalSquare(base.real);
+	const interval imag2 = intervalSquare(base.imag);
+	const interval cross = intervalProduct(base.real, base.imag);
+
+	intervalComplex raised = {{real2.low - imag2.high,
+				   real2.high - imag2.low},
+				  {2 * cross.low, 2 * cross.high}};
+
+	for (int j = 2; j < calc.power; j++) {
+	    const interval realReal = intervalProduct(raised.real, base.real);
+	    const interval imagImag = intervalProduct(raised.imag, base.imag);
+	    const interval realImag = intervalProduct(raised.real, base.imag);
+	    const interval imagReal = intervalProduct(raised.imag, base.real);
+
+	    raised.real = (interval) {realReal.low - imagImag.high,
+				      realReal.high - imagImag.low};
+	    raised.imag = (interval) {realImag.low + imagReal.low,
+				      realImag.high + imagReal.high};
+	}
+
+	z.real = (interval) {raised.real.low + added.real.low - INTERVAL_SLACK,
+			     raised.real.high + added.real.high +
+			     INTERVAL_SLACK};
+	z.imag = (interval) {raised.imag.low + added.imag.low - INTERVAL_SLACK,
+			     raised.imag.high + added.imag.high +
+			     INTERVAL_SLACK};
+
+	const interval zReal2 = intervalSquare(z.real);
+	const interval zImag2 = intervalSquare(z.imag);
+
+	if (zReal2.low + zImag2.low >= 4)
+	    return maxIterations - i;
+
+	if (zReal2.high + zImag2.high >= 4)
+	    return TILE_MIXED;
+    }
+
+    return TILE_MIXED;
+}
+
+
+
+
+/* Works out the view of a frame of an animation. The zoom level goes up by the
+   same factor every frame, and the center moves in step with 1 / zoom, which
+   keeps it drifting across the screen at a steady pace. */
+static void animationView(const animationSettings *animation,
+			  const int                frame,
+			  drawSettings            *draw)
+{
+    const double t     = (animation->frameCount > 1) ?
+	(double) frame / (animation->frameCount - 1) : 0;
+    const double ratio = animation->endZoom / animation->startZoom;
+    const double zoom  = animation->startZoom * pow(ratio, t);
+
+    // How far along the center is. Without any zooming, it just moves evenly.
+    const double along = (ratio == 1) ?
+	t : (1 - animation->startZoom / zoom) / (1 - 1 / ratio);
+
+    draw->zoomLevel   = zoom;
+    draw->offset.real = animation->startOffset.real +
+	(animation->endOffset.real - animation->startOffset.real) * along;
+    draw->offset.imag = animation->startOffset.imag +
+	(animation->endOffset.imag - animation->startOffset.imag) * along;
+}
+
+
+
+
+/*
+ * Guesses from the last frame whether a tile of this one is all one escape
+ * time, by looking at every pixel of the last frame that the tile covers, with
+ * a pixel to spare all round. Returns 1 if they all match, and sets escape to
+ * the one they share, 0 if they do not, and -1 if the last frame did not cover
+ * the whole tile.
+ */
+static int predictTile(const tEscapeBuffer *last,
+		       const renderPlan    *lastPlan,
+		       const renderPlan    *plan,
+		       const tTile         *tile,
+		       int                 *escape)
+{
+    const double left   = plan->realStart + plan->step * tile->x;
+    const double right  = plan->realStart +
+	plan->step * (tile->x + tile->width - 1);
+    const double top    = plan->imagStart - plan->step * tile->y;
+    const double bottom = plan->imagStart -
+	plan->step * (tile->y + tile->height - 1);
+
+    // Edges of the tile, in pixels of the last frame.
+    const double lastLeft   = floor((left - lastPlan->realStart) /
+				    lastPlan->step) - 1;
+    const double lastRight  = ceil((right - lastPlan->realStart) /
+				   lastPlan->step) + 1;
+    const double lastTop    = floor((lastPlan->imagStart - top) /
+				    lastPlan->step) - 1;
+    const double lastBottom = ceil((lastPlan->imagStart - bottom) /
+				   lastPlan->step) + 1;
+
+    if (lastLeft < 0 || lastTop < 0 ||
+	lastRight >= last->width || lastBottom >= last->height)
+	return -1;
+
+    const int value = escapeBufferGet(last, lastLeft, lastTop);
+
+    for (int y = lastTop; y <= lastBottom; y++)
+	for (int x = lastLeft; x <= lastRight; x++)
+	    if (escapeBufferGet(last, x, y) != value)
+		return 0;
+
+    *escape = value;
+    return 1;
+}
+
+
+
+
+/*
+ * Checks a tile that the last frame says is all one escape time, and returns
+ * that escape time if every pixel of the tile is sure to have it, or
+ * TILE_MIXED. Inside the set, only the main cardioid and period-2 bulb can be
+ * vouched for. Outside it, the orbits of the whole tile are followed at once,
+ * up to the step the last frame says they escape on. Either way the tile does
+ * not need to be worked out, and comes out just as it would have. Smooth
+ * escape times differ within a band, so with those only the inside counts.
+ */
+static int provePrediction(const renderPlan *plan,
+			   const int         maxIterations,
+			   const tTile      *tile,
+			   const int         escape)
+{
+    const intervalComplex rect = pixelRect(plan, tile->x, tile->y,
+					   tile->width, tile->height);
+
+    if (escape == 0)
+	return (plan->calc.fractal == FRACTAL_MANDELBROT &&
+		plan->calc.power == 2 && rectInMainBulbs(rect)) ?
+	    0 : TILE_MIXED;
+
+    if (plan->calc.smooth)
+	return TILE_MIXED;
+
+    return rectEscape(plan->calc, rect, maxIterations,
+		      maxIterations - escape + 1);
+}
+
+
+
+
+/*
+ * Renders a zoom animation, frame by frame. Within a frame, the tiles are
+ * shared out by the work-stealing scheduler, as in renderTiles. Tiles the last
+ * frame says are all one escape time are checked with provePrediction, and
+ * the ones it vouches for are filled in with it. Without a fill mode, every
+ * other tile is worked out in full. With one, tiles the last frame says are
+ * full of detail are still worked out in full, as filling them would only
+ * waste time on borders that never match, and every other tile (including the
+ * ones the last frame did not cover) is filled.
+ */
+int renderAnimation(const renderSettings    renderInput,
+		    const animationSettings animation)
+{
+    // Unpacks the inputs.
+    const int           width       = renderInput.draw.width;
+    const int           height      = renderInput.draw.height;
+    const int           threadCount = renderInput.draw.threadCount;
+    const colorSettings color       = renderInput.color;
+    renderStats        *stats       = renderInput.stats;
+    const fillMode      fill        = renderInput.draw.fill;
+
+    /* Filling is only done when asked for, as it can get the odd pixel wrong.
+       Smooth escape times never repeat, so there is nothing to fill. */
+    const int reuse = fill != FILL_NONE && renderInput.calc.smooth == 0;
+
+    // Sets the thread count to the input amount.
+    omp_set_num_threads(threadCount);
+
+    /* Two escape buffers take turns: one for the frame being drawn, and one
+       holding the frame before it. */
+    tEscapeBuffer frames[2];
+    renderPlan    plans[2];
+    tPalette      palette;
+
+    if (escapeBufferAllocateFrom(&frames[0], renderInput.pool, width, height,
+				 color.maxIterations,
+				 renderInput.calc.smooth) != 0)
+	return 1;
+
+    if (escapeBufferAllocateFrom(&frames[1], renderInput.pool, width, height,
+				 color.maxIterations,
+				 renderInput.calc.smooth) != 0) {
+	escapeBufferDeallocate(&frames[0]);
+	return 1;
+    }
+
+    tileScheduler scheduler;
+    int           status = tileSchedulerInit(&scheduler, width, height,
+					     ANIMATION_TILE_SIZE, threadCount);
+
+    if (status != 0) {
+	escapeBufferDeallocate(&frames[0]);
+	escapeBufferDeallocate(&frames[1]);
+	return 1;
+    }
+
+    // The fill modes need some scratch space for each thread.
+    regionWorkspace workspaces[threadCount];
+    int             workspaceCount = 0;
+
+    if (reuse) {
+	for (; workspaceCount < threadCount && status == 0; workspaceCount++)
+	    status = regionWorkspaceAllocate(&workspaces[workspaceCount],
+					     ANIMATION_TILE_SIZE);
+    }
+
+    // Every frame is colored with the same palette.
+    if (status != 0 || paletteBuild(&palette, color) != 0) {
+	for (int i = 0; i < workspaceCount; i++)
+	    regionWorkspaceFree(&workspaces[i]);
+
+	tileSchedulerFree(&scheduler);
+	escapeBufferDeallocate(&frames[0]);
+	escapeBufferDeallocate(&frames[1]);
+	return 1;
+    }
+
+    // Time spent drawing by each thread, over every frame.
+    threadStats threadTimes[threadCount];
+    for (int i = 0; i < threadCount; i++)
+	threadTimes[i] = (threadStats) {0, 0, 0, 0};
+
+    double renderTime = 0;
+
+    for (int frame = 0; frame < animation.frameCount && status == 0; frame++) {
+	tEscapeBuffer       *escapes  = &frames[frame % 2];
+	const tEscapeBuffer *last     = &frames[(frame + 1) % 2];
+	renderPlan          *plan     = &plans[frame % 2];
+	const renderPlan    *lastPlan = &plans[(frame + 1) % 2];
+
+	// Works out where this frame lies.
+	renderSettings frameInput = renderInput;
+	animationView(&animation, frame, &frameInput.draw);
+	planMapping(frameInput, plan);
+
+	const fillContext context = {plan, color.maxIterations};
+
+	// Function for the imaginary part of a point from the Y value.
+	double scaleY(int y) {
+	    return plan->imagStart - plan->step * y;
+	}
+
+	tileSchedulerReset(&scheduler);
+
+	const double startTime = omp_get_wtime();
+
+	// Starts a parallel block, where each thread keeps taking tiles.
+	#pragma omp parallel
+	{
+	    // Gets the thread number.
+	    int threadID = omp_get_thread_num();
+
+	    threadStats *times = &threadTimes[threadID];
+	    tTile        tile;
+	    int          stolen;
+
+	    while (tileSchedulerNext(&scheduler, threadID, &tile, &stolen)) {
+		const double tileStart = omp_get_wtime();
+
+		// What the last frame says about the tile, scaled to this one.
+		int       predicted = 0;
+		int       escape    = TILE_MIXED;
+		const int seen      = (frame == 0) ? -1 :
+		    predictTile(last, lastPlan, plan, &tile, &predicted);
+
+		if (seen == 1)
+		    escape = provePrediction(plan, color.maxIterations, &tile,
+					     predicted);
+
+		if (escape != TILE_MIXED) {
+		    // Stores the escape time the tile is sure to have.
+		    int   spanEscapes[ANIMATION_TILE_SIZE];
+		    float spanSmooth[ANIMATION_TILE_SIZE];
+
+		    for (int x = 0; x < tile.width; x++) {
+			spanEscapes[x] = escape;
+			spanSmooth[x]  = 0;
+		    }
+
+		    for (int y = tile.y; y < tile.y + tile.height; y++)
+			escapeBufferStore(escapes, tile.x, y, tile.width,
+					  spanEscapes, spanSmooth);
+		} else if (reuse && seen != 0) {
+		    // Fills the tile in, then copies it into the frame.
+		    regionWorkspace *workspace = &workspaces[threadID];
+
+		    regionFill(fill, &tile, fillPixels, &context, workspace);
+
+		    for (int y = 0; y < tile.height; y++)
+			escapeBufferStore(escapes, tile.x, tile.y + y,
+					  tile.width,
+					  workspace->escapes + y * tile.width,
+					  NULL);
+		} else {
+		    // Renders the tile into the frame, a row at a time.
+		    for (int y = tile.y; y < tile.y + tile.height; y++) {
+			int   spanEscapes[ANIMATION_TILE_SIZE];
+			float spanSmooth[ANIMATION_TILE_SIZE];
+
+			renderSpan(plan, color.maxIterations, tile.x,
+				   scaleY(y), tile.width, spanEscapes,
+				   spanSmooth);
+			escapeBufferStore(escapes, tile.x, y, tile.width,
+					  spanEscapes, spanSmooth);
+		    }
+		}
+
+		times->busyTime   += omp_get_wtime() - tileStart;
+		times->tileCount  += 1;
+		times->stealCount += stolen;
+	    }
+	} // End of parallel code.
+
+	renderTime += omp_get_wtime() - startTime;
+
+	// Saves the frame to its own image file.
+	FILE *frameFile = animation.openFrame(animation.context, frame);
+
+	if (frameFile == NULL) {
+	    status = 1;
+	} else {
+	    status = colorizeWithPalette(escapes, &palette, plan,
+					 renderInput.format, threadCount,
+					 frameFile);
+	    animation.closeFrame(animation.context, frame, frameFile);
+	}
+    }
+
+    // Anything a thread did not spend drawing, it spent waiting.
+    if (stats != NULL) {
+	stats->renderTime  = renderTime;
+	stats->threadCount = threadCount;
+
+	for (int i = 0; i < threadCount; i++) {
+	    stats->thread[i]          = threadTimes[i];
+	    stats->thread[i].idleTime = renderTime - threadTimes[i].busyTime;
+	}
+    }
+
+    for (int i = 0; i < workspaceCount; i++)
+	regionWorkspaceFree(&workspaces[i]);
+
+    paletteFree(&palette);
+    tileSchedulerFree(&scheduler);
+    escapeBufferDeallocate(&frames[0]);
+    escapeBufferDeallocate(&frames[1]);
+
+    return status;
+}
+
+
+
+
+/* Encodes a whole image as a single segment, in space the caller keeps for
+   it, and writes it to the file. For thumbnails and tiles, each encoded by the
+   thread that drew it. */
+static void writeWholeImage(const tRGB        *pixels,
+			    const int          width,
+			    const int          height,
+			    const imageFormat  format,
+			    imageWorkspace    *workspace,
+			    unsigned char     *bytes,
+			    FILE              *file)
+{
+    const imageSegment segment = imageEncodeSegment(pixels, width, height,
+						    workspace, bytes);
+    imageWriter        writer;
+
+    imageWriterStart(&writer, format, width, height, file);
+    imageWriteSegment(&writer, &segment, bytes);
+    imageWriterFinish(&writer);
+}
+
+
+
+
+/*
+ * Draws one thumbnail of an atlas, a span at a time, with the plan's Julia
+ * constant. Packed thumbnails go into their cell of the atlas's escape buffer,
+ * and separate ones straight into colors.
+ */
+static void renderThumbnail(const renderPlan *plan,
+			    const int         maxIterations,
+			    const int         width,
+			    const int         height,
+			    tEscapeBuffer    *escapes,
+			    const int         left,
+			    const int         top,
+			    tRGB             *pixels)
+{
+    for (int y = 0; y < height; y++) {
+	const double imag = plan->imagStart - plan->step * y;
+
+	for (int x = 0; x < width; x += SPAN_LENGTH) {
+	    const int spanLength = (width - x < SPAN_LENGTH) ?
+		width - x : SPAN_LENGTH;
+
+	    if (pixels != NULL) {
+		renderColorSpan(plan, maxIterations, x, imag, spanLength,
+				pixels + (size_t) y * width + x);
+		continue;
+	    }
+
+	    int   spanEscapes[SPAN_LENGTH];
+	    float spanSmooth[SPAN_LENGTH];
+
+	    renderSpan(plan, maxIterations, x, imag, spanLength, spanEscapes,
+		       spanSmooth);
+	    escapeBufferStore(escapes, left + x, top + y, spanLength,
+			      spanEscapes, spanSmooth);
+	}
+    }
+}
+
+
+
+
+/*
+ * Renders an atlas of Julia sets. The thumbnails are handed out one at a time,
+ * to whichever thread is free, so a thumbnail full of slow points only holds
+ * up the thread drawing it. Every thumbnail shares one plan, which only needs
+ * its Julia constant changed, and separate thumbnails are encoded whole, by
+ * the thread that drew them, in space that thread keeps for the whole atlas.
+ */
+int renderAtlas(const renderSettings renderInput, const atlasSettings atlas)
+{
+    // Unpacks the inputs.
+    const int           width       = renderInput.draw.width;
+    const int           height      = renderInput.draw.height;
+    const int           threadCount = renderInput.draw.threadCount;
+    const colorSettings color       = renderInput.color;
+    const imageFormat   format      = renderInput.format;
+    renderStats        *stats       = renderInput.stats;
+    const int           separate    = atlas.openThumbnail != NULL;
+    const int           rows        = (atlas.count + atlas.columns - 1) /
+	atlas.columns;
+
+    // Sets the thread count to the input amount.
+    omp_set_num_threads(threadCount);
+
+    // The mapping, kernels and palette are worked out once, for every one.
+    renderSettings atlasInput = renderInput;
+    atlasInput.calc.fractal   = FRACTAL_JULIA;
+
+    renderPlan base;
+    planMapping(atlasInput, &base);
+
+    if (paletteBuild(&base.palette, color) != 0)
+	return 1;
+
+    /* A packed atlas keeps the escape times of every thumbnail, for coloring
+       at the end. Separate thumbnails only need their colors, and room to
+       encode them in, for each thread. */
+    const size_t   thumbnailBytes = imageSegmentBytes(format, width, height);
+    tEscapeBuffer  escapes;
+    tRGB          *colors    = NULL;
+    unsigned char *encoded   = NULL;
+    imageWorkspace workspace[threadCount];
+    int            allocated = 0;
+    int            status    = 0;
+
+    if (separate) {
+	colors  = malloc((size_t) threadCount * width * height * sizeof *colors);
+	encoded = malloc(threadCount * thumbnailBytes);
+
+	while (allocated < threadCount &&
+	       imageWorkspaceAllocate(&workspace[allocated], format, width,
+				      height) == 0)
+	    allocated++;
+
+	status = colors == NULL || encoded == NULL || allocated < threadCount;
+    } else {
+	status = escapeBufferAllocateFrom(&escapes, renderInput.pool,
+					  width * atlas.columns, height * rows,
+					  color.maxIterations,
+					  renderInput.calc.smooth);
+    }
+
+    if (status != 0) {
+	for (int i = 0; i < allocated; i++)
+	    imageWorkspaceFree(&workspace[i]);
+
+	free(colors);
+	free(encoded);
+	paletteFree(&base.palette);
+	return 1;
+    }
+
+    // Time spent drawing by each thread, over every thumbnail.
+    threadStats threadTimes[threadCount];
+    for (int i = 0; i < threadCount; i++)
+	threadTimes[i] = (threadStats) {0, 0, 0, 0};
+
+    const double startTime = omp_get_wtime();
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < atlas.count; i++) {
+	// Gets the thread number.
+	const int threadID = omp_get_thread_num();
+	int       failed;
+
+	// Once a file fails to open, the rest of the thumbnails are skipped.
+	#pragma omp atomic read
+	failed = status;
+
+	if (failed)
+	    continue;
+
+	const double thumbnailStart = omp_get_wtime();
+
+	renderPlan plan         = base;
+	plan.calc.juliaConstant = atlas.constants[i];
+
+	if (separate) {
+	    tRGB          *pixels = colors + (size_t) threadID * width * height;
+	    unsigned char *bytes  = encoded + threadID * thumbnailBytes;
+
+	    renderThumbnail(&plan, color.maxIterations, width, height, NULL,
+			    0, 0, pixels);
+
+	    FILE *file = atlas.openThumbnail(atlas.context, i);
+
+	    if (file == NULL) {
+		#pragma omp atomic write
+		status = 1;
+	    } else {
+		writeWholeImage(pixels, width, height, format,
+				&workspace[threadID], bytes, file);
+		atlas.closeThumbnail(atlas.context, i, file);
+	    }
+	} else {
+	    renderThumbnail(&plan, color.maxIterations, width, height,
+			    &escapes, (i % atlas.columns) * width,
+			    (i / atlas.columns) * height, NULL);
+	}
+
+	threadTimes[threadID].busyTime  += omp_get_wtime() - thumbnailStart;
+	threadTimes[threadID].tileCount += 1;
+    }
+
+    const double renderTime = omp_get_wtime() - startTime;
+
+    // Anything a thread did not spend drawing, it spent waiting.
+    if (stats != NULL) {
+	stats->renderTime  = renderTime;
+	stats->threadCount = threadCount;
+
+	for (int i = 0; i < threadCount; i++) {
+	    stats->thread[i]          = threadTimes[i];
+	    stats->thread[i].idleTime = renderTime - threadTimes[i].busyTime;
+	}
+    }
+
+    // A packed atlas is saved and colored in one go, like any other image.
+    if (separate) {
+	for (int i = 0; i < threadCount; i++)
+	    imageWorkspaceFree(&workspace[i]);
+
+	free(colors);
+	free(encoded);
+    } else {
+	if (status == 0 && renderInput.escapeFile != NULL)
+	    escapeBufferWrite(&escapes, renderInput.escapeFile);
+
+	if (status == 0)
+	    status = colorizeWithPalette(&escapes, &base.palette, NULL, format,
+					 threadCount, renderInput.imageFile);
+
+	escapeBufferDeallocate(&escapes);
+    }
+
+    paletteFree(&base.palette);
+
+    return status;
+}
+
+
+
+
+// The tiles of one level of a pyramid that are drawn.
+typedef struct {
+    int left;
+    int top;
+    int columns;
+    int rows;
+} pyramidLevel;
+
+// Where a tile's pixels fall on the grid of pixels it is drawn on.
+typedef struct {
+    int left;
+    int top;
+    int width;
+    int height;
+} pyramidTile;
+
+
+
+
+/* Works out the size of a pyramid's tiles, and where its top left corner is,
+   in the same terms as draw.offset, at a level. The whole pyramid covers the
+   view of level 0. Tiles count down from the top, as the rows of an image
+   do, so tile y = 0 holds the largest imaginary parts. */
+static void pyramidGrid(const renderSettings renderInput,
+			const int            level,
+			tComplex            *corner,
+			tComplex            *tileSize)
+{
+    const double zoomLevel = renderInput.draw.zoomLevel;
+    const double aspect    = (double) renderInput.draw.height /
+	renderInput.draw.width;
+    const double side      = ldexp(1, level);
+
+    corner->real   = renderInput.draw.offset.real - 2 / zoomLevel;
+    corner->imag   = renderInput.draw.offset.imag + 2 * aspect / zoomLevel;
+    tileSize->real = 4 / zoomLevel / side;
+    tileSize->imag = 4 * aspect / zoomLevel / side;
+}
+
+
+
+
+// Finds the first and last tiles, across or down, touching a span of a region.
+static void pyramidSpan(const double start,
+			const double end,
+			const double corner,
+			const double tileSize,
+			const int    level,
+			int         *first,
+			int         *count)
+{
+    const double last  = ldexp(1, level) - 1;
+    double       lower = floor((fmin(start, end) - corner) / tileSize);
+    double       upper = floor((fmax(start, end) - corner) / tileSize);
+
+    lower = fmax(lower, 0);
+    upper = fmin(upper, last);
+
+    *first = (int) lower;
+    *count = (upper >= lower) ? (int) (upper - lower) + 1 : 0;
+}
+
+
+
+
+/* Picks out the tiles of a level to be drawn: every one, or the ones that
+   touch the region. */
+static void pyramidLevelStart(const renderSettings  renderInput,
+			     const pyramidSettings pyramid,
+			     const int             level,
+			     pyramidLevel         *tiles)
+{
+    tComplex corner, tileSize;
+    pyramidGrid(renderInput, level, &corner, &tileSize);
+
+    if (pyramid.bounded) {
+	pyramidSpan(pyramid.regionStart.real, pyramid.regionEnd.real,
+		    corner.real, tileSize.real, level, &tiles->left,
+		    &tiles->columns);
+	// Rows count down the imaginary axis, so it is turned over first.
+	pyramidSpan(-pyramid.regionStart.imag, -pyramid.regionEnd.imag,
+		    -corner.imag, tileSize.imag, level, &tiles->top,
+		    &tiles->rows);
+    } else {
+	tiles->left    = 0;
+	tiles->top     = 0;
+	tiles->columns = 1 << level;
+	tiles->rows    = 1 << level;
+    }
+}
+
+
+
+
+/* The deepest level whose tiles are all drawn on one grid of pixels. The
+   kernels count the pixels across in an int, so past it a level is split
+   into blocks of 2^(this level) tiles across and down, each on a grid of its
+   own. */
+static int pyramidBlockLevel(const int width, const int height)
+{
+    const long side  = (width > height) ? width : height;
+    int        level = 0;
+
+    while (level < PYRAMID_LEVEL_MAX && (side << (level + 1)) <= INT_MAX / 2)
+	level++;
+
+    return level;
+}
+
+
+
+
+/* Places a tile on the grid of pixels of its block, with the plan starting
+   at the block's top left pixel. A level that is one block starts where the
+   view of the whole level would, from the plan of the level. */
+static pyramidTile pyramidTilePlace(const renderPlan *levelPlan,
+				    const int         blockLevel,
+				    const int         x,
+				    const int         y,
+				    const int         width,
+				    const int         height,
+				    renderPlan       *plan)
+{
+    const int blockX = x >> blockLevel << blockLevel;
+    const int blockY = y >> blockLevel << blockLevel;
+
+    *plan           = *levelPlan;
+    plan->realStart = levelPlan->realStart +
+	levelPlan->step * ((double) blockX * width);
+    plan->imagStart = levelPlan->imagStart -
+	levelPlan->step * ((double) blockY * height);
+
+    return (pyramidTile) {(x - blockX) * width, (y - blockY) * height, width,
+			  height};
+}
+
+
+
+
+// Works out every pixel of a tile, straight into colors.
+static void renderTile(const renderPlan *plan,
+		       const int         maxIterations,
+		       const pyramidTile tile,
+		       tRGB             *pixels)
+{
+    for (int y = 0; y < tile.height; y++) {
+	const double imag = plan->imagStart - plan->step * (tile.top + y);
+
+	for (int x = 0; x < tile.width; x += SPAN_LENGTH) {
+	    const int spanLength = (tile.width - x < SPAN_LENGTH) ?
+		tile.width - x : SPAN_LENGTH;
+
+	    renderColorSpan(plan, maxIterations, tile.left + x, imag,
+			    spanLength, pixels + (size_t) y * tile.width + x);
+	}
+    }
+}
+
+
+
+
+/* Works out the escape times around the edge of a tile. Returns the one they
+   all share, or TILE_MIXED if they differ. */
+static int tileEdge(const renderPlan *plan,
+		    const int         maxIterations,
+		    const pyramidTile tile)
+{
+    const int width  = tile.width;
+    const int height = tile.height;
+
+    int   escapes[SPAN_LENGTH];
+    float smooth[SPAN_LENGTH];
+    int   shared = TILE_MIXED;
+
+    // The top and bottom rows, then the two ends of every row in between.
+    for (int y = 0; y < height; y += (height > 1) ? height - 1 : 1) {
+	const double imag = plan->imagStart - plan->step * (tile.top + y);
+
+	for (int x = 0; x < width; x += SPAN_LENGTH) {
+	    const int spanLength = (width - x < SPAN_LENGTH) ?
+		width - x : SPAN_LENGTH;
+
+	    renderSpan(plan, maxIterations, tile.left + x, imag, spanLength,
+		       escapes, smooth);
+
+	    for (int i = 0; i < spanLength; i++) {
+		if (shared == TILE_MIXED)
+		    shared = escapes[i];
+		else if (escapes[i] != shared)
+		    return TILE_MIXED;
+	    }
+	}
+    }
+
+    for (int y = 1; y < height - 1; y++) {
+	const double imag = plan->imagStart - plan->step * (tile.top + y);
+
+	renderSpan(plan, maxIterations, tile.left, imag, 1, escapes, smooth);
+	renderSpan(plan, maxIterations, tile.left + width - 1, imag, 1,
+		   escapes + 1, smooth + 1);
+
+	if (escapes[0] != shared || escapes[1] != shared)
+	    return TILE_MIXED;
+    }
+
+    return shared;
+}
+
+
+
+
+/*
+ * Whether a tile whose edge is all one escape time can be taken to be all of
+ * it. Only Mandelbrot sets (of any power) are known to have no holes. The
+ * points that stay for a given number of iterations or more make up a single
+ * blob without holes too, around the set and through 0, so unless a tile holds
+ * 0, any other escape time inside it would have to cross its edge. Smooth
+ * escape times differ within a band, so with those only the inside of the set
+ * counts. The edge is only looked at in the middle of each pixel, though, and
+ * a filament or a band thinner than a pixel can slip through between two of
+ * them, so this is a guess, like the fill modes, not a proof.
+ */
+static int tileEdgeDecides(const renderPlan *plan,
+			   const pyramidTile tile,
+			   const int         escape)
+{
+    if (plan->calc.fractal != FRACTAL_MANDELBROT || escape == TILE_MIXED)
+	return 0;
+
+    if (escape == 0)
+	return 1;
+
+    const double left      = plan->realStart + plan->step * tile.left;
+    const double top       = plan->imagStart - plan->step * tile.top;
+    const int    holdsZero = left <= 0 &&
+	left + plan->step * tile.width >= 0 &&
+	top >= 0 && top - plan->step * tile.height <= 0;
+
+    return plan->calc.smooth == 0 && holdsZero == 0;
+}
+
+
+
+
+/*
+ * Works out, without drawing it, whether every pixel of a tile is sure to have
+ * the same escape time, and returns it, or TILE_MIXED. A Mandelbrot set of
+ * power 2 holds the whole of its main cardioid and period-2 bulb, and a point
+ * more than 2 from 0 escapes on the first step, from z = 0, whatever the
+ * power. Smooth escape times still differ past the escape radius, so there
+ * only the inside counts.
+ */
+static int tileKnown(const renderPlan *plan,
+		     const int         maxIterations,
+		     const pyramidTile tile)
+{
+    const intervalComplex rect = pixelRect(plan, tile.left, tile.top,
+					   tile.width, tile.height);
+
+    if (plan->calc.fractal == FRACTAL_MANDELBROT && plan->calc.power == 2 &&
+	rectInMainBulbs(rect))
+	return 0;
+
+    if (plan->calc.smooth)
+	return TILE_MIXED;
+
+    return rectEscape(plan->calc, rect, maxIterations, 1);
+}
+
+
+
+
+/*
+ * Renders a tile pyramid. A tile that tileKnown can vouch for is filled in
+ * without being worked out. Without a fill mode, every other tile is worked
+ * out in full. With one, its edge is worked out first, at the tile's own
+ * resolution, and the inside is only worked out if tileEdgeDecides does not
+ * take the edge's word for it. Every tile of a level is drawn on the grid of
+ * pixels the view would be drawn on at the level's whole size, so the tiles
+ * join up into exactly that image. Nothing is passed down from one level to the
+ * next, so a tile comes out the same whether the tiles above it were drawn in
+ * this run or an earlier one.
+ */
+int renderPyramid(const renderSettings  renderInput,
+		  const pyramidSettings pyramid)
+{
+    // Unpacks the inputs.
+    const int           width       = renderInput.draw.width;
+    const int           height      = renderInput.draw.height;
+    const int           threadCount = renderInput.draw.threadCount;
+    const colorSettings color       = renderInput.color;
+    const imageFormat   format      = renderInput.format;
+    renderStats        *stats       = renderInput.stats;
+
+    // Looking at the edges first is a guess, so it is only done when asked.
+    const int edgeFirst  = renderInput.draw.fill != FILL_NONE;
+    const int blockLevel = pyramidBlockLevel(width, height);
+
+    // Sets the thread count to the input amount.
+    omp_set_num_threads(threadCount);
+
+    // The kernels and palette are worked out once, for every tile.
+    renderPlan base;
+    planMapping(renderInput, &base);
+
+    if (paletteBuild(&base.palette, color) != 0)
+	return 1;
+
+    // Each thread keeps room to color and encode a tile in.
+    const size_t   tileBytes = imageSegmentBytes(format, width, height);
+    tRGB          *colors    = malloc((size_t) threadCount * width * height *
+				      sizeof *colors);
+    unsigned char *encoded   = malloc(threadCount * tileBytes);
+    imageWorkspace workspace[threadCount];
+    int            allocated = 0;
+
+    while (allocated < threadCount &&
+	   imageWorkspaceAllocate(&workspace[allocated], format, width,
+				  height) == 0)
+	allocated++;
+
+    int status = colors == NULL || encoded == NULL || allocated < threadCount;
+
+    // Time spent drawing by each thread, over every tile.
+    threadStats threadTimes[threadCount];
+    for (int i = 0; i < threadCount; i++)
+	threadTimes[i] = (threadStats) {0, 0, 0, 0};
+
+    unsigned long drawn    = 0;
+    unsigned long known    = 0;
+    unsigned long uniform  = 0;
+    unsigned long existing = 0;
+
+    const double startTime = omp_get_wtime();
+
+    for (int level = pyramid.minLevel; level <= pyramid.maxLevel &&
+	     status == 0; level++) {
+	pyramidLevel tiles;
+	pyramidLevelStart(renderInput, pyramid, level, &tiles);
+
+	// The level is drawn as the view would be, 2^level times the size.
+	renderPlan levelPlan = base;
+	levelPlan.step       = 4 / ((double) width * ldexp(1, level) *
+				    renderInput.draw.zoomLevel);
+
+	const long count = (long) tiles.columns * tiles.rows;
+
+	#pragma omp parallel for schedule(dynamic, 1) \
+	    reduction(+: drawn, known, uniform, existing)
+	for (long i = 0; i < count; i++) {
+	    // Gets the thread number.
+	    const int threadID = omp_get_thread_num();
+	    const int x        = tiles.left + i % tiles.columns;
+	    const int y        = tiles.top + i / tiles.columns;
+	    int       escape   = TILE_MIXED;
+	    int       failed;
+
+	    // Once a file fails to open, the rest of the tiles are skipped.
+	    #pragma omp atomic read
+	    failed = status;
+
+	    if (failed)
+		continue;
+
+	    if (pyramid.tileExists(pyramid.context, level, x, y)) {
+		existing++;
+		continue;
+	    }
+
+	    const double tileStart = omp_get_wtime();
+
+	    renderPlan        plan;
+	    const pyramidTile tile = pyramidTilePlace(&levelPlan, blockLevel,
+						      x, y, width, height,
+						      &plan);
+
+	    tRGB *pixels = colors + (size_t) threadID * width * height;
+
+	    escape = tileKnown(&plan, color.maxIterations, tile);
+
+	    if (escape != TILE_MIXED) {
+		known++;
+	    } else if (edgeFirst) {
+		escape = tileEdge(&plan, color.maxIterations, tile);
+
+		if (tileEdgeDecides(&plan, tile, escape))
+		    uniform++;
+		else
+		    escape = TILE_MIXED;
+	    }
+
+	    if (escape != TILE_MIXED) {
+		const tRGB fill = paletteColor(&base.palette, escape);
+
+		for (size_t j = 0; j < (size_t) width * height; j++)
+		    pixels[j] = fill;
+	    } else {
+		renderTile(&plan, color.maxIterations, tile, pixels);
+		drawn++;
+	    }
+
+	    FILE *file = pyramid.openTile(pyramid.context, level, x, y);
+
+	    if (file == NULL) {
+		#pragma omp atomic write
+		status = 1;
+	    } else {
+		writeWholeImage(pixels, width, height, format,
+				&workspace[threadID],
+				encoded + threadID * tileBytes, file);
+		pyramid.closeTile(pyramid.context, level, x, y, file);
+	    }
+
+	    threadTimes[threadID].busyTime  += omp_get_wtime() - tileStart;
+	    threadTimes[threadID].tileCount += 1;
+	}
+    }
+
+    const double renderTime = omp_get_wtime() - startTime;
+
+    // Anything a thread did not spend drawing, it spent waiting.
+    if (stats != NULL) {
+	stats->renderTime  = renderTime;
+	stats->threadCount = threadCount;
+
+	for (int i = 0; i < threadCount; i++) {
+	    stats->thread[i]          = threadTimes[i];
+	    stats->thread[i].idleTime = renderTime - threadTimes[i].busyTime;
+	}
+    }
+
+    if (pyramid.counts != NULL)
+	*pyramid.counts = (pyramidCounts) {drawn, known, uniform, existing};
+
+    for (int i = 0; i < allocated; i++)
+	imageWorkspaceFree(&workspace[i]);
+
+    free(colors);
+    free(encoded);
+    paletteFree(&base.palette);
+
+    return status;
+}
+
+
+
+
+// How much deeper the bottom row of an exponential map is than the top row.
+double expMapDepth(const int width, const int height)
+{
+    return exp(TWO_PI * height / width);
+}
+
+
+
+
+/* Renders an exponential map, in parallel, with the same tiles and fill modes
+   as renderToTarga_fill. */
+int renderToTarga_expMap(const renderSettings renderInput)
+{
+    return renderTiles(renderInput, FILL_TILE_SIZE, renderInput.draw.fill, 1);
+}
+
+
+
+
+/*
+ * Rebuilds a view from an exponential map. Each pixel of the view is turned
+ * into an angle and a log distance from the center, which say where it lies
+ * on the map, and its color is blended from the four pixels of the map around
+ * that spot. The angle wraps around the sides of the map. Pixels beyond the
+ * top or bottom rows take the color of the nearest row.
+ */
+int expMapToTarga(const tEscapeBuffer *strip,
+		  colorSettings        color,
+		  const double         zoomLevel,
+		  const int            width,
+		  const int            height,
+		  const imageFormat    format,
+		  FILE                *imageFile)
+{
+    tPalette palette;
+
+    color.maxIterations = strip->maxIterations;
+
+    if (paletteBuild(&palette, color) != 0)
+	return 1;
+
+    tRGB *image = malloc((size_t) width * height * sizeof *image);
+    if (image == NULL) {
+	paletteFree(&palette);
+	return 1;
+    }
+
+    // The same mapping as planExpMap and planMapping, relative to the center.
+    const double mapStep   = TWO_PI / strip->width;
+    const double outerLog  = log(EXP_MAP_OUTER);
+    const double step      = 4 / (width * zoomLevel);
+    const double realStart = -2.0 / zoomLevel;
+    const double imagStart = (2.0 / zoomLevel) * height / width;
+
+    // Gets the color of a pixel of the map, wrapping around the sides.
+    tRGB mapColor(int x, int y) {
+	x = (x % strip->width + strip->width) % strip->width;
+	y = (y < 0) ? 0 : (y >= strip->height) ? strip->height - 1 : y;
+
+	return paletteColor(&palette, escapeBufferGet(strip, x, y));
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+	for (int x = 0; x < width; x++) {
+	    const double real  = realStart + step * x;
+	    const double imag  = imagStart - step * y;
+	    double       angle = atan2(imag, real);
+
+	    if (angle < 0)
+		angle += TWO_PI;
+
+	    // Where the pixel lies on the map, and how far between pixels.
+	    const double mapX   = angle / mapStep;
+	    double       mapY   = (outerLog - 0.5 * log(real * real +
+							imag * imag)) / mapStep;
+
+	    // The center itself is infinitely deep, so it gets the bottom row.
+	    if (!(mapY < strip->height))
+		mapY = strip->height;
+
+	    const int    left   = (int) floor(mapX);
+	    const int    top    = (int) floor(mapY);
+	    const int    blendX = (int) ((mapX - left) * 256);
+	    const int    blendY = (int) ((mapY - top) * 256);
+
+	    const tRGB   c00    = mapColor(left, top);
+	    const tRGB   c10    = mapColor(left + 1, top);
+	    const tRGB   c01    = mapColor(left, top + 1);
+	    const tRGB   c11    = mapColor(left + 1, top + 1);
+	    tRGB         color;
+
+	    // Blends each channel across, then down.
+	    int blend(int a, int b, int c, int d) {
+		const int upper = a * (256 - blendX) + b * blendX;
+		const int lower = c * (256 - blendX) + d * blendX;
+
+		return (upper * (256 - blendY) + lower * blendY) >> 16;
+	    }
+
+	    color.r = blend(c00.r, c10.r, c01.r, c11.r);
+	    color.g = blend(c00.g, c10.g, c01.g, c11.g);
+	    color.b = blend(c00.b, c10.b, c01.b, c11.b);
+
+	    image[(size_t) y * width + x] = color;
+	}
+    }
+
+    const int status = imageWritePixels(format, image, width, height,
+					imageFile);
+
+    free(image);
+    paletteFree(&palette);
+
+    return status;
+}
+
+
+
+
+/* Variant of renderToTarga, but writes directly to the disk. There is no
+   escape buffer here, so the escape times cannot be saved. */
+int renderToTarga_lowMem(const renderSettings renderInput)
+{
+    // Unpacks the inputs.
+    FILE               *imageFile   = renderInput.imageFile;
+    const int           width       = renderInput.draw.width;
+    const int           height      = renderInput.draw.height;
+    const colorSettings color       = renderInput.color;
+    const int           segmentRows = imageSegmentRows(width);
+
+    /* Only a single segment of colors is ever held in memory, so that it can
+       be encoded whole. */
+    tRGB          *pixels = malloc((size_t) segmentRows * width *
+				   sizeof *pixels);
+    unsigned char *bytes  = malloc(imageSegmentBytes(renderInput.format,
+						     width, segmentRows));
+    imageWorkspace workspace;
+
+    if (pixels == NULL || bytes == NULL ||
+	imageWorkspaceAllocate(&workspace, renderInput.format, width,
+			       segmentRows) != 0) {
+	free(pixels);
+	free(bytes);
+	return 1;
+    }
+
+    // Works out where the image lies, and how to calculate it.
+    renderPlan plan;
+    if (planRender(renderInput, &plan) != 0) {
+	imageWorkspaceFree(&workspace);
+	free(pixels);
+	free(bytes);
+	return 1;
+    }
+
+    // Function for calculating the imaginary part of a point from the Y value.
+    double scaleY(int y) {
+	return plan.imagStart - plan.step * y;
+    }
+    
+    // Writes the image header to the file.
+    imageWriter writer;
+    imageWriterStart(&writer, renderInput.format, width, height, imageFile);
+    
+    const double startTime = omp_get_wtime();
+
+    /* Renders the mandelbrot, one span of pixels at a time, so that only a
+       handful of escape times are ever held in memory, and writes it out a
+       segment at a time. */
+    for (int top = 0; top < height; top += segmentRows) {
+	const int rows = (height - top < segmentRows) ?
+	    height - top : segmentRows;
+
+	for (int y = 0; y < rows; y++) {
+	    for (int x = 0; x < width; x += SPAN_LENGTH) {
+		const int spanLength = (width - x < SPAN_LENGTH) ?
+		    width - x : SPAN_LENGTH;
+
+		renderColorSpan(&plan, color.maxIterations, x, scaleY(top + y),
+				spanLength, pixels + (size_t) y * width + x);
+	    }
+	}
+
+	const imageSegment segment = imageEncodeSegment(pixels, width, rows,
+							&workspace, bytes);
+	imageWriteSegment(&writer, &segment, bytes);
+    }
+
+    imageWriterFinish(&writer);
+
+    reportSerialStats(renderInput.stats, omp_get_wtime() - startTime);
+    finishRender(&plan);
+    imageWorkspaceFree(&workspace);
+    free(pixels);
+    free(bytes);
+
+    // Returns no error.
+    return 0;
+}
+
+
+
+
+/*
+ * A concurrent version of renderToTarga_lowMem. The image is cut into bands of
+ * whole rows, which the worker threads draw straight into colors, in a small
+ * ring of band buffers. One more thread writes the finished bands to the file
+ * in order, while the workers carry on with the next ones. Only the ring is
+ * ever held in memory, so the memory used depends on the width of the image
+ * and the thread count, but never on its height.
+ */
+int renderToTarga_stream(const renderSettings renderInput)
+{
+    // Unpacks the inputs.
+    FILE               *imageFile   = renderInput.imageFile;
+    const int           width       = renderInput.draw.width;
+    const int           height      = renderInput.draw.height;
+    const int           threadCount = renderInput.draw.threadCount;
+    const colorSettings color       = renderInput.color;
+    renderStats        *stats       = renderInput.stats;
+
+    // Works out how many rows go in a band, and how many bands there are.
+    const size_t rowBytes  = (size_t) width * sizeof (tRGB);
+    const int    bandRows  = (rowBytes >= STREAM_BAND_BYTES) ?
+	1 : (int) (STREAM_BAND_BYTES / rowBytes);
+    const int    bandCount = (height + bandRows - 1) / bandRows;
+    const int    slotCount = threadCount * STREAM_SLOTS_PER_THREAD;
+
+    /* Each band is a segment of the image, which the worker that drew it
+       encodes too, into the end of its slot, so the writer only has to copy
+       it out. Each slot notes down how the segment came out, and each worker
+       has its own scratch space for encoding. */
+    const size_t   encodedBytes = imageSegmentBytes(renderInput.format, width,
+						    bandRows);
+    imageSegment   segment[slotCount];
+    imageWorkspace workspace[threadCount];
+    int            allocated    = 0;
+
+    while (allocated < threadCount &&
+	   imageWorkspaceAllocate(&workspace[allocated], renderInput.format,
+				  width, bandRows) == 0)
+	allocated++;
+
+    // Frees the workspaces allocated so far.
+    void freeWorkspaces(void) {
+	for (int i = 0; i < allocated; i++)
+	    imageWorkspaceFree(&workspace[i]);
+    }
+
+    bandRing ring;
+    if (allocated < threadCount ||
+	bandRingInit(&ring, rowBytes * bandRows + encodedBytes, slotCount,
+		     bandCount) != 0) {
+	freeWorkspaces();
+	return 1;
+    }
+
+    // Works out where the image lies, and how to calculate it.
+    renderPlan plan;
+    if (planRender(renderInput, &plan) != 0) {
+	bandRingFree(&ring);
+	freeWorkspaces();
+	return 1;
+    }
+
+    // Function for calculating the imaginary part of a point from the Y value.
+    double scaleY(int y) {
+	return plan.imagStart - plan.step * y;
+    }
+
+    // Rows in a band; the last one can come up short.
+    int rowsOf(int band) {
+	return (height - band * bandRows < bandRows) ?
+	    height - band * bandRows : bandRows;
+    }
+
+    // Draws a band into its slot of the ring, and encodes it.
+    void drawBand(int band, void *buffer, imageWorkspace *scratch) {
+	tRGB          *pixels  = buffer;
+	unsigned char *encoded = (unsigned char *) buffer + rowBytes * bandRows;
+
+	for (int row = 0; row < rowsOf(band); row++) {
+	    const int y = band * bandRows + row;
+
+	    for (int x = 0; x < width; x += SPAN_LENGTH) {
+		const int spanLength = (width - x < SPAN_LENGTH) ?
+		    width - x : SPAN_LENGTH;
+
+		renderColorSpan(&plan, color.maxIterations, x, scaleY(y),
+				spanLength, pixels + (size_t) row * width + x);
+	    }
+	}
+
+	segment[band % slotCount] = imageEncodeSegment(pixels, width,
+						       rowsOf(band), scratch,
+						       encoded);
+    }
+
+    // Writes a finished band out, already encoded.
+    imageWriter writer;
+
+    void writeBand(int band, const void *buffer) {
+	imageWriteSegment(&writer, &segment[band % slotCount],
+			  (const unsigned char *) buffer + rowBytes * bandRows);
+    }
+
+    // Time spent drawing by each worker thread, for the statistics.
+    threadStats threadTimes[threadCount];
+    for (int i = 0; i < threadCount; i++)
+	threadTimes[i] = (threadStats) {0, 0, 0, 0};
+
+    imageWriterStart(&writer, renderInput.format, width, height, imageFile);
+
+    const double startTime = omp_get_wtime();
+
+    // Thread 0 is the writer, and every other thread is a worker.
+    #pragma omp parallel num_threads(threadCount + 1)
+    {
+	const int threadID = omp_get_thread_num();
+	int       band;
+	void     *buffer;
+
+	if (omp_get_num_threads() == 1) {
+	    /* With only one thread to go around, it has to do both jobs, a
+	       band at a time. */
+	    while (bandRingClaim(&ring, &band, &buffer)) {
+		const double bandStart = omp_get_wtime();
+
+		drawBand(band, buffer, &workspace[0]);
+		threadTimes[0].busyTime  += omp_get_wtime() - bandStart;
+		threadTimes[0].tileCount += 1;
+		bandRingDone(&ring, band);
+
+		bandRingNextWrite(&ring, &band, &buffer);
+		writeBand(band, buffer);
+		bandRingWritten(&ring);
+	    }
+
+	} else if (threadID == 0) {
+	    while (bandRingNextWrite(&ring, &band, &buffer)) {
+		writeBand(band, buffer);
+		bandRingWritten(&ring);
+	    }
+
+	} else {
+	    /* If OpenMP gives us fewer threads than asked for, the workers
+	       there are just take more bands each. */
+	    threadStats *times = &threadTimes[threadID - 1];
+
+	    while (bandRingClaim(&ring, &band, &buffer)) {
+		const double bandStart = omp_get_wtime();
+
+		drawBand(band, buffer, &workspace[threadID - 1]);
+		times->busyTime  += omp_get_wtime() - bandStart;
+		times->tileCount += 1;
+		bandRingDone(&ring, band);
+	    }
+	}
+    } // End of parallel code.
+
+    const double renderTime = omp_get_wtime() - startTime;
+
+    imageWriterFinish(&writer);
+
+    // Anything a worker did not spend drawing, it spent waiting on the ring.
+    if (stats != NULL) {
+	stats->renderTime  = renderTime;
+	stats->threadCount = threadCount;
+
+	for (int i = 0; i < threadCount; i++) {
+	    stats->thread[i]          = threadTimes[i];
+	    stats->thread[i].idleTime = renderTime - threadTimes[i].busyTime;
+	}
+    }
+
+    finishRender(&plan);
+    bandRingFree(&ring);
+    freeWorkspaces();
+
+    // Returns no error.
+    return 0;
+}
+
+
+
+
+/* Where renderColorTiles sends each tile once it has been colored: the rows
+   of the tile, stride pixels apart, along with the thread that drew it. The
+   context is passed along untouched. Returns 1 if the tile could not be
+   written. */
+typedef int (*tileOutput)(void        *context,
+			  const int    threadID,
+			  const tTile *tile,
+			  const tRGB  *pixels,
+			  const int    stride);
+
+
+
+
+/*
+ * Renders the image in parallel, straight into colors, for the renderers that
+ * write the image out tile by tile. The threads take tiles from the scheduler,
+ * color each one in a buffer of their own, and hand it to the output as soon
+ * as it is done, while the others carry on. Only a tile per thread is ever
+ * held in memory. Tiles are filled in with draw.fill, like renderToTarga_fill,
+ * or worked out in full if it is FILL_NONE. Returns 1 if memory could not be
+ * allocated, and 2 if the output failed.
+ */
+static int renderColorTiles(const renderSettings renderInput,
+			    const int            tileSize,
+			    tileOutput           output,
+			    void                *outputContext)
+{
+    // Unpacks the inputs.
+    const int           width       = renderInput.draw.width;
+    const int           height      = renderInput.draw.height;
+    const int           threadCount = renderInput.draw.threadCount;
+    const fillMode      fill        = renderInput.draw.fill;
+    const colorSettings color       = renderInput.color;
+    renderStats        *stats       = renderInput.stats;
+    const size_t        tilePixels  = (size_t) tileSize * tileSize;
+
+    // Sets the thread count to the input amount.
+    omp_set_num_threads(threadCount);
+
+    /* Each thread gets its own queue of tiles, a tile of colors, and scratch
+       space for the fill routines. */
+    tileScheduler   scheduler;
+    renderPlan      plan;
+    regionWorkspace workspaces[threadCount];
+    int             workspaceCount = 0;
+    int             status         = 0;
+
+    if (tileSchedulerInit(&scheduler, width, height, tileSize,
+			  threadCount) != 0)
+	return 1;
+
+    tRGB *colors = malloc(threadCount * tilePixels * sizeof *colors);
+
+    if (colors == NULL)
+	status = 1;
+
+    if (fill != FILL_NONE) {
+	for (; workspaceCount < threadCount && status == 0; workspaceCount++)
+	    status = regionWorkspaceAllocate(&workspaces[workspaceCount],
+					     tileSize);
+    }
+
+    // Works out where the image lies, and how to calculate it.
+    if (status != 0 || planRender(renderInput, &plan) != 0) {
+	for (int i = 0; i < workspaceCount; i++)
+	    regionWorkspaceFree(&workspaces[i]);
+
+	free(colors);
+	tileSchedulerFree(&scheduler);
+	return 1;
+    }
+
+    const fillContext context = {&plan, color.maxIterations};
+
+    // Function for calculating the imaginary part of a point from the Y value.
+    double scaleY(int y) {
+	return plan.imagStart - plan.step * y;
+    }
+
+    // Time spent drawing by each thread, for the statistics.
+    threadStats threadTimes[threadCount];
+    for (int i = 0; i < threadCount; i++)
+	threadTimes[i] = (threadStats) {0, 0, 0, 0};
+
+    const double startTime = omp_get_wtime();
+
+    // Starts a parallel block of code, where each thread keeps taking tiles.
+    #pragma omp parallel
+    {
+	// Gets the thread number.
+	int threadID = omp_get_thread_num();
+
+	threadStats *times  = &threadTimes[threadID];
+	tRGB        *pixels = colors + threadID * tilePixels;
+	tTile        tile;
+	int          stolen;
+	int          failed = 0;
+
+	while (failed == 0 &&
+	       tileSchedulerNext(&scheduler, threadID, &tile, &stolen)) {
+	    const double tileStart = omp_get_wtime();
+
+	    if (fill != FILL_NONE) {
+		// Fills the tile in, then colors it from the palette.
+		regionWorkspace *workspace = &workspaces[threadID];
+
+		regionFill(fill, &tile, fillPixels, &context, workspace);
+
+		for (int y = 0; y < tile.height; y++)
+		    for (int x = 0; x < tile.width; x++)
+			pixels[y * tileSize + x] = paletteColor(
+			    &plan.palette,
+			    workspace->escapes[y * tile.width + x]);
+	    } else {
+		// Renders the tile a span at a time, straight into colors.
+		for (int y = 0; y < tile.height; y++) {
+		    for (int x = 0; x < tile.width; x += SPAN_LENGTH) {
+			const int spanLength = (tile.width - x < SPAN_LENGTH) ?
+			    tile.width - x : SPAN_LENGTH;
+
+			renderColorSpan(&plan, color.maxIterations, tile.x + x,
+					scaleY(tile.y + y), spanLength,
+					pixels + y * tileSize + x);
+		    }
+		}
+	    }
+
+	    failed = output(outputContext, threadID, &tile, pixels, tileSize);
+
+	    times->busyTime   += omp_get_wtime() - tileStart;
+	    times->tileCount  += 1;
+	    times->stealCount += stolen;
+	}
+
+	// A tile that could not be written spoils the whole image.
+	if (failed != 0) {
+	    #pragma omp atomic write
+	    status = 2;
+	}
+    } // End of parallel code.
+
+    const double renderTime = omp_get_wtime() - startTime;
+
+    // Anything a thread did not spend drawing, it spent waiting.
+    if (stats != NULL) {
+	stats->renderTime  = renderTime;
+	stats->threadCount = threadCount;
+
+	for (int i = 0; i < threadCount; i++) {
+	    stats->thread[i]          = threadTimes[i];
+	    stats->thread[i].idleTime = renderTime - threadTimes[i].busyTime;
+	}
+    }
+
+    for (int i = 0; i < workspaceCount; i++)
+	regionWorkspaceFree(&workspaces[i]);
+
+    finishRender(&plan);
+    free(colors);
+    tileSchedulerFree(&scheduler);
+
+    return status;
+}
+
+
+
+
+/* What writeTiffTile needs: the file, and a tile of bytes for each thread to
+   lay its tile out in. */
+typedef struct {
+    tiffWriter     tiff;
+    unsigned char *bytes;
+} tiffOutput;
+
+
+
+
+// Tile output for renderToTiff. Writes the tile to its place in the file.
+static int writeTiffTile(void        *context,
+			 const int    threadID,
+			 const tTile *tile,
+			 const tRGB  *pixels,
+			 const int    stride)
+{
+    const tiffOutput *out = context;
+
+    return tiffWriteTile(&out->tiff, tile->x, tile->y, pixels, stride,
+			 out->bytes + threadID * out->tiff.tileBytes);
+}
+
+
+
+
+/* Renders the image into a tiled TIFF file, writing every tile to its place
+   in the file as soon as it is drawn, so there is no limit on the size of the
+   image but the disk. */
+int renderToTiff(const renderSettings renderInput)
+{
+    const size_t tileBytes = (size_t) TIFF_TILE_SIZE * TIFF_TILE_SIZE * 3;
+    tiffOutput   out;
+
+    out.bytes = malloc(renderInput.draw.threadCount * tileBytes);
+    if (out.bytes == NULL)
+	return 1;
+
+    // The header says where every tile goes, so it has to be written first.
+    if (tiffWriterInit(&out.tiff, renderInput.imageFile,
+		       renderInput.draw.width, renderInput.draw.height,
+		       TIFF_TILE_SIZE) != 0) {
+	free(out.bytes);
+	return 2;
+    }
+
+    const int status = renderColorTiles(renderInput, TIFF_TILE_SIZE,
+					writeTiffTile, &out);
+    free(out.bytes);
+
+    return status;
+}
+
+
+
+
+// Tile output for renderToTarga_mapped. Puts the tile's rows in the file.
+static int writeMappedTile(void        *context,
+			   const int    threadID,
+			   const tTile *tile,
+			   const tRGB  *pixels,
+			   const int    stride)
+{
+    const tTargaMap *map = context;
+
+    (void) threadID;
+
+    for (int y = 0; y < tile->height; y++)
+	targaPackRow_RGB24(pixels + (size_t) y * stride, tile->width,
+			   targaMapRow(map, tile->y + y) + (size_t) tile->x * 3);
+
+    return 0;
+}
+
+
+
+
+/*
+ * Renders the image in parallel, straight into a TARGA file mapped into
+ * memory. Every thread puts its tiles' pixels right where they belong in the
+ * file, so there is no image in RAM to copy out, and nothing left to write
+ * once the last tile is drawn.
+ */
+int renderToTarga_mapped(const renderSettings renderInput)
+{
+    tTargaMap map;
+
+    if (targaMapImage(&map, renderInput.imageFile, renderInput.draw.width,
+		      renderInput.draw.height) != 0)
+	return 2;
+
+    const int status = renderColorTiles(renderInput, MAPPED_TILE_SIZE,
+					writeMappedTile, &map);
+
+    // Unmapping hands the pages over to be written back, like closing a file.
+    if (targaUnmapImage(&map) != 0 && status == 0)
+	return 2;
+
+    return status;
+}
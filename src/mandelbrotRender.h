@@ -16,6 +16,8 @@
 #define MANDELBROT_RENDER_MODULE
 
 #include <stdio.h>
+#include "escapeBuffer.h"
+#include "imageWriter.h"
 
 
 
@@ -27,17 +29,95 @@ typedef struct {
 
 
 
+/* The escape-time kernels available to the renderers. The vector kernels need
+   the matching instruction set, which escapeKernelSupported can check for. */
+typedef enum {
+    KERNEL_AUTO = 0, // Whichever is fastest on the running CPU.
+    KERNEL_SCALAR,   // One point at a time, in plain C.
+    KERNEL_SSE2,     // Two points at a time.
+    KERNEL_AVX2,     // Four points at a time.
+    KERNEL_AVX512    // Eight points at a time.
+} kernelType;
+
+
+
+/* The fractals the escape-time kernels can draw. Each is iterated at a power,
+   from 2 up to FRACTAL_POWER_MAX, with a kernel compiled for every pairing. */
+typedef enum {
+    FRACTAL_MANDELBROT = 0, // z^p + c from z = 0. Multibrot sets, past p = 2.
+    FRACTAL_JULIA,          // z^p + k from z = c, for the Julia constant k.
+    FRACTAL_BURNING_SHIP,   // (|Re z| + |Im z|i)^p + c from z = 0.
+    FRACTAL_TYPES           // Number of fractal types.
+} fractalType;
+
+#define FRACTAL_POWER_MAX 8
+
+
+
+/* Solid-region fill modes, for renderToTarga_fill. See 'regionFill.h' for how
+   they work. */
+typedef enum {
+    FILL_NONE = 0,  // Works out every pixel.
+    FILL_SUBDIVIDE, // Mariani-Silver rectangle subdivision.
+    FILL_TRACE      // Boundary tracing.
+} fillMode;
+
+
+
+/* Distance of the top row of an exponential map from its center, in units of
+   1 / zoomLevel. This reaches the corners of a square view. */
+#define EXP_MAP_OUTER 2.82842712474619009760
+
+
+
+/* Interior checks, for spotting points of a Mandelbrot set that will never
+   escape without running them through every iteration. These are bit flags,
+   and can be combined. */
+#define INTERIOR_NONE        0
+#define INTERIOR_BULBS       1 // Tests for the main cardioid and period-2 bulb.
+#define INTERIOR_PERIODICITY 2 // Catches orbits that cycle back on themselves.
+#define INTERIOR_ALL         (INTERIOR_BULBS | INTERIOR_PERIODICITY)
+
+
+
 // Customizable settings for the low-level calculations of the image.
 typedef struct {
-    // Tells the renderer whether or not it should render a Julia set.
-    int      juliaFlag;
+    // The fractal to render, and the power z is raised to.
+    fractalType fractal;
+    int         power;
     /* If the renderer is rendering a Julia set, this holds the fixed value
        describing the set. */
-    tComplex juliaConstant;
+    tComplex   juliaConstant;
+    // The escape-time kernel to iterate the points with.
+    kernelType kernel;
+    /* Which interior checks to use (INTERIOR_* flags). The bulbs are only
+       tested for on the Mandelbrot set itself, at a power of 2. */
+    int        interiorChecks;
+    /* Deep-zoom mode, for Mandelbrot sets (at a power of 2) past the limits
+       of doubles. The center is given again as decimal strings, since
+       converting it to a double would lose the digits that matter. */
+    int         deepZoom;
+    const char *deepReal;
+    const char *deepImag;
+    // Also works out smooth (fractional) escape times. Not for deep zooms.
+    int         smooth;
+    // Worked out by the renderers in deep-zoom mode. Leave as NULL.
+    const struct referenceOrbit *reference;
 } calcSettings;
 
 
 
+/* Widest and tallest image the renderers can draw. Pixels are counted with
+   ints, and this leaves room for rounding the image up to whole tiles. TARGA
+   images are further held to TARGA_SIZE_MAX by their header. */
+#define IMAGE_SIZE_MAX (1 << 30)
+
+/* Finest supersampling grid, across and down each pixel. A pixel's samples
+   have to fit in one batch of points for the kernel. */
+#define SUPERSAMPLE_MAX 8
+
+
+
 // Customizable settings for how the renderer creates and maps the image.
 typedef struct {
     unsigned long int width;
@@ -45,6 +125,13 @@ typedef struct {
     unsigned int      threadCount;
     tComplex          offset; // Place in complex plane the image is centered onto.
     double            zoomLevel;
+    fillMode          fill;   // Only used by renderToTarga_fill.
+    int               passes; // Only used by renderToTarga_progressive.
+    /* Grid of samples taken across and down the pixels on edges, or 1 for
+       none. Only used by the renderers that keep the escape times of the
+       whole image: renderToTarga, _parallel, _fill, _progressive, and
+       renderAnimation. */
+    int               samples;
 } drawSettings;
 
 
@@ -71,6 +158,44 @@ typedef struct {
 
 
 
+// Time spent by a single thread during a render.
+typedef struct {
+    double        busyTime;   // Seconds spent drawing.
+    double        idleTime;   // Seconds spent waiting on work or other threads.
+    unsigned long tileCount;  // Number of tiles drawn.
+    unsigned long stealCount; // Number of those tiles taken from other threads.
+} threadStats;
+
+
+
+/*
+ * Statistics that the renderers report back, if asked for.
+ *
+ * The caller provides the space for the per-thread numbers, with room for at
+ * least draw.threadCount entries. The renderer fills in threadCount to say how
+ * many of them it used.
+ */
+typedef struct {
+    double       renderTime;  // Wall-clock seconds spent drawing the image.
+    unsigned int threadCount;
+    threadStats *thread;
+} renderStats;
+
+
+
+/*
+ * Called by renderToTarga_progressive after each pass but the last, with the
+ * escape times so far. Pixels that have not been worked out yet hold a copy of
+ * the nearest one above and to the left that has, so the buffer can be colored
+ * as a blocky preview of the final image. The context is whatever was put in
+ * renderSettings.passContext, passed along untouched.
+ */
+typedef void (*passFunction)(void                *context,
+			     const int            pass,
+			     const tEscapeBuffer *escapes);
+
+
+
 /*
  * A single struct for packing in the numerous arguments for the renderer.
  *
@@ -87,18 +212,257 @@ typedef struct {
     colorSettings color;
     calcSettings  calc;
     FILE         *imageFile;
+    imageFormat   format;     // What the image is saved as.
+    FILE         *escapeFile; // Escape times are saved here too, unless NULL.
+    renderStats  *stats;      // Filled in by the renderer, unless NULL.
+    passFunction  passDone;   // Called between the passes of a progressive
+    void         *passContext; // render, unless NULL.
+    /* Escape times, and the colors made from them, are kept in buffers from
+       this pool (see 'bufferPool.h'), unless NULL. Used by the renderers that
+       keep the escape times of the whole image. */
+    struct bufferPool *pool;
 } renderSettings;
 
 
 
+/*
+ * Settings for a zoom animation, from one view to another. The zoom changes by
+ * the same factor from each frame to the next, and the center moves so that
+ * it drifts across the screen at a steady pace, landing on the end exactly.
+ *
+ * Each frame goes to its own file. openFrame is asked for the file before a
+ * frame is written, and can return NULL to stop the animation there; every
+ * file it opens is handed back to closeFrame once the frame is in it. The
+ * context is passed to both untouched.
+ */
+typedef struct {
+    tComplex startOffset;
+    double   startZoom;
+    tComplex endOffset;
+    double   endZoom;
+    int      frameCount;
+    FILE  *(*openFrame)(void *context, const int frame);
+    void   (*closeFrame)(void *context, const int frame, FILE *file);
+    void    *context;
+} animationSettings;
+
+
+
+/*
+ * Settings for an atlas of Julia sets: one thumbnail for each Julia constant,
+ * all framed by the same view. The thumbnails are packed into one image,
+ * columns of them across, in the order given, leaving any cells past the last
+ * one inside the set.
+ *
+ * If openThumbnail is set, each thumbnail goes to its own file instead, opened
+ * by openThumbnail and handed back to closeThumbnail once it has been written.
+ * Both are called from whichever thread drew the thumbnail, so several can be
+ * running at once, in no set order. openThumbnail can return NULL to stop the
+ * atlas. The context is passed to both untouched.
+ */
+typedef struct {
+    const tComplex *constants;
+    int             count;
+    int             columns;
+    FILE         *(*openThumbnail)(void *context, const int index);
+    void          (*closeThumbnail)(void *context, const int index, FILE *file);
+    void           *context;
+} atlasSettings;
+
+
+
+// Deepest level of a tile pyramid, which has 2^level tiles across and down.
+#define PYRAMID_LEVEL_MAX 30
+
+// How the tiles of a pyramid were come by, over every level.
+typedef struct {
+    unsigned long drawn;    // Worked out pixel by pixel.
+    unsigned long known;    // Known to be all one escape time, from where.
+    unsigned long uniform;  // Taken to be all one escape time, from the edge.
+    unsigned long existing; // Already there, and left alone.
+} pyramidCounts;
+
+
+
+/*
+ * Settings for a pyramid of map tiles, as a slippy-map viewer loads them. The
+ * view in renderInput.draw is level 0, a single tile, and each level below it
+ * has twice as many tiles across and down, each drawn the way the view would
+ * be with the zoom level doubled and the center moved onto the tile. Tiles are
+ * counted from 0, from the top left. Unless bounded is 0, only the tiles that
+ * touch the region from regionStart to regionEnd (two corners, given the same
+ * way as draw.offset) are drawn.
+ *
+ * Tiles that tileExists says are already there are left alone, so that a
+ * pyramid that was stopped partway can be finished by running it again. Each
+ * other tile goes to its own file, as the thumbnails of an atlas do, opened by
+ * openTile and handed back to closeTile once written. The context is passed to
+ * all three untouched.
+ */
+typedef struct {
+    int            minLevel;
+    int            maxLevel;
+    int            bounded;
+    tComplex       regionStart;
+    tComplex       regionEnd;
+    int          (*tileExists)(void *context, const int level, const int x,
+			       const int y);
+    FILE        *(*openTile)(void *context, const int level, const int x,
+			     const int y);
+    void         (*closeTile)(void *context, const int level, const int x,
+			      const int y, FILE *file);
+    void          *context;
+    pyramidCounts *counts; // Filled in by the renderer, unless NULL.
+} pyramidSettings;
+
+
+
 /* 
- * Rendering functions. They draw mandelbrots to a given file.
+ * Rendering functions. They draw mandelbrots to a given file, in the format
+ * given by renderSettings.format (except where said otherwise), despite their
+ * names.
  *
  * For the simplicity of keeping the image API out of the I/O code, these
  * functions are rather heavy-handed in what they do.
+ *
+ * The ones that keep every escape time until the image is done supersample
+ * the edges of the image as they color it, if draw.samples is over 1, working
+ * out and averaging draw.samples^2 points for every pixel that differs from
+ * one of its neighbours.
  */
 int renderToTarga(const renderSettings renderInput);
 int renderToTarga_parallel(const renderSettings renderInput);
 int renderToTarga_lowMem(const renderSettings renderInput);
 
+/* Like renderToTarga_lowMem, but draws and encodes bands of rows on
+   draw.threadCount threads, while one more thread writes them out in order. */
+int renderToTarga_stream(const renderSettings renderInput);
+
+/*
+ * Like renderToTarga_parallel, but maps the image file into memory, and has
+ * every thread write its pixels straight into their places in the file, which
+ * is always an uncompressed TARGA image. There is no copy of the image in RAM
+ * besides the file's own pages, and nothing left to write out once the last
+ * tile is drawn. Uses draw.fill like renderToTarga_fill. The file must be a
+ * regular file, not a pipe, and the escape times cannot be saved. Returns 1 if
+ * memory could not be allocated, and 2 if the file could not be mapped.
+ */
+int renderToTarga_mapped(const renderSettings renderInput);
+
+/*
+ * Renders the image in parallel, into a tiled TIFF file instead of a TARGA
+ * one, writing every tile to the file as soon as it is drawn. Memory use
+ * depends only on the thread count, so images can be as big as IMAGE_SIZE_MAX
+ * both ways. Uses draw.fill like renderToTarga_fill. The file must be a
+ * regular file, not a pipe, and the escape times cannot be saved. Returns 1 if
+ * memory could not be allocated, and 2 if the file could not be written.
+ */
+int renderToTiff(const renderSettings renderInput);
+
+/* Like renderToTarga_parallel, but skips working out the inside of regions
+   that all share one escape time, using the fill mode in draw.fill. */
+int renderToTarga_fill(const renderSettings renderInput);
+
+/*
+ * Draws the escape times of the image, as renderToTarga_parallel would (or
+ * renderToTarga_fill, if draw.fill is set), but hands them back instead of
+ * coloring them, in a buffer it allocates (from renderInput.pool, if set).
+ * The caller deallocates it. Nothing is written, and draw.samples is not
+ * used. Returns 1 if memory could not be allocated.
+ */
+int renderEscapes(const renderSettings renderInput, tEscapeBuffer *escapes);
+
+/*
+ * Like renderToTarga_parallel, but draws the image in draw.passes passes, each
+ * with twice the resolution of the last, starting at one pixel in every
+ * 2^(passes - 1) across and down. Each pass only works out the pixels the
+ * passes before it have not, so the whole image costs the same as usual, and
+ * comes out the same. passDone is called after each pass but the last.
+ */
+int renderToTarga_progressive(const renderSettings renderInput);
+
+/*
+ * Renders an exponential map of the view, for zoom videos: a strip with the
+ * angle around the center (offset) going across, from 0 to a full turn, and
+ * the log of the distance from it going down. The top row passes through the
+ * corners of the view at zoomLevel (EXP_MAP_OUTER / zoomLevel away), and each
+ * row is a little deeper than the one above, expMapDepth(width, height) times
+ * deeper by the bottom. Any view of the zoom, down to that depth, can then be
+ * rebuilt from the map by expMapToTarga, without iterating anything. Drawn in
+ * parallel, using draw.fill like renderToTarga_fill. Not for smooth colors.
+ */
+int    renderToTarga_expMap(const renderSettings renderInput);
+double expMapDepth(const int width, const int height);
+
+/*
+ * Rebuilds a view of the given size from the escape times of an exponential
+ * map, at a zoom level relative to the map's top row (so 1 is the view the map
+ * was drawn for). Returns 1 if memory could not be allocated.
+ */
+int expMapToTarga(const tEscapeBuffer *strip,
+		  colorSettings        color,
+		  const double         zoomLevel,
+		  const int            width,
+		  const int            height,
+		  const imageFormat    format,
+		  FILE                *imageFile);
+
+/*
+ * Renders a whole zoom animation, one image per frame, in parallel. The
+ * offset and zoom level in renderInput.draw are ignored in favour of the
+ * animation's. The palette, buffers and threads are set up once and shared by
+ * every frame. Each frame uses the one before it to guess which of its tiles
+ * are a single escape time. A guessed tile that can be proven to be one
+ * (inside the main cardioid or period-2 bulb, or wholly in one band outside
+ * the set) is filled in without being worked out. With draw.fill set to
+ * FILL_NONE, the rest are drawn in full, and each frame comes out the same as
+ * a single image. Otherwise, the other guessed tiles are drawn with the fill
+ * mode, and the rest in full. Not for deep zooms, or escape time files.
+ * Returns 1 if memory could not be allocated, or openFrame returned NULL.
+ */
+int renderAnimation(const renderSettings    renderInput,
+		    const animationSettings animation);
+
+/*
+ * Renders an atlas of Julia sets, with each thumbnail as a job of its own,
+ * drawn whole by whichever thread takes it next. draw.width and draw.height
+ * are the size of a thumbnail, and calc.fractal is taken to be a Julia set.
+ * The palette, kernels and buffers are set up once for the whole atlas, not
+ * once a thumbnail. A packed atlas is written to imageFile, and can have its
+ * escape times saved. Not for deep zooms or supersampling, and draw.fill is
+ * not used. Returns 1 if memory could not be allocated, or openThumbnail
+ * returned NULL.
+ */
+int renderAtlas(const renderSettings renderInput, const atlasSettings atlas);
+
+/*
+ * Renders a pyramid of map tiles, a level at a time from the top, with the
+ * tiles of each level handed out one at a time to whichever thread is free.
+ * draw.width and draw.height are the size of a tile, and tile y = 0 is the top
+ * row. Tiles wholly inside the main cardioid or period-2 bulb, or wholly past
+ * the escape radius, are filled in without being worked out. With draw.fill
+ * set to FILL_NONE, the tiles of a level join up into exactly the view drawn
+ * at the level's whole size. With any other fill mode, Mandelbrot tiles are worked out around the edge first, and
+ * one whose edge is all one escape time (and that does not hold 0) is taken
+ * to be all of it, as neither the set nor any band of points that stay for a
+ * given number of iterations or more has holes. Like the fill modes, this
+ * misses detail thinner than a pixel. Not for deep zooms or supersampling.
+ * Returns 1 if memory could not be allocated, or openTile returned NULL.
+ */
+int renderPyramid(const renderSettings  renderInput,
+		  const pyramidSettings pyramid);
+
+/*
+ * Colors escape times that have already been worked out, such as ones read
+ * back from a file, and writes them to an image. This takes no iterating at
+ * all, so trying out new color settings this way is very quick. The image is
+ * colored and encoded on threadCount threads. Returns 1 if memory could not
+ * be allocated.
+ */
+int colorizeToTarga(const tEscapeBuffer *escapes,
+		    colorSettings        color,
+		    const imageFormat    format,
+		    const int            threadCount,
+		    FILE                *imageFile);
+
 #endif // MANDELBROT_RENDER_MODULE
@@ -0,0 +1,161 @@
+/*
+ * Color palettes, part of an exercise program that draws mandelbrot sets.
+ *
+ * This module holds the coloring algorithm itself, and the palettes that save
+ * its results.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "palette.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+
+
+
+// Outputs a color, based on the escape time.
+tRGB escapeColor(const int escapeTime,
+		 const colorSettings color)
+{
+    // Unpacks the used color settings.
+    int    maxIterations = color.maxIterations;
+    double constantLight = color.constantLight;
+    double hueLimiter    = color.hueLimiter;
+    double hueOffset     = color.hueOffset;
+    double lightMax      = color.lightMax;
+    double lightDist     = color.lightDistribution;
+    
+    // RGB color value to return.
+    tRGB colorReturn;
+
+    /* Points with zeroed-out escape time are assumed to be in the mandelbrot
+       set. */
+    if (escapeTime == 0) {
+	colorReturn.r = 0;
+	colorReturn.g = 0;
+	colorReturn.b = 0;
+	return colorReturn;
+    }
+
+    // Calculates the ratio between the escape time and maximum iteration count.
+    const double eTime  = (double) escapeTime;
+    const double mIter  = (double) maxIterations;
+    const double eRatio = eTime / mIter;
+
+    // The color is being calculated in an HSL color-space.
+    double hue;
+    double saturation;
+    double lightness;
+
+    // Calculates the hue, as a function of the escape-time ratio.
+    hue  = 360.0 - 360.0 * eRatio * hueLimiter;
+    hue  = fmod(hue, 360.0);
+    hue += hueOffset;
+    hue  = fmod(hue, 360.0);
+
+    // Calculates the saturation. This is currently a fixed value.
+    saturation = 1;
+
+    /* Calculates the lightness, either as a function of escape-time ratio, or
+       as a constant value. */
+    if (constantLight == 0) {
+	lightness   = lightMax * pow(eRatio, lightDist);
+	lightness   = lightMax - lightness;
+    } else {
+	lightness = constantLight;
+    }
+    
+    /* en.wikipedia.org/wiki/HSL_and_HSV#From_HSL -> source of HSL to RGB color
+       conversion. */
+
+    // Calculates chroma value of the pixel.
+    double chroma;
+    chroma  = 1.0 - fabs(2.0 * lightness - 1.0);
+    chroma *= saturation;
+
+    // Because smaller numbers look neater. Or something like that.
+    hue /= 60.0;
+
+    // Calculates an intermediate value, X.
+    double X;
+    X  = 1.0 - fabs(fmod(hue, 2.0) - 1.0);
+    X *= chroma;
+
+    // Finds out the appropriate RGB values based on Hue.
+    double r = 0;
+    double g = 0;
+    double b = 0;
+    if (hue < 1.0) {
+	r = chroma;
+	g = X;
+    } else if (hue < 2.0) {
+	r = X;
+	g = chroma;
+    } else if (hue < 3.0) {
+	g = chroma;
+	b = X;
+    } else if (hue < 4.0) {
+	g = X;
+	b = chroma;
+    } else if (hue < 5.0) {
+	r = X;
+	b = chroma;
+    } else if (hue < 6.0) {
+	r = chroma;
+	b = X;
+    }
+
+    // Calculates an intermediate value, m, to translate the RGB values.
+    double m = lightness - 0.5 * chroma;
+
+    // Translates the RGB values.
+    r += m;
+    b += m;
+    g += m;
+
+    // Converts the RGB values to 8 bit integers and saves them to the output.
+    r *= 255;
+    g *= 255;
+    b *= 255;
+    colorReturn.r = ((unsigned int) ceil(r)) & 0x00FF;
+    colorReturn.g = ((unsigned int) ceil(g)) & 0x00FF;
+    colorReturn.b = ((unsigned int) ceil(b)) & 0x00FF;
+    
+    // Returns the final color value of the pixel.
+    return colorReturn;
+}
+
+
+
+
+/* Runs every escape time through escapeColor once. The table is small next to
+   the image (4 bytes per iteration), so this costs next to nothing. */
+int paletteBuild(tPalette *palette, const colorSettings color)
+{
+    palette->length = color.maxIterations + 1;
+    palette->colors = malloc((size_t) palette->length * sizeof *palette->colors);
+
+    if (palette->colors == NULL)
+	return 1;
+
+    for (int i = 0; i < palette->length; i++)
+	palette->colors[i] = escapeColor(i, color);
+
+    return 0;
+}
+
+
+
+
+// Frees the memory of a palette.
+void paletteFree(tPalette *palette)
+{
+    free(palette->colors);
+    palette->colors = NULL;
+    palette->length = 0;
+}
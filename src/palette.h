@@ -0,0 +1,81 @@
+/*
+ * Color palettes, part of an exercise program that draws mandelbrot sets.
+ *
+ * The color of a pixel depends only on its escape time and the color settings,
+ * and escape times only run from 0 to maxIterations. So instead of working out
+ * the HSL colors of every pixel, each possible color is worked out once per
+ * render and kept in a table, and coloring a pixel is just a lookup.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef PALETTE_MODULE
+#define PALETTE_MODULE
+
+#include "mandelbrotRender.h"
+#include "targa.h"
+
+
+
+// The colors of every escape time, from 0 up to maxIterations.
+typedef struct {
+    tRGB *colors;
+    int   length; // maxIterations + 1.
+} tPalette;
+
+
+
+// Outputs a color, based on the escape time. Slow; use a palette instead.
+tRGB escapeColor(const int escapeTime, const colorSettings color);
+
+/* Tools for creating a palette for a set of color settings. Building returns 1
+   if memory could not be allocated. */
+int  paletteBuild(tPalette *palette, const colorSettings color);
+void paletteFree(tPalette *palette);
+
+// Gets the color of an escape time, which must be in the palette's range.
+static inline tRGB paletteColor(const tPalette *palette, const int escapeTime)
+{
+    return palette->colors[escapeTime];
+}
+
+/* Gets the color of a smooth escape time, by blending the colors of the two
+   whole escape times either side of it. Points inside the set (an escape time
+   of 0) stay the color of 0, rather than being blended. */
+static inline tRGB paletteSmoothColor(const tPalette *palette,
+				      const int       escapeTime,
+				      const float     smoothTime)
+{
+    int below = (int) smoothTime;
+
+    if (escapeTime == 0 || palette->length < 3)
+	return palette->colors[escapeTime];
+
+    // Keeps both colors among the escaped ones, 1 to maxIterations.
+    if (below < 1)
+	below = 1;
+    if (below > palette->length - 2)
+	below = palette->length - 2;
+
+    int blend = (int) ((smoothTime - below) * 256);
+
+    if (blend < 0)
+	blend = 0;
+    if (blend > 256)
+	blend = 256;
+
+    const tRGB low  = palette->colors[below];
+    const tRGB high = palette->colors[below + 1];
+    tRGB       color;
+
+    color.r = low.r + (((int) high.r - (int) low.r) * blend) / 256;
+    color.g = low.g + (((int) high.g - (int) low.g) * blend) / 256;
+    color.b = low.b + (((int) high.b - (int) low.b) * blend) / 256;
+
+    return color;
+}
+
+#endif // PALETTE_MODULE
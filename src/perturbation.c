@@ -0,0 +1,255 @@
+/*
+ * Deep-zoom rendering by perturbation theory, part of an exercise program that
+ * draws mandelbrot sets.
+ *
+ * This module works out reference orbits, and iterates pixels against them.
+ * The maths behind it is explained in 'perturbation.h'.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "perturbation.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include "bigFixed.h"
+
+/* Bits of precision kept beyond what it takes to tell neighbouring pixels
+   apart, for rounding errors to build up in along the orbit. */
+#define GUARD_BITS 64
+
+
+
+
+/* Reference points tried across each direction of the image, should the
+   center escape early. */
+#define CANDIDATE_GRID 5
+
+
+
+
+/* Iterates a point at full precision, saving each step of its orbit as
+   doubles. Returns the number of iterations it lasted. */
+static int iterateReference(const tBigFixed *cReal,
+			    const tBigFixed *cImag,
+			    const int        maxIterations,
+			    double          *orbitReal,
+			    double          *orbitImag)
+{
+    // Z starts at 0, as with any Mandelbrot set.
+    tBigFixed zReal, zImag;
+    bigFixedFromDouble(&zReal, 0, cReal->limbCount);
+    bigFixedFromDouble(&zImag, 0, cReal->limbCount);
+
+    orbitReal[0] = 0;
+    orbitImag[0] = 0;
+
+    for (int n = 1; n <= maxIterations; n++) {
+	tBigFixed real2, imag2, cross;
+
+	// Z' = Z^2 + C, worked out one part at a time.
+	bigFixedMul(&real2, &zReal, &zReal);
+	bigFixedMul(&imag2, &zImag, &zImag);
+	bigFixedMul(&cross, &zReal, &zImag);
+
+	bigFixedSub(&zReal, &real2, &imag2);
+	bigFixedAdd(&zReal, &zReal, cReal);
+	bigFixedAdd(&zImag, &cross, &cross);
+	bigFixedAdd(&zImag, &zImag, cImag);
+
+	const double real = bigFixedToDouble(&zReal);
+	const double imag = bigFixedToDouble(&zImag);
+
+	orbitReal[n] = real;
+	orbitImag[n] = imag;
+
+	// Once the reference escapes, there is nothing more to follow.
+	if (real * real + imag * imag >= 4)
+	    return n;
+    }
+
+    return maxIterations;
+}
+
+
+
+
+/* Iterates the center of the image, or failing that the longest-lasting of a
+   grid of points across the image. */
+int perturbationOrbit(referenceOrbit *orbit,
+		      const calcSettings calc,
+		      const drawSettings draw,
+		      const int          maxIterations)
+{
+    // Pixels are 4 / (width * zoom) apart, so that is the precision needed.
+    const double pixelsPerUnit = draw.width * draw.zoomLevel / 4;
+    const int    bits          = (int) ceil(log2(pixelsPerUnit)) + GUARD_BITS;
+    const int    limbs         = bigFixedLimbsFor(bits);
+
+    // The image is centered on (real) + (imag)i, as the renderers have it.
+    tBigFixed centerReal, centerImag;
+    if (bigFixedParse(&centerReal, calc.deepReal, limbs) != 0 ||
+	bigFixedParse(&centerImag, calc.deepImag, limbs) != 0)
+	return 1;
+
+    // Space for the best orbit so far, and for the one being tried.
+    double *candidateReal = malloc((maxIterations + 1) * sizeof (double));
+    double *candidateImag = malloc((maxIterations + 1) * sizeof (double));
+    orbit->real = malloc((maxIterations + 1) * sizeof *orbit->real);
+    orbit->imag = malloc((maxIterations + 1) * sizeof *orbit->imag);
+
+    if (candidateReal == NULL || candidateImag == NULL ||
+	orbit->real == NULL || orbit->imag == NULL) {
+	free(candidateReal);
+	free(candidateImag);
+	perturbationFreeOrbit(orbit);
+	return 1;
+    }
+
+    orbit->offsetReal = 0;
+    orbit->offsetImag = 0;
+    orbit->length     = iterateReference(&centerReal, &centerImag,
+					 maxIterations,
+					 orbit->real, orbit->imag);
+
+    /* Tries the grid of other points if the center escaped. Their offsets
+       use the same mapping as the pixels, relative to the center. */
+    const double step = 4 / (draw.width * draw.zoomLevel);
+
+    for (int i = 0; i < CANDIDATE_GRID * CANDIDATE_GRID; i++) {
+	if (orbit->length == maxIterations)
+	    break;
+
+	const double x          = (i % CANDIDATE_GRID + 0.5) * draw.width /
+	    CANDIDATE_GRID;
+	const double y          = (i / CANDIDATE_GRID + 0.5) * draw.height /
+	    CANDIDATE_GRID;
+	const double offsetReal = -2.0 / draw.zoomLevel + step * x;
+	const double offsetImag = (2.0 / draw.zoomLevel) * draw.height /
+	    draw.width - step * y;
+
+	tBigFixed cReal, cImag;
+	bigFixedFromDouble(&cReal, offsetReal, limbs);
+	bigFixedFromDouble(&cImag, offsetImag, limbs);
+	bigFixedAdd(&cReal, &cReal, &centerReal);
+	bigFixedAdd(&cImag, &cImag, &centerImag);
+
+	const int length = iterateReference(&cReal, &cImag, maxIterations,
+					    candidateReal, candidateImag);
+
+	// Keeps the candidate if it lasted longer, by swapping the arrays.
+	if (length > orbit->length) {
+	    double *swapReal = orbit->real;
+	    double *swapImag = orbit->imag;
+
+	    orbit->real       = candidateReal;
+	    orbit->imag       = candidateImag;
+	    orbit->length     = length;
+	    orbit->offsetReal = offsetReal;
+	    orbit->offsetImag = offsetImag;
+	    candidateReal     = swapReal;
+	    candidateImag     = swapImag;
+	}
+    }
+
+    free(candidateReal);
+    free(candidateImag);
+
+    return 0;
+}
+
+
+
+
+// Frees the memory of a reference orbit.
+void perturbationFreeOrbit(referenceOrbit *orbit)
+{
+    free(orbit->real);
+    free(orbit->imag);
+    orbit->real = NULL;
+    orbit->imag = NULL;
+}
+
+
+
+
+/* Iterates a pixel as a difference from the reference orbit, counting down
+   the iterations the same way escapeTime does. */
+static inline int perturbPoint(const referenceOrbit *orbit,
+			       const int             maxIterations,
+			       const double          dcReal,
+			       const double          dcImag)
+{
+    // Distance of the pixel's orbit from Z.
+    double dReal = 0;
+    double dImag = 0;
+    int    m     = 0; // Step of the reference orbit being followed.
+
+    for (int iterations = maxIterations; iterations > 0; iterations--) {
+	// d' = (2Z + d)d + dc
+	const double twoZReal = 2 * orbit->real[m] + dReal;
+	const double twoZImag = 2 * orbit->imag[m] + dImag;
+	const double newReal  = twoZReal * dReal - twoZImag * dImag + dcReal;
+	const double newImag  = twoZReal * dImag + twoZImag * dReal + dcImag;
+
+	dReal = newReal;
+	dImag = newImag;
+	m++;
+
+	// The pixel's own z is the reference plus the difference.
+	const double zReal     = orbit->real[m] + dReal;
+	const double zImag     = orbit->imag[m] + dImag;
+	const double magnitude = zReal * zReal + zImag * zImag;
+
+	if (magnitude >= 4)
+	    return iterations;
+
+	/* Rebases the pixel onto the start of the reference orbit when z gets
+	   closer to 0 than to the reference (a glitch), or when the reference
+	   has run out. */
+	if (magnitude < dReal * dReal + dImag * dImag || m == orbit->length) {
+	    dReal = zReal;
+	    dImag = zImag;
+	    m     = 0;
+	}
+    }
+
+    return 0;
+}
+
+
+
+
+// Iterates each pixel of the span, a distance of step apart along the row.
+void escapeSpan_perturbation(const int          maxIterations,
+			     const calcSettings calc,
+			     const double       realStart,
+			     const double       step,
+			     const int          x,
+			     const double       imag,
+			     const int          count,
+			     int               *escapes)
+{
+    for (int i = 0; i < count; i++)
+	escapes[i] = perturbPoint(calc.reference, maxIterations,
+				  realStart + step * (x + i), imag);
+}
+
+
+
+
+// Iterates each of the points.
+void escapePoints_perturbation(const int          maxIterations,
+			       const calcSettings calc,
+			       const double      *real,
+			       const double      *imag,
+			       const int          count,
+			       int               *escapes)
+{
+    for (int i = 0; i < count; i++)
+	escapes[i] = perturbPoint(calc.reference, maxIterations, real[i],
+				  imag[i]);
+}
@@ -0,0 +1,86 @@
+/*
+ * Deep-zoom rendering by perturbation theory, part of an exercise program that
+ * draws mandelbrot sets.
+ *
+ * Past a zoom of about 10^13, neighbouring pixels are closer together than a
+ * double can tell apart. Rather than iterating every pixel with more digits,
+ * which is very slow, one reference orbit Z through the center of the image
+ * is worked out with as many digits as needed. Every pixel c = C + dc is then
+ * iterated as a small difference d from that orbit, z = Z + d, with
+ *
+ *     d' = (2Z + d)d + dc
+ *
+ * which only involves small numbers, and so works fine in doubles.
+ *
+ * This breaks down ("glitches") where the pixel's orbit passes much closer to
+ * 0 than its difference from the reference, as d loses all its precision
+ * there. Those pixels are rebased: the full value of z becomes the new
+ * difference, and the reference orbit starts over from Z = 0. The same is done
+ * when the pixel outlasts the reference orbit, though that loses precision, so
+ * the reference should be a point that lasts as long as possible.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef PERTURBATION_MODULE
+#define PERTURBATION_MODULE
+
+#include "mandelbrotRender.h"
+
+
+
+/*
+ * A reference orbit, rounded to doubles after being worked out in full.
+ *
+ * The orbit normally goes through the center of the image. If the center
+ * escapes early, a few other points of the image are tried, and the one that
+ * lasts longest is used instead; the offset says where it lies, relative to
+ * the center.
+ */
+typedef struct referenceOrbit {
+    int     length;     // Iterations until the reference escaped, or ran out.
+    double *real;       // Z_0 to Z_length.
+    double *imag;
+    double  offsetReal; // Where the reference point lies, from the center.
+    double  offsetImag;
+} referenceOrbit;
+
+
+
+/*
+ * Works out the reference orbit through the center of an image, with enough
+ * precision for its zoom level and width. Returns 1 if memory could not be
+ * allocated or the center could not be read, 0 otherwise.
+ */
+int  perturbationOrbit(referenceOrbit *orbit,
+		       const calcSettings calc,
+		       const drawSettings draw,
+		       const int          maxIterations);
+void perturbationFreeOrbit(referenceOrbit *orbit);
+
+/*
+ * Span kernel for deep zooms, to be used through escapeKernelSelect. The real
+ * and imaginary parts it is given are the distances from the center of the
+ * image, not points on the complex plane, and calc.reference must be set.
+ */
+void escapeSpan_perturbation(const int          maxIterations,
+			     const calcSettings calc,
+			     const double       realStart,
+			     const double       step,
+			     const int          x,
+			     const double       imag,
+			     const int          count,
+			     int               *escapes);
+
+// Points kernel for deep zooms. As above, the points are distances.
+void escapePoints_perturbation(const int          maxIterations,
+			       const calcSettings calc,
+			       const double      *real,
+			       const double      *imag,
+			       const int          count,
+			       int               *escapes);
+
+#endif // PERTURBATION_MODULE
@@ -0,0 +1,619 @@
+/*
+ * A very simple PNG encoder, part of an exercise program that draws mandelbrot
+ * sets.
+ *
+ * This module only contains things directly partaining to the PNG format, and
+ * the deflate compression it uses. How images are cut into segments is
+ * explained in 'png.h'.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "png.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The filters a row can be run through, numbered as the filter byte says.
+#define FILTER_NONE    0
+#define FILTER_SUB     1
+#define FILTER_UP      2
+#define FILTER_AVERAGE 3
+#define FILTER_PAETH   4
+
+/* Deflate matches are 3 to 258 bytes long, from up to 32 KiB back. Matches of
+   3 bytes from far back take more room than the bytes themselves. */
+#define MATCH_MIN   3
+#define MATCH_MAX   258
+#define WINDOW_SIZE 32768
+#define TOO_FAR     4096
+
+/* Places are found by a hash of the 3 bytes there. Only so many earlier places
+   with the same hash are tried for each match, which keeps it quick. */
+#define HASH_BITS   15
+#define CHAIN_TRIES 16
+
+/* The places inside a match are only noted down for later matches if it is
+   this short or shorter. Long matches are mostly runs of one byte, where any
+   place will do, as zlib's quicker levels also find. */
+#define INSERT_MAX 16
+
+// Adler-32 sums are kept modulo this, and can go this many bytes in between.
+#define ADLER_BASE  65521
+#define ADLER_BLOCK 5552
+
+
+
+
+/* Lengths and distances of deflate matches: the first of each code, and how
+   many extra bits follow it. */
+static const short lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+    67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const char lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5,
+    5, 5, 5, 0
+};
+static const short distanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+    769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const char distanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+    11, 11, 12, 12, 13, 13
+};
+
+// CRC-32 of every 4 bit value, for working out CRCs a nibble at a time.
+static const uint32_t crcTable[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+
+
+
+// Allocates room for the rows, filtered segment and hash tables.
+int pngWorkspaceAllocate(pngWorkspace *workspace, const int width,
+			 const int rows)
+{
+    workspace->packed   = malloc(2 * 3 * (size_t) width);
+    workspace->filtered = malloc(PNG_FILTERED_BYTES(width, rows));
+    workspace->head     = malloc((1 << HASH_BITS) * sizeof *workspace->head);
+    workspace->chain    = malloc(WINDOW_SIZE * sizeof *workspace->chain);
+
+    if (workspace->packed == NULL || workspace->filtered == NULL ||
+	workspace->head == NULL || workspace->chain == NULL) {
+	pngWorkspaceFree(workspace);
+	return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Frees the memory of a workspace.
+void pngWorkspaceFree(pngWorkspace *workspace)
+{
+    free(workspace->packed);
+    free(workspace->filtered);
+    free(workspace->head);
+    free(workspace->chain);
+    workspace->packed   = NULL;
+    workspace->filtered = NULL;
+    workspace->head     = NULL;
+    workspace->chain    = NULL;
+}
+
+
+
+
+// Stores a number in 4 bytes, big-endian, as PNG has everything.
+static void putLong(unsigned char *bytes, const uint32_t value)
+{
+    bytes[0] = value >> 24;
+    bytes[1] = value >> 16;
+    bytes[2] = value >> 8;
+    bytes[3] = value;
+}
+
+
+
+
+// Carries on a CRC-32 over more bytes. CRCs start and end inverted.
+static uint32_t crcUpdate(uint32_t crc, const unsigned char *data,
+			  const size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+	crc ^= data[i];
+	crc  = (crc >> 4) ^ crcTable[crc & 15];
+	crc  = (crc >> 4) ^ crcTable[crc & 15];
+    }
+
+    return crc;
+}
+
+
+
+
+/* Wraps up a chunk whose data has been put in after the first 8 bytes, by
+   filling in its length, type and CRC. Returns the size of the whole chunk. */
+static size_t finishChunk(unsigned char *chunk, const char type[4],
+			  const size_t length)
+{
+    putLong(chunk, length);
+    memcpy(chunk + 4, type, 4);
+    putLong(chunk + 8 + length,
+	    crcUpdate(0xffffffff, chunk + 4, length + 4) ^ 0xffffffff);
+
+    return length + 12;
+}
+
+
+
+
+// Works out the Adler-32 check of some bytes.
+static uint32_t adler32(const unsigned char *data, size_t length)
+{
+    uint32_t a = 1;
+    uint32_t b = 0;
+
+    // The sums can go a while before they need bringing back into range.
+    while (length > 0) {
+	const size_t count = (length < ADLER_BLOCK) ? length : ADLER_BLOCK;
+
+	for (size_t i = 0; i < count; i++) {
+	    a += data[i];
+	    b += a;
+	}
+
+	a      %= ADLER_BASE;
+	b      %= ADLER_BASE;
+	data   += count;
+	length -= count;
+    }
+
+    return b << 16 | a;
+}
+
+
+
+
+/* Works out the Adler-32 check of two runs of bytes, one after the other, from
+   the checks of each. The same as zlib's adler32_combine. */
+uint32_t pngAdlerCombine(const uint32_t first,
+			 const uint32_t second,
+			 const size_t   secondLength)
+{
+    const uint32_t remainder = secondLength % ADLER_BASE;
+    uint32_t       a         = first & 0xffff;
+    uint32_t       b         = (remainder * a) % ADLER_BASE;
+
+    a += (second & 0xffff) + ADLER_BASE - 1;
+    b += (first >> 16) + (second >> 16) + ADLER_BASE - remainder;
+
+    if (a >= ADLER_BASE)
+	a -= ADLER_BASE;
+    if (a >= ADLER_BASE)
+	a -= ADLER_BASE;
+    if (b >= 2 * ADLER_BASE)
+	b -= 2 * ADLER_BASE;
+    if (b >= ADLER_BASE)
+	b -= ADLER_BASE;
+
+    return b << 16 | a;
+}
+
+
+
+
+/* Writes out the PNG signature and header, and opens the deflate stream with
+   a chunk of its own. */
+void pngWriteHeader(const int width, const int height, FILE *imageFile)
+{
+    const unsigned char signature[8] = {
+	0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+    };
+    unsigned char chunk[12 + 13];
+
+    fwrite(signature, 1, sizeof signature, imageFile);
+
+    putLong(chunk + 8, width);
+    putLong(chunk + 12, height);
+    chunk[16] = 8; // Bits per channel.
+    chunk[17] = 2; // RGB.
+    chunk[18] = 0; // Deflate.
+    chunk[19] = 0; // Filtered row by row.
+    chunk[20] = 0; // Not interlaced.
+    fwrite(chunk, 1, finishChunk(chunk, "IHDR", 13), imageFile);
+
+    // A 32 KiB window, no dictionary, and a check that the two bytes add up.
+    chunk[8] = 0x78;
+    chunk[9] = 0x01;
+    fwrite(chunk, 1, finishChunk(chunk, "IDAT", 2), imageFile);
+}
+
+
+
+
+/* Closes the deflate stream with an empty final block and the Adler-32 check,
+   in a chunk of their own, and ends the file. */
+void pngWriteEnd(const uint32_t adler, FILE *imageFile)
+{
+    unsigned char chunk[12 + 6];
+
+    chunk[8] = 0x03;
+    chunk[9] = 0x00;
+    putLong(chunk + 10, adler);
+    fwrite(chunk, 1, finishChunk(chunk, "IDAT", 6), imageFile);
+    fwrite(chunk, 1, finishChunk(chunk, "IEND", 0), imageFile);
+}
+
+
+
+
+// The Paeth predictor: whichever of left, above or above-left is nearest.
+static inline int paeth(const int a, const int b, const int c)
+{
+    const int pa = abs(b - c);
+    const int pb = abs(a - c);
+    const int pc = abs(a + b - 2 * c);
+
+    if (pa <= pb && pa <= pc)
+	return a;
+    if (pb <= pc)
+	return b;
+
+    return c;
+}
+
+
+
+
+/* Runs a row of RGB bytes through one of the filters. Bytes left of the row
+   count as zero. Only the filters that do not look at it can go without the
+   row above. */
+static void applyFilter(const int            filter,
+			const unsigned char *row,
+			const unsigned char *above,
+			const size_t         length,
+			unsigned char       *out)
+{
+    switch (filter) {
+    case FILTER_SUB:
+	for (size_t i = 0; i < 3; i++)
+	    out[i] = row[i];
+	for (size_t i = 3; i < length; i++)
+	    out[i] = row[i] - row[i - 3];
+	break;
+
+    case FILTER_UP:
+	for (size_t i = 0; i < length; i++)
+	    out[i] = row[i] - above[i];
+	break;
+
+    case FILTER_AVERAGE:
+	for (size_t i = 0; i < 3; i++)
+	    out[i] = row[i] - above[i] / 2;
+	for (size_t i = 3; i < length; i++)
+	    out[i] = row[i] - (row[i - 3] + above[i]) / 2;
+	break;
+
+    case FILTER_PAETH:
+	for (size_t i = 0; i < 3; i++)
+	    out[i] = row[i] - above[i];
+	for (size_t i = 3; i < length; i++)
+	    out[i] = row[i] - paeth(row[i - 3], above[i], above[i - 3]);
+	break;
+
+    default:
+	memcpy(out, row, length);
+	break;
+    }
+}
+
+
+
+
+/*
+ * Filters a row of RGB bytes, putting the filter byte first. Every filter is
+ * tried, and the one whose bytes come out nearest to zero, counting them as
+ * signed, is kept; it is a rough guess at what deflate will squeeze best. The
+ * filters are all tried in a single pass along the row. With no row above (at
+ * the top of a segment), only the filters that do not look at it can be used.
+ */
+static void filterRow(const unsigned char *row,
+		      const unsigned char *above,
+		      const size_t         length,
+		      unsigned char       *filtered)
+{
+    long sum[FILTER_PAETH + 1] = {0, 0, 0, 0, 0};
+    int  best                  = FILTER_SUB;
+
+    // Adds a filtered byte to the sum of its filter.
+    void count(const int filter, const int value) {
+	sum[filter] += abs((signed char) value);
+    }
+
+    if (above == NULL) {
+	for (size_t i = 0; i < length; i++) {
+	    count(FILTER_NONE, row[i]);
+	    count(FILTER_SUB, row[i] - ((i >= 3) ? row[i - 3] : 0));
+	}
+
+	if (sum[FILTER_NONE] <= sum[FILTER_SUB])
+	    best = FILTER_NONE;
+
+    } else {
+	for (size_t i = 0; i < 3; i++) {
+	    count(FILTER_NONE, row[i]);
+	    count(FILTER_SUB, row[i]);
+	    count(FILTER_UP, row[i] - above[i]);
+	    count(FILTER_AVERAGE, row[i] - above[i] / 2);
+	    count(FILTER_PAETH, row[i] - above[i]);
+	}
+
+	for (size_t i = 3; i < length; i++) {
+	    const int a = row[i - 3];
+	    const int b = above[i];
+
+	    count(FILTER_NONE, row[i]);
+	    count(FILTER_SUB, row[i] - a);
+	    count(FILTER_UP, row[i] - b);
+	    count(FILTER_AVERAGE, row[i] - (a + b) / 2);
+	    count(FILTER_PAETH, row[i] - paeth(a, b, above[i - 3]));
+	}
+
+	best = FILTER_NONE;
+
+	for (int filter = FILTER_SUB; filter <= FILTER_PAETH; filter++) {
+	    if (sum[filter] < sum[best])
+		best = filter;
+	}
+    }
+
+    filtered[0] = best;
+    applyFilter(best, row, above, length, filtered + 1);
+}
+
+
+
+
+/* Deflate output, which is a stream of bits, filled from the lowest bit of
+   each byte up. */
+typedef struct {
+    unsigned char *bytes;
+    size_t         length;
+    uint64_t       bits;  // Bits not yet put in a byte.
+    int            count; // Number of them.
+} bitStream;
+
+
+
+
+// Adds bits to the stream, lowest first.
+static inline void putBits(bitStream *stream, const uint32_t bits,
+			   const int count)
+{
+    stream->bits  |= (uint64_t) bits << stream->count;
+    stream->count += count;
+
+    while (stream->count >= 8) {
+	stream->bytes[stream->length++] = stream->bits;
+	stream->bits  >>= 8;
+	stream->count  -= 8;
+    }
+}
+
+
+
+
+/* Adds a Huffman code to the stream. Codes go highest bit first, unlike
+   everything else, so the code is turned around. */
+static inline void putCode(bitStream *stream, uint32_t code, const int count)
+{
+    code = (code & 0x5555) << 1 | (code >> 1 & 0x5555);
+    code = (code & 0x3333) << 2 | (code >> 2 & 0x3333);
+    code = (code & 0x0f0f) << 4 | (code >> 4 & 0x0f0f);
+    code = (code & 0x00ff) << 8 | (code >> 8 & 0x00ff);
+
+    putBits(stream, code >> (16 - count), count);
+}
+
+
+
+
+// Adds a literal byte, a length, or the end of a block, with the fixed codes.
+static inline void putSymbol(bitStream *stream, const int symbol)
+{
+    if (symbol < 144)
+	putCode(stream, 0x30 + symbol, 8);
+    else if (symbol < 256)
+	putCode(stream, 0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+	putCode(stream, symbol - 256, 7);
+    else
+	putCode(stream, 0xc0 + symbol - 280, 8);
+}
+
+
+
+
+// Adds a match, of a length and a distance back.
+static void putMatch(bitStream *stream, const int length, const int distance)
+{
+    int code = 28;
+
+    while (lengthBase[code] > length)
+	code--;
+
+    putSymbol(stream, 257 + code);
+    putBits(stream, length - lengthBase[code], lengthExtra[code]);
+
+    code = 29;
+
+    while (distanceBase[code] > distance)
+	code--;
+
+    putCode(stream, code, 5);
+    putBits(stream, distance - distanceBase[code], distanceExtra[code]);
+}
+
+
+
+
+// Hash of the 3 bytes at a place.
+static inline int hashAt(const unsigned char *data)
+{
+    const uint32_t key = data[0] << 16 | data[1] << 8 | data[2];
+
+    return (key * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+
+
+/*
+ * Deflates some bytes into a single block with the fixed codes, followed by an
+ * empty uncompressed block, which brings the stream back to a whole byte so
+ * that whatever comes next can simply be put after it. Matches are found
+ * greedily: at each place, the longest match among the last few places with
+ * the same hash is taken, if there is one.
+ */
+static size_t deflateBytes(const unsigned char *data,
+			   const int            length,
+			   pngWorkspace        *workspace,
+			   unsigned char       *bytes)
+{
+    int       *head   = workspace->head;
+    int       *chain  = workspace->chain;
+    bitStream  stream = {bytes, 0, 0, 0};
+
+    for (int i = 0; i < 1 << HASH_BITS; i++)
+	head[i] = -1;
+
+    // Notes down a place, so that later matches can find it.
+    int insert(const int at) {
+	const int hash     = hashAt(data + at);
+	const int previous = head[hash];
+
+	chain[at % WINDOW_SIZE] = previous;
+	head[hash]              = at;
+
+	return previous;
+    }
+
+    // Not the last block, and coded with the fixed codes.
+    putBits(&stream, 0, 1);
+    putBits(&stream, 1, 2);
+
+    int at = 0;
+
+    while (at < length) {
+	const int limit    = (length - at < MATCH_MAX) ? length - at : MATCH_MAX;
+	int       best     = 0;
+	int       distance = 0;
+
+	if (limit >= MATCH_MIN) {
+	    int candidate = insert(at);
+
+	    for (int tries = 0; tries < CHAIN_TRIES && candidate >= 0 &&
+		     at - candidate < WINDOW_SIZE; tries++) {
+		// Anything no longer than the best so far is skipped quickly.
+		if (data[candidate + best] == data[at + best]) {
+		    int matched = 0;
+
+		    while (matched < limit &&
+			   data[candidate + matched] == data[at + matched])
+			matched++;
+
+		    if (matched > best) {
+			best     = matched;
+			distance = at - candidate;
+
+			if (best == limit)
+			    break;
+		    }
+		}
+
+		candidate = chain[candidate % WINDOW_SIZE];
+	    }
+	}
+
+	if (best > MATCH_MIN || (best == MATCH_MIN && distance <= TOO_FAR)) {
+	    putMatch(&stream, best, distance);
+
+	    for (int i = 1; i < best && best <= INSERT_MAX; i++) {
+		if (at + i + MATCH_MIN <= length)
+		    insert(at + i);
+	    }
+
+	    at += best;
+	} else {
+	    putSymbol(&stream, data[at]);
+	    at++;
+	}
+    }
+
+    putSymbol(&stream, 256);
+
+    // An empty uncompressed block: its header, then a length of 0 and its not.
+    putBits(&stream, 0, 3);
+
+    if (stream.count > 0)
+	putBits(&stream, 0, 8 - stream.count);
+
+    putBits(&stream, 0x0000, 16);
+    putBits(&stream, 0xffff, 16);
+
+    return stream.length;
+}
+
+
+
+
+/* Encodes a segment of rows. Each row is packed into RGB bytes and filtered,
+   against the row above it if that is in the segment too, then the filtered
+   rows are deflated all together into an image data chunk. */
+size_t pngPackSegment(const tRGB    *pixels,
+		      const int      width,
+		      const int      rows,
+		      pngWorkspace  *workspace,
+		      unsigned char *bytes,
+		      uint32_t      *adler)
+{
+    const size_t   rowBytes = 3 * (size_t) width;
+    unsigned char *filtered = workspace->filtered;
+
+    for (int y = 0; y < rows; y++) {
+	// The two packed rows take turns being the one above.
+	unsigned char *row   = workspace->packed + (y % 2) * rowBytes;
+	unsigned char *above = workspace->packed + ((y + 1) % 2) * rowBytes;
+
+	for (int x = 0; x < width; x++) {
+	    const tRGB pixel = pixels[(size_t) y * width + x];
+
+	    row[3 * x]     = pixel.r;
+	    row[3 * x + 1] = pixel.g;
+	    row[3 * x + 2] = pixel.b;
+	}
+
+	filterRow(row, (y > 0) ? above : NULL, rowBytes,
+		  filtered + (size_t) y * (1 + rowBytes));
+    }
+
+    const size_t length = PNG_FILTERED_BYTES(width, rows);
+
+    *adler = adler32(filtered, length);
+
+    return finishChunk(bytes, "IDAT",
+		       deflateBytes(filtered, (int) length, workspace,
+				    bytes + 8));
+}
@@ -0,0 +1,86 @@
+/*
+ * A very simple PNG encoder, part of an exercise program that draws mandelbrot
+ * sets.
+ *
+ * PNG runs every row through a filter, which turns it into differences from
+ * its neighbours, then squeezes the lot with deflate, the compression zip
+ * uses. The rows of a Mandelbrot set are mostly long bands of one color, so
+ * the differences are mostly zeroes, and deflate packs them down to almost
+ * nothing. The deflate here is a plain one, with the fixed codes deflate has
+ * built in, so nothing needs to be linked in for it.
+ *
+ * The image can be cut into segments of whole rows, each of which is filtered
+ * and deflated on its own, into a chunk of the file of its own. The first row
+ * of a segment is only filtered against itself, and matches never reach back
+ * into the segment before, so the segments can be encoded by different
+ * threads, and simply written one after another. The check on the whole
+ * stream of rows is pieced together from the checks of the segments.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef PNG_MODULE
+#define PNG_MODULE
+
+#include <stdio.h>
+#include <stdint.h>
+#include "targa.h"
+
+
+
+// Bytes a segment of rows takes once filtered: a filter byte and 3 per pixel.
+#define PNG_FILTERED_BYTES(width, rows) \
+    ((1 + 3 * (size_t) (width)) * (size_t) (rows))
+
+/* Most bytes a segment of rows can take. Deflate can make data a little bigger
+   than it was, and the chunk around it takes a few more. */
+#define PNG_SEGMENT_BYTES(width, rows) \
+    (PNG_FILTERED_BYTES(width, rows) + PNG_FILTERED_BYTES(width, rows) / 2 + \
+     64)
+
+
+
+/* Scratch space for encoding segments of up to a given number of rows. Each
+   thread needs its own. */
+typedef struct {
+    unsigned char *packed;   // The row being filtered and the one above it.
+    unsigned char *filtered; // Filtered rows of the segment.
+    int           *head;     // Deflate: last place each hash was seen.
+    int           *chain;    // Deflate: place before that, for each place.
+} pngWorkspace;
+
+
+
+// Tools for creating a workspace. Allocation returns 1 on failure.
+int  pngWorkspaceAllocate(pngWorkspace *workspace, const int width,
+			  const int rows);
+void pngWorkspaceFree(pngWorkspace *workspace);
+
+/*
+ * Tools for writing a 24 bit PNG image, before and after its segments. The
+ * end needs the Adler-32 check of every filtered row in the image, which
+ * pngAdlerCombine can put together from the checks of the segments.
+ */
+void     pngWriteHeader(const int width, const int height, FILE *imageFile);
+void     pngWriteEnd(const uint32_t adler, FILE *imageFile);
+uint32_t pngAdlerCombine(const uint32_t first,
+			 const uint32_t second,
+			 const size_t   secondLength);
+
+/*
+ * Encodes a segment of rows, width pixels wide, into a chunk of the file,
+ * returning the number of bytes it took, which is never more than
+ * PNG_SEGMENT_BYTES(width, rows). The Adler-32 check of its filtered rows,
+ * PNG_FILTERED_BYTES(width, rows) of them, is put in adler.
+ */
+size_t pngPackSegment(const tRGB    *pixels,
+		      const int      width,
+		      const int      rows,
+		      pngWorkspace  *workspace,
+		      unsigned char *bytes,
+		      uint32_t      *adler);
+
+#endif // PNG_MODULE
@@ -0,0 +1,166 @@
+/*
+ * A very simple QOI ("Quite OK Image") encoder, part of an exercise program
+ * that draws mandelbrot sets.
+ *
+ * This module only contains things directly partaining to the QOI format. How
+ * images are cut into segments is explained in 'qoi.h'.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "qoi.h"
+
+#include <string.h>
+
+// Size of the header, and of the marker that ends the file.
+#define HEADER_SIZE 14
+#define END_SIZE    8
+
+// The first byte of each kind of op, and the top two bits that mark them.
+#define OP_INDEX 0x00
+#define OP_DIFF  0x40
+#define OP_LUMA  0x80
+#define OP_RUN   0xc0
+#define OP_RGB   0xfe
+
+// Longest run a single op can hold, and the size of the table of colors.
+#define RUN_MAX    62
+#define INDEX_SIZE 64
+
+
+
+
+// Writes out a QOI header for a 24 bit RGB image, in the sRGB color space.
+void qoiWriteHeader(const int width, const int height, FILE *imageFile)
+{
+    unsigned char header[HEADER_SIZE];
+
+    memcpy(header, "qoif", 4);
+
+    // The width and height are big-endian.
+    for (int i = 0; i < 4; i++) {
+	header[4 + i] = (unsigned long) width >> (24 - 8 * i);
+	header[8 + i] = (unsigned long) height >> (24 - 8 * i);
+    }
+
+    header[12] = 3; // Channels, RGB.
+    header[13] = 0; // sRGB, with linear alpha.
+
+    fwrite(header, 1, sizeof header, imageFile);
+}
+
+
+
+
+// Writes out the marker that ends a QOI image, seven zeroes and a one.
+void qoiWriteEnd(FILE *imageFile)
+{
+    const unsigned char end[END_SIZE] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+    fwrite(end, 1, sizeof end, imageFile);
+}
+
+
+
+
+// Slot of the table of recent colors that a color goes in. Alpha is always 255.
+static inline int colorHash(const tRGB pixel)
+{
+    return (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + 255 * 11) % INDEX_SIZE;
+}
+
+
+
+
+/*
+ * Encodes a segment of rows. The reader's table of recent colors holds
+ * whatever the segments before this one left in it, so only the slots this
+ * segment has filled in itself are ever referred to; the reader fills in the
+ * same slots with the same colors along the way, whatever was there before.
+ */
+size_t qoiPackSegment(const tRGB    *pixels,
+		      const int      width,
+		      const int      rows,
+		      unsigned char *bytes)
+{
+    const size_t  count = (size_t) width * rows;
+    tRGB          index[INDEX_SIZE];
+    unsigned char known[INDEX_SIZE];
+    size_t        length = 0;
+    int           run    = 0;
+
+    memset(known, 0, sizeof known);
+
+    // The first pixel always goes in full, as the one before it is unknown.
+    tRGB previous = pixels[0];
+
+    bytes[length++] = OP_RGB;
+    bytes[length++] = previous.r;
+    bytes[length++] = previous.g;
+    bytes[length++] = previous.b;
+    index[colorHash(previous)] = previous;
+    known[colorHash(previous)] = 1;
+
+    for (size_t i = 1; i < count; i++) {
+	const tRGB pixel = pixels[i];
+
+	if (pixel.r == previous.r && pixel.g == previous.g &&
+	    pixel.b == previous.b) {
+	    if (++run == RUN_MAX) {
+		bytes[length++] = OP_RUN | (run - 1);
+		run = 0;
+	    }
+	    continue;
+	}
+
+	if (run > 0) {
+	    bytes[length++] = OP_RUN | (run - 1);
+	    run = 0;
+	}
+
+	const int slot = colorHash(pixel);
+
+	if (known[slot] && index[slot].r == pixel.r &&
+	    index[slot].g == pixel.g && index[slot].b == pixel.b) {
+	    bytes[length++] = OP_INDEX | slot;
+
+	} else {
+	    // Differences wrap around, as the reader adds them modulo 256.
+	    const signed char dr = pixel.r - previous.r;
+	    const signed char dg = pixel.g - previous.g;
+	    const signed char db = pixel.b - previous.b;
+	    const signed char rg = dr - dg;
+	    const signed char bg = db - dg;
+
+	    index[slot] = pixel;
+	    known[slot] = 1;
+
+	    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+		db <= 1) {
+		bytes[length++] = OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 |
+		    (db + 2);
+
+	    } else if (dg >= -32 && dg <= 31 && rg >= -8 && rg <= 7 &&
+		       bg >= -8 && bg <= 7) {
+		bytes[length++] = OP_LUMA | (dg + 32);
+		bytes[length++] = (rg + 8) << 4 | (bg + 8);
+
+	    } else {
+		bytes[length++] = OP_RGB;
+		bytes[length++] = pixel.r;
+		bytes[length++] = pixel.g;
+		bytes[length++] = pixel.b;
+	    }
+	}
+
+	previous = pixel;
+    }
+
+    if (run > 0)
+	bytes[length++] = OP_RUN | (run - 1);
+
+    return length;
+}
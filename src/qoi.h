@@ -0,0 +1,47 @@
+/*
+ * A very simple QOI ("Quite OK Image") encoder, part of an exercise program
+ * that draws mandelbrot sets.
+ *
+ * QOI squeezes an image down about as well as a quick PNG, at a fraction of
+ * the work. Each pixel is stored as a run of the one before it, an index into
+ * a small table of recently seen colors, a small difference from the one
+ * before it, or, failing all of those, in full.
+ *
+ * The image can be cut into segments of whole rows, which are encoded on their
+ * own, and simply written one after another. Each segment starts with its
+ * first pixel in full, and only refers back to the colors it has seen itself,
+ * so it does not matter what came before it. That costs a few bytes per
+ * segment, and lets the segments be encoded by different threads.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef QOI_MODULE
+#define QOI_MODULE
+
+#include <stdio.h>
+#include "targa.h"
+
+
+
+/* Most bytes a segment of rows can take: 4 per pixel, if every pixel has to be
+   stored in full. */
+#define QOI_SEGMENT_BYTES(width, rows) (4 * (size_t) (width) * (size_t) (rows))
+
+
+
+// Tools for writing a 24 bit QOI image, before and after its segments.
+void qoiWriteHeader(const int width, const int height, FILE *imageFile);
+void qoiWriteEnd(FILE *imageFile);
+
+/* Encodes a segment of rows, width pixels wide, returning the number of bytes
+   it took, which is never more than QOI_SEGMENT_BYTES(width, rows). */
+size_t qoiPackSegment(const tRGB    *pixels,
+		      const int      width,
+		      const int      rows,
+		      unsigned char *bytes);
+
+#endif // QOI_MODULE
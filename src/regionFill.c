@@ -0,0 +1,382 @@
+/*
+ * Solid-region filling, part of an exercise program that draws mandelbrot sets.
+ *
+ * This module only decides which pixels need working out, and fills in the
+ * rest. The working out itself is handed back to the renderer. How the two
+ * fill modes work is explained in 'regionFill.h'.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "regionFill.h"
+
+#include <stdlib.h>
+
+/* Rectangles with no more than this many pixels inside their border are just
+   worked out, as cutting them up further saves less than it costs. */
+#define SUBDIVIDE_MIN_AREA 16
+
+// States of a pixel during boundary tracing.
+#define PIXEL_UNKNOWN 0
+#define PIXEL_PENDING 1 // Waiting in the batch to be worked out.
+#define PIXEL_KNOWN   2
+
+
+
+
+// Allocates room for the escape times, batch, state and queue of a tile.
+int regionWorkspaceAllocate(regionWorkspace *workspace, const int tileSize)
+{
+    const size_t pixels = (size_t) tileSize * tileSize;
+
+    workspace->tileSize = tileSize;
+    workspace->escapes  = malloc(pixels * sizeof *workspace->escapes);
+    workspace->batchX   = malloc(pixels * sizeof *workspace->batchX);
+    workspace->batchY   = malloc(pixels * sizeof *workspace->batchY);
+    workspace->batchAt  = malloc(pixels * sizeof *workspace->batchAt);
+    workspace->results  = malloc(pixels * sizeof *workspace->results);
+    workspace->state    = malloc(pixels * sizeof *workspace->state);
+    workspace->queue    = malloc(pixels * sizeof *workspace->queue);
+
+    if (workspace->escapes == NULL || workspace->batchX == NULL ||
+	workspace->batchY == NULL || workspace->batchAt == NULL ||
+	workspace->results == NULL || workspace->state == NULL ||
+	workspace->queue == NULL) {
+	regionWorkspaceFree(workspace);
+	return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+// Frees the memory of a workspace.
+void regionWorkspaceFree(regionWorkspace *workspace)
+{
+    free(workspace->escapes);
+    free(workspace->batchX);
+    free(workspace->batchY);
+    free(workspace->batchAt);
+    free(workspace->results);
+    free(workspace->state);
+    free(workspace->queue);
+    workspace->escapes = NULL;
+    workspace->batchX  = NULL;
+    workspace->batchY  = NULL;
+    workspace->batchAt = NULL;
+    workspace->results = NULL;
+    workspace->state   = NULL;
+    workspace->queue   = NULL;
+}
+
+
+
+
+/* Everything the fill routines pass around while working on a tile. Pixels are
+   numbered row by row, from the top-left of the tile. */
+typedef struct {
+    const tTile         *tile;
+    regionPixelFunction  compute;
+    const void          *context;
+    regionWorkspace     *workspace;
+    int                 *escapes;
+    int                  batchCount; // Pixels in the batch so far.
+    long                 iterated;   // Pixels worked out so far.
+} fillJob;
+
+
+
+
+// Adds a pixel of the tile to the batch waiting to be worked out.
+static void batchAdd(fillJob *job, const int x, const int y)
+{
+    regionWorkspace *workspace = job->workspace;
+    const int        i         = job->batchCount++;
+
+    workspace->batchX[i]  = job->tile->x + x;
+    workspace->batchY[i]  = job->tile->y + y;
+    workspace->batchAt[i] = y * job->tile->width + x;
+}
+
+
+
+
+// Works out the whole batch, and puts the escape times in their places.
+static void batchRun(fillJob *job)
+{
+    regionWorkspace *workspace = job->workspace;
+
+    if (job->batchCount == 0)
+	return;
+
+    job->compute(job->context, workspace->batchX, workspace->batchY,
+		 job->batchCount, workspace->results);
+
+    for (int i = 0; i < job->batchCount; i++)
+	job->escapes[workspace->batchAt[i]] = workspace->results[i];
+
+    job->iterated   += job->batchCount;
+    job->batchCount  = 0;
+}
+
+
+
+
+// Works out a span of a row of the tile. x and y are within the tile.
+static void computeRow(fillJob *job, const int x, const int y, const int count)
+{
+    for (int i = 0; i < count; i++)
+	batchAdd(job, x + i, y);
+
+    batchRun(job);
+}
+
+
+
+
+// Works out a span of a column of the tile, all in one batch.
+static void computeColumn(fillJob *job, const int x, const int y,
+			  const int count)
+{
+    for (int i = 0; i < count; i++)
+	batchAdd(job, x, y + i);
+
+    batchRun(job);
+}
+
+
+
+
+// Works out the outermost pixels of the tile, all in one batch.
+static void computeBorder(fillJob *job)
+{
+    const int width  = job->tile->width;
+    const int height = job->tile->height;
+
+    for (int y = 0; y < height; y++) {
+	for (int x = 0; x < width; x++) {
+	    if (y == 0 || y == height - 1 || x == 0 || x == width - 1)
+		batchAdd(job, x, y);
+	}
+    }
+
+    batchRun(job);
+}
+
+
+
+
+/*
+ * Fills in the inside of a rectangle of the tile, whose border has already
+ * been worked out. If the border is all one escape time, so is the inside.
+ * Otherwise the rectangle is cut in two along its longer side; working out the
+ * cut gives both halves a finished border, and each is tried again.
+ */
+static void subdivide(fillJob *job, const int x, const int y, const int width,
+		      const int height)
+{
+    const int stride = job->tile->width;
+    int      *e      = job->escapes;
+
+    // A rectangle this thin is all border.
+    if (width <= 2 || height <= 2)
+	return;
+
+    // Checks whether the whole border has the same escape time.
+    const int value   = e[y * stride + x];
+    int       uniform = 1;
+
+    for (int i = x; i < x + width && uniform; i++)
+	uniform = e[y * stride + i] == value &&
+	    e[(y + height - 1) * stride + i] == value;
+
+    for (int j = y + 1; j < y + height - 1 && uniform; j++)
+	uniform = e[j * stride + x] == value &&
+	    e[j * stride + x + width - 1] == value;
+
+    if (uniform) {
+	for (int j = y + 1; j < y + height - 1; j++)
+	    for (int i = x + 1; i < x + width - 1; i++)
+		e[j * stride + i] = value;
+
+	return;
+    }
+
+    // Small rectangles are cheaper to just work out, in one batch.
+    if ((width - 2) * (height - 2) <= SUBDIVIDE_MIN_AREA) {
+	for (int j = y + 1; j < y + height - 1; j++)
+	    for (int i = x + 1; i < x + width - 1; i++)
+		batchAdd(job, i, j);
+
+	batchRun(job);
+	return;
+    }
+
+    if (width >= height) {
+	const int middle = x + width / 2;
+
+	computeColumn(job, middle, y + 1, height - 2);
+	subdivide(job, x, y, middle - x + 1, height);
+	subdivide(job, middle, y, x + width - middle, height);
+    } else {
+	const int middle = y + height / 2;
+
+	computeRow(job, x + 1, middle, width - 2);
+	subdivide(job, x, y, width, middle - y + 1);
+	subdivide(job, x, middle, width, y + height - middle);
+    }
+}
+
+
+
+
+/*
+ * Boundary tracing. Every known pixel is queued up to be looked around. When a
+ * pixel has a known neighbour with a different escape time, the two lie on an
+ * edge, so every unknown neighbour of either is worked out and queued in turn.
+ * This follows each edge until it closes, and never touches the insides of the
+ * regions, which are then filled in from the left once the queue runs dry.
+ *
+ * The queue is gone through in waves: every pixel a wave turns up is put in
+ * one batch, and worked out before the next wave starts.
+ */
+static void trace(fillJob *job)
+{
+    const int      width  = job->tile->width;
+    const int      height = job->tile->height;
+    int           *e      = job->escapes;
+    unsigned char *state  = job->workspace->state;
+    int           *queue  = job->workspace->queue;
+    int            head   = 0;
+    int            tail   = 0;
+
+    for (int i = 0; i < width * height; i++)
+	state[i] = PIXEL_UNKNOWN;
+
+    // The border is worked out first, and all of it is queued.
+    computeBorder(job);
+
+    for (int y = 0; y < height; y++) {
+	for (int x = 0; x < width; x++) {
+	    if (y == 0 || y == height - 1 || x == 0 || x == width - 1) {
+		state[y * width + x] = PIXEL_KNOWN;
+		queue[tail++]        = y * width + x;
+	    }
+	}
+    }
+
+    // Puts an unknown pixel in the batch, to be worked out with the wave.
+    void learn(const int pixel) {
+	if (state[pixel] != PIXEL_UNKNOWN)
+	    return;
+
+	batchAdd(job, pixel % width, pixel / width);
+	state[pixel] = PIXEL_PENDING;
+    }
+
+    // Learns the neighbours of a pixel, within the tile.
+    void learnAround(const int pixel) {
+	const int x = pixel % width;
+	const int y = pixel / width;
+
+	if (x > 0)
+	    learn(pixel - 1);
+	if (x < width - 1)
+	    learn(pixel + 1);
+	if (y > 0)
+	    learn(pixel - width);
+	if (y < height - 1)
+	    learn(pixel + width);
+    }
+
+    // Compares a pixel to one of its neighbours, learning around any edge.
+    void compare(const int pixel, const int neighbour) {
+	if (state[neighbour] == PIXEL_KNOWN && e[neighbour] != e[pixel]) {
+	    learnAround(pixel);
+	    learnAround(neighbour);
+	}
+    }
+
+    // Each pixel is queued once at most, so the queue never wraps.
+    while (head < tail) {
+	const int waveEnd = tail;
+
+	for (; head < waveEnd; head++) {
+	    const int pixel = queue[head];
+	    const int x     = pixel % width;
+	    const int y     = pixel / width;
+
+	    if (x > 0)
+		compare(pixel, pixel - 1);
+	    if (x < width - 1)
+		compare(pixel, pixel + 1);
+	    if (y > 0)
+		compare(pixel, pixel - width);
+	    if (y < height - 1)
+		compare(pixel, pixel + width);
+	}
+
+	// Works out the wave's batch, and queues it to be looked around.
+	const int *batchAt    = job->workspace->batchAt;
+	const int  batchCount = job->batchCount;
+
+	batchRun(job);
+
+	for (int i = 0; i < batchCount; i++) {
+	    state[batchAt[i]] = PIXEL_KNOWN;
+	    queue[tail++]     = batchAt[i];
+	}
+    }
+
+    // The left-most column is known, so every gap has a pixel to its left.
+    for (int y = 1; y < height - 1; y++) {
+	for (int x = 1; x < width - 1; x++) {
+	    if (state[y * width + x] == PIXEL_UNKNOWN)
+		e[y * width + x] = e[y * width + x - 1];
+	}
+    }
+}
+
+
+
+
+// Fills a tile with the chosen mode.
+long regionFill(const fillMode       mode,
+		const tTile         *tile,
+		regionPixelFunction  compute,
+		const void          *context,
+		regionWorkspace     *workspace)
+{
+    fillJob job;
+    job.tile       = tile;
+    job.compute    = compute;
+    job.context    = context;
+    job.workspace  = workspace;
+    job.escapes    = workspace->escapes;
+    job.batchCount = 0;
+    job.iterated   = 0;
+
+    switch (mode) {
+    case FILL_SUBDIVIDE:
+	computeBorder(&job);
+	subdivide(&job, 0, 0, tile->width, tile->height);
+	break;
+
+    case FILL_TRACE:
+	trace(&job);
+	break;
+
+    case FILL_NONE:
+	// Works the whole tile out, row by row.
+	for (int y = 0; y < tile->height; y++)
+	    computeRow(&job, 0, y, tile->width);
+	break;
+    }
+
+    return job.iterated;
+}
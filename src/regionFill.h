@@ -0,0 +1,80 @@
+/*
+ * Solid-region filling, part of an exercise program that draws mandelbrot sets.
+ *
+ * Large parts of an image share one escape time: the inside of the set, and
+ * the wide bands around it when zoomed out. Since the Mandelbrot set (and every
+ * band of escape times around it) is connected, a region whose whole outline
+ * has one escape time has that same escape time all the way through. These
+ * routines use that to skip iterating most of such regions.
+ *
+ *   Subdivision (Mariani-Silver) works out the border of a rectangle. If it is
+ *   all one escape time, the inside is filled in; otherwise the rectangle is
+ *   cut in two, and each half is tried the same way.
+ *
+ *   Boundary tracing works out the border of a rectangle, then follows every
+ *   edge between two escape times inwards, working out only the pixels along
+ *   the edges. Whatever is left is filled in from its neighbours.
+ *
+ * Both work on one tile at a time, so tiles can be shared out between threads.
+ * Features thinner than a pixel can slip between the pixels that do get
+ * worked out, so the image can differ slightly from a full render.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef REGION_FILL_MODULE
+#define REGION_FILL_MODULE
+
+#include "mandelbrotRender.h"
+#include "tileScheduler.h"
+
+
+
+/*
+ * Works out the escape times of a list of pixels of the image, the i-th one
+ * being at (x[i], y[i]). The context is whatever the caller needs for that,
+ * passed along untouched. Pixels are handed over in batches, as many at a time
+ * as the fill mode can manage, so they can be worked out with vector kernels.
+ */
+typedef void (*regionPixelFunction)(const void *context,
+				    const int  *x,
+				    const int  *y,
+				    const int   count,
+				    int        *escapes);
+
+
+
+/* Scratch space for filling tiles, big enough for a tile of the given size.
+   Each thread needs its own. */
+typedef struct {
+    int           *escapes; // Escape times of the tile, row by row.
+    int           *batchX;  // Pixels waiting to be worked out, and where
+    int           *batchY;  // their escape times go in the tile.
+    int           *batchAt;
+    int           *results; // Escape times of the batch.
+    unsigned char *state;   // Boundary tracing: which pixels are known.
+    int           *queue;   // Boundary tracing: pixels left to look around.
+    int            tileSize;
+} regionWorkspace;
+
+
+
+// Tools for creating a workspace. Allocation returns 1 on failure.
+int  regionWorkspaceAllocate(regionWorkspace *workspace, const int tileSize);
+void regionWorkspaceFree(regionWorkspace *workspace);
+
+/*
+ * Works out the escape times of a tile with one of the fill modes, leaving
+ * them in workspace->escapes with a stride of tile->width. Returns the number
+ * of pixels that were actually iterated.
+ */
+long regionFill(const fillMode       mode,
+		const tTile         *tile,
+		regionPixelFunction  compute,
+		const void          *context,
+		regionWorkspace     *workspace);
+
+#endif // REGION_FILL_MODULE
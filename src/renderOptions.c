@@ -0,0 +1,334 @@
+/*
+ * Options for a single image, read from a line of text, part of an exercise
+ * program that draws mandelbrot sets.
+ *
+ * This module only reads the options. Drawing the image, and anything to do
+ * with files or sockets, is left to whoever asked.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+
+// Resetting getopt is not part of ISO C.
+#define _DEFAULT_SOURCE
+
+#include "renderOptions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "escapeKernel.h"
+#include "targa.h"
+
+
+
+
+/*
+ * Sets up the default render settings, which may be modified by the options.
+ *
+ * The two main draw settings, offset and zoomlevel, are set to show the whole
+ * mandelbrot set by default. The other draw setting, threadCount, is by
+ * default 1, as most computers have at least 1 thread nowadays.
+ *
+ * For the color settings, I've defaulted it to something fairly light on
+ * processing power that will produce a fairly decent looking image.
+ */
+renderSettings renderOptionsDefaults(void)
+{
+    renderSettings renderInput;
+
+    renderInput.draw.width              = 0; // Given last, so that a missing
+    renderInput.draw.height             = 0; // size is caught as 0.
+    renderInput.draw.offset.real        = 0;
+    renderInput.draw.offset.imag        = 0;
+    renderInput.draw.zoomLevel          = 1;
+    renderInput.draw.threadCount        = 1;
+    renderInput.draw.fill               = FILL_NONE;
+    renderInput.draw.passes             = 1;
+    renderInput.draw.samples            = 1;
+    renderInput.color.maxIterations     = 360;
+    renderInput.color.constantLight     = 0.5;
+    renderInput.color.hueOffset         = 0;
+    renderInput.color.hueLimiter        = 1;
+    renderInput.color.lightMax          = 1;
+    renderInput.color.lightDistribution = 4;
+    renderInput.calc.fractal            = FRACTAL_MANDELBROT;
+    renderInput.calc.power              = 2;
+    renderInput.calc.juliaConstant.real = -0.8;  // Needs cli options for the
+    renderInput.calc.juliaConstant.imag = 0.156; // Julia set's constant.
+    renderInput.calc.kernel             = KERNEL_AUTO;
+    renderInput.calc.interiorChecks     = INTERIOR_ALL;
+    renderInput.calc.deepZoom           = 0;
+    renderInput.calc.deepReal           = "0"; // Copies of -x and -y, with
+    renderInput.calc.deepImag           = "0"; // every digit kept.
+    renderInput.calc.smooth             = 0;
+    renderInput.calc.reference          = NULL;
+    renderInput.imageFile               = NULL;
+    renderInput.format                  = IMAGE_TGA;
+    renderInput.escapeFile              = NULL;
+    renderInput.stats                   = NULL;
+    renderInput.passDone                = NULL;
+    renderInput.passContext             = NULL;
+    renderInput.pool                    = NULL;
+
+    return renderInput;
+}
+
+
+
+
+/* Looks a name up in a list of them, giving its place, or -1 if it is not
+   there. The list ends with NULL. */
+static int findName(const char *name, const char *const *names)
+{
+    for (int i = 0; names[i] != NULL; i++)
+	if (strcmp(name, names[i]) == 0)
+	    return i;
+
+    return -1;
+}
+
+
+
+
+// Finds a file name's extension, or NULL. Dots in directories don't count.
+const char *renderOptionsExtension(const char *name)
+{
+    const char *extension = strrchr(name, '.');
+
+    if (extension != NULL && strchr(extension, '/') != NULL)
+	return NULL;
+
+    return extension;
+}
+
+
+
+
+/* Picks the format that goes with the extension of a file name. A name with
+   no extension keeps the format it has. TIFF is only known when there is a
+   tiffFlag to set, as it is not an imageFormat. */
+int renderOptionsFormat(const char  *name,
+			imageFormat *format,
+			int         *tiffFlag)
+{
+    const char *extension = renderOptionsExtension(name);
+
+    if (tiffFlag != NULL)
+	*tiffFlag = 0;
+
+    if (extension == NULL)
+	return 0;
+
+    if (strcmp(extension, ".tga") == 0)
+	*format = IMAGE_TGA;
+    else if (strcmp(extension, ".qoi") == 0)
+	*format = IMAGE_QOI;
+    else if (strcmp(extension, ".png") == 0)
+	*format = IMAGE_PNG;
+    else if (tiffFlag != NULL && (strcmp(extension, ".tif") == 0 ||
+				  strcmp(extension, ".tiff") == 0))
+	*tiffFlag = 1;
+    else
+	return 1;
+
+    return 0;
+}
+
+
+
+
+/* Reads the options the way mandelbrot does, then the size, then checks the
+   lot against the same limits. The names in each list are in the order of the
+   values they stand for. */
+int renderOptionsParse(char            *line,
+		       renderSettings  *renderInput,
+		       const char     **outputPath,
+		       char            *error,
+		       const size_t     errorSize)
+{
+    static const char *const kernelNames[] = {
+	"auto", "scalar", "sse2", "avx2", "avx512", NULL
+    };
+    static const char *const checkNames[] = {
+	"none", "bulbs", "period", "all", NULL
+    };
+    static const char *const fractalNames[] = {
+	"mandelbrot", "julia", "ship", NULL
+    };
+    static const char *const formatNames[] = {
+	"tga", "rle", "qoi", "png", NULL
+    };
+
+    char *words[RENDER_OPTIONS_WORDS_MAX + 1];
+    int   count      = 1;
+    int   formatFlag = 0;
+    int   errorFlag  = 0;
+    int   found;
+
+    *outputPath = NULL;
+
+    // getopt wants a program name first, and a NULL last.
+    words[0] = "mandelbrot";
+
+    for (char *word = strtok(line, " \t\r\n"); word != NULL;
+	 word = strtok(NULL, " \t\r\n")) {
+	if (count == RENDER_OPTIONS_WORDS_MAX) {
+	    snprintf(error, errorSize, "Too many words in the options.");
+	    return 1;
+	}
+
+	words[count++] = word;
+    }
+
+    words[count] = NULL;
+
+    // Setting optind to 0 has getopt start over, on the new words.
+    optind = 0;
+    opterr = 0;
+
+    int arg;
+
+    while ((arg = getopt(count, words,
+			 "x:y:z:i:o:l:c:b:d:k:e:T:P:A:F:O:jf")) != -1) {
+	switch (arg) {
+	case 'x':
+	    renderInput->draw.offset.real = atof(optarg);
+	    break;
+
+	case 'y':
+	    renderInput->draw.offset.imag = atof(optarg);
+	    break;
+
+	case 'z':
+	    renderInput->draw.zoomLevel = atof(optarg);
+	    break;
+
+	case 'i':
+	    renderInput->color.maxIterations = atoi(optarg);
+	    break;
+
+	case 'o':
+	    renderInput->color.hueOffset = atof(optarg);
+	    break;
+
+	case 'l':
+	    renderInput->color.hueLimiter = atof(optarg);
+	    break;
+
+	case 'c':
+	    renderInput->color.constantLight = atof(optarg);
+	    break;
+
+	case 'b':
+	    renderInput->color.lightMax = atof(optarg);
+	    break;
+
+	case 'd':
+	    renderInput->color.lightDistribution = atof(optarg);
+	    break;
+
+	case 'k':
+	    if ((found = findName(optarg, kernelNames)) < 0)
+		errorFlag = 1;
+	    else
+		renderInput->calc.kernel = found;
+	    break;
+
+	case 'e':
+	    if ((found = findName(optarg, checkNames)) < 0)
+		errorFlag = 1;
+	    else
+		renderInput->calc.interiorChecks = found;
+	    break;
+
+	case 'T':
+	    if ((found = findName(optarg, fractalNames)) < 0)
+		errorFlag = 1;
+	    else
+		renderInput->calc.fractal = found;
+	    break;
+
+	case 'j':
+	    renderInput->calc.fractal = FRACTAL_JULIA;
+	    break;
+
+	case 'P':
+	    renderInput->calc.power = atoi(optarg);
+	    break;
+
+	case 'f':
+	    renderInput->calc.smooth = 1;
+	    break;
+
+	case 'A':
+	    renderInput->draw.samples = atoi(optarg);
+	    break;
+
+	case 'F':
+	    if ((found = findName(optarg, formatNames)) < 0)
+		errorFlag = 1;
+	    else
+		renderInput->format = found;
+
+	    formatFlag = 1;
+	    break;
+
+	case 'O':
+	    *outputPath = optarg;
+	    break;
+
+	default:
+	    snprintf(error, errorSize,
+		     "Option (-%c) not recognized, or not available here.",
+		     optopt);
+	    return 1;
+	}
+
+	if (errorFlag == 1) {
+	    snprintf(error, errorSize, "Value \"%s\" of -%c not recognized.",
+		     optarg, arg);
+	    return 1;
+	}
+    }
+
+    if (optind != count - 2) {
+	snprintf(error, errorSize, "Needs a width and a height, last.");
+	return 1;
+    }
+
+    const long width  = strtol(words[optind], NULL, 10);
+    const long height = strtol(words[optind + 1], NULL, 10);
+
+    if (*outputPath != NULL && formatFlag == 0 &&
+	renderOptionsFormat(*outputPath, &renderInput->format, NULL) != 0) {
+	snprintf(error, errorSize,
+		 "The format of \"%s\" (-O) is not known. Pick one with -F.",
+		 *outputPath);
+	return 1;
+    }
+
+    // The same limits mandelbrot holds its images to.
+    if (width < 1 || height < 1 || width > TARGA_SIZE_MAX ||
+	height > TARGA_SIZE_MAX || renderInput->draw.zoomLevel == 0 ||
+	renderInput->color.maxIterations < 1 ||
+	renderInput->calc.power < 2 ||
+	renderInput->calc.power > FRACTAL_POWER_MAX ||
+	renderInput->draw.samples < 1 ||
+	renderInput->draw.samples > SUPERSAMPLE_MAX ||
+	escapeKernelSupported(renderInput->calc.kernel) == 0) {
+	snprintf(error, errorSize,
+		 "Size, zoom, iterations, power, supersampling or kernel out "
+		 "of range. See mandelbrot -h.");
+	return 1;
+    }
+
+    renderInput->draw.width  = width;
+    renderInput->draw.height = height;
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * Options for a single image, read from a line of text, part of an exercise
+ * program that draws mandelbrot sets.
+ *
+ * The batch driver and the render server are both handed images to draw as
+ * lines of text, with the same options and size that mandelbrot takes on its
+ * command line, such as "-x -0.745 -y 0.1 -z 50 -F png 640 360". This module
+ * turns a line like that into render settings, so both read them the same way.
+ * Only the options for a plain image are taken; the ones that need a renderer
+ * of their own (-p, -g, -n, -a and so on) are not. The defaults, and the
+ * formats that go with each extension, are shared with mandelbrot itself.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef RENDER_OPTIONS_MODULE
+#define RENDER_OPTIONS_MODULE
+
+#include <stddef.h>
+#include "mandelbrotRender.h"
+
+// Most words a line of options can hold, size included.
+#define RENDER_OPTIONS_WORDS_MAX 64
+
+
+
+// The settings mandelbrot starts from, before any options.
+renderSettings renderOptionsDefaults(void);
+
+/*
+ * Tools for the format of an image file. The extension of a name is found
+ * with its dot, or is NULL if the name has none (dots in directories don't
+ * count). A name with no extension keeps the format it was given; .tga, .qoi
+ * and .png pick theirs; .tif and .tiff set tiffFlag, unless it is NULL. Any
+ * other extension is not known, and returns 1.
+ */
+const char *renderOptionsExtension(const char *name);
+int         renderOptionsFormat(const char  *name,
+				imageFormat *format,
+				int         *tiffFlag);
+
+/*
+ * Reads the options and size of an image from a line, on top of the settings
+ * already in renderInput. The line is cut up in place, and the name given to
+ * -O (or NULL) points into it. Takes -x, -y, -z, -i, -o, -l, -c, -b, -d, -k,
+ * -e, -T, -P, -j, -f, -A, -F and -O, and holds them to the same limits as
+ * mandelbrot does. Uses getopt, so only one thread can read a line at a time.
+ * Returns 1 if the line could not be read, with a message saying why in error.
+ */
+int renderOptionsParse(char            *line,
+		       renderSettings  *renderInput,
+		       const char     **outputPath,
+		       char            *error,
+		       const size_t     errorSize);
+
+#endif // RENDER_OPTIONS_MODULE
@@ -0,0 +1,527 @@
+/*
+ * A render server, part of an exercise program that draws mandelbrot sets.
+ *
+ * This file, 'server.c', draws images for other programs, such as a map
+ * viewer, that ask for them over a local (Unix domain) socket. Each request
+ * is one line, with the same options and size as mandelbrot would take on
+ * its command line, and the image is sent straight back from memory, encoded
+ * in whichever format was asked for, without ever touching a file.
+ *
+ * The escape times of recent images are kept in a cache (see 'escapeCache.h'),
+ * so asking for a view again in new colors only colors it again, and asking
+ * for the very same image again sends the one already made. Neither takes any
+ * iterating at all.
+ *
+ * Requests are answered one at a time, in the order they come in, each drawn
+ * on every thread. Any number of requests can be sent down a connection, one
+ * after another, and up to SERVER_CLIENTS_MAX connections can be open at once.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+
+// Sockets, signals and open_memstream are not part of ISO C.
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <omp.h>
+#include "mandelbrotRender.h"
+#include "escapeBuffer.h"
+#include "escapeCache.h"
+#include "bufferPool.h"
+#include "renderOptions.h"
+
+/* Megabytes of images kept in the cache, and of buffers kept for reuse once
+   they leave it, unless told otherwise. */
+#define SERVER_CACHE_MB 256
+#define SERVER_POOL_MB  64
+
+// Most connections open at once, and longest request, newline included.
+#define SERVER_CLIENTS_MAX 64
+#define REQUEST_MAX        4096
+
+
+
+
+// A connection, and whatever it has sent of its next request.
+typedef struct {
+    int    socket;
+    char   request[REQUEST_MAX];
+    size_t length;
+} serverClient;
+
+
+
+// Everything that lasts from one request to the next.
+typedef struct {
+    escapeCache   cache;
+    bufferPool    pool;
+    int           threadCount;
+    int           statsFlag;
+    unsigned long requests;
+} serverState;
+
+
+
+// Set by the signal handler, to have the server stop between requests.
+static volatile sig_atomic_t stopFlag = 0;
+
+
+
+
+// Seperated out for cleanliness.
+static void helpMenu(void)
+{
+    printf(
+	"Usage:\n"
+	"    mandelbrotServer [options] socketpath\n"
+	"Draws images asked for over a Unix domain socket, one request per line,\n"
+	"each given as mandelbrot would take it: [options] width height.\n"
+	"Request options: -x -y -z -i -o -l -c -b -d -k -e -T -P -j -f -A -F.\n"
+	"Answers \"OK length source\" and a newline, then the image, where\n"
+	"source is drawn, recolored or cached; or \"ERROR message\".\n"
+	"Available options:\n"
+	"        -t : Threads (default: every CPU).\n"
+	"        -m : Megabytes of images kept in the cache (default %d).\n"
+	"        -s : Print how long each request took.\n"
+	"        -h : Invokes this help menu.\n",
+	SERVER_CACHE_MB
+	);
+}
+
+
+
+
+// Asks the server to stop, on SIGINT or SIGTERM.
+static void stopServer(int signal)
+{
+    (void) signal;
+    stopFlag = 1;
+}
+
+
+
+
+/* Sends all of a buffer, however many calls it takes. A client that has gone
+   away is not a signal, only a failed send. Returns 1 on failure. */
+static int sendAll(const int socket, const char *data, size_t size)
+{
+    while (size > 0) {
+	const ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+
+	if (sent < 0) {
+	    if (errno == EINTR)
+		continue;
+
+	    return 1;
+	}
+
+	data += sent;
+	size -= sent;
+    }
+
+    return 0;
+}
+
+
+
+
+// Answers a request that could not be drawn.
+static int sendError(const int socket, const char *message)
+{
+    char answer[320];
+
+    snprintf(answer, sizeof answer, "ERROR %s\n", message);
+
+    return sendAll(socket, answer, strlen(answer));
+}
+
+
+
+
+/* Sends an image, after a line giving its length and where it came from.
+   Returns 1 on failure. */
+static int sendImage(const int   socket,
+		     const char *image,
+		     const size_t imageSize,
+		     const char *source)
+{
+    char answer[64];
+
+    snprintf(answer, sizeof answer, "OK %zu %s\n", imageSize, source);
+
+    if (sendAll(socket, answer, strlen(answer)) != 0)
+	return 1;
+
+    return sendAll(socket, image, imageSize);
+}
+
+
+
+
+/* Colors escape times into an image in memory. Returns 1 if memory could not
+   be allocated. */
+static int colorizeToMemory(const serverState   *server,
+			    const tEscapeBuffer *escapes,
+			    const colorSettings  color,
+			    const imageFormat    format,
+			    char               **image,
+			    size_t              *imageSize)
+{
+    FILE *imageFile = open_memstream(image, imageSize);
+
+    if (imageFile == NULL)
+	return 1;
+
+    const int status = colorizeToTarga(escapes, color, format,
+				       server->threadCount, imageFile);
+
+    if (fclose(imageFile) != 0 || status != 0) {
+	free(*image);
+	return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+/*
+ * Answers a single request, from the cache if it can. Images that are already
+ * in the cache, in the same colors and format, are sent as they are. Ones
+ * whose escape times are in it are colored again. Anything else is drawn, and
+ * its escape times, and the image made of them, added to the cache. Images
+ * with supersampling need the renderers' own coloring, so they are drawn in
+ * full every time, and not kept. Returns 1 if the client has to be dropped.
+ */
+static int answerRequest(serverState *server, const int socket, char *line)
+{
+    renderSettings renderInput = renderOptionsDefaults();
+    const char    *outputPath;
+    char           error[256];
+    const double   startTime   = omp_get_wtime();
+
+    server->requests++;
+
+    if (renderOptionsParse(line, &renderInput, &outputPath, error,
+			   sizeof error) != 0)
+	return sendError(socket, error);
+
+    if (outputPath != NULL)
+	return sendError(socket, "Option (-O) not available here.");
+
+    renderInput.draw.threadCount = server->threadCount;
+    renderInput.pool             = &server->pool;
+
+    const colorSettings color     = renderInput.color;
+    const imageFormat   format    = renderInput.format;
+    char               *image     = NULL;
+    size_t              imageSize = 0;
+    const char         *source;
+    int                 status    = 0;
+
+    if (renderInput.draw.samples > 1) {
+	source = "drawn";
+	renderInput.imageFile = open_memstream(&image, &imageSize);
+
+	if (renderInput.imageFile == NULL)
+	    return sendError(socket, "Could not allocate memory.");
+
+	status = renderToTarga_parallel(renderInput);
+
+	if (fclose(renderInput.imageFile) != 0 || status != 0) {
+	    free(image);
+	    return sendError(socket, "Could not allocate memory.");
+	}
+
+	status = sendImage(socket, image, imageSize, source);
+	free(image);
+    } else {
+	escapeCacheEntry *entry = escapeCacheFind(&server->cache,
+						  &renderInput);
+
+	if (entry != NULL && escapeCacheImageMatches(entry, color, format)) {
+	    // The image is the cache's, but its size still goes in the log.
+	    source    = "cached";
+	    imageSize = entry->imageSize;
+	    status    = sendImage(socket, entry->image, imageSize, source);
+	} else if (entry != NULL) {
+	    source = "recolored";
+
+	    if (colorizeToMemory(server, &entry->escapes, color, format,
+				 &image, &imageSize) != 0)
+		return sendError(socket, "Could not allocate memory.");
+
+	    status = sendImage(socket, image, imageSize, source);
+	    escapeCacheKeepImage(&server->cache, entry, color, format, image,
+				 imageSize);
+	} else {
+	    tEscapeBuffer escapes;
+	    source = "drawn";
+
+	    if (renderEscapes(renderInput, &escapes) != 0)
+		return sendError(socket, "Could not allocate memory.");
+
+	    if (colorizeToMemory(server, &escapes, color, format, &image,
+				 &imageSize) != 0) {
+		escapeBufferDeallocate(&escapes);
+		return sendError(socket, "Could not allocate memory.");
+	    }
+
+	    status = sendImage(socket, image, imageSize, source);
+	    escapeCacheAdd(&server->cache, &renderInput, &escapes, color,
+			   format, image, imageSize);
+	}
+    }
+
+    if (server->statsFlag == 1)
+	fprintf(stderr, "Request %lu: %zu bytes, %s, in %.3f ms.\n",
+		server->requests, imageSize, source,
+		1000 * (omp_get_wtime() - startTime));
+
+    return status;
+}
+
+
+
+
+/* Reads whatever a client has sent, and answers every whole request in it.
+   Returns 1 once the client has hung up, or has to be dropped. */
+static int readClient(serverState *server, serverClient *client)
+{
+    const ssize_t received = recv(client->socket,
+				  client->request + client->length,
+				  REQUEST_MAX - client->length, 0);
+
+    if (received < 0 && errno == EINTR)
+	return 0;
+
+    if (received <= 0)
+	return 1;
+
+    client->length += received;
+
+    char *end;
+
+    while ((end = memchr(client->request, '\n', client->length)) != NULL) {
+	const size_t lineLength = end - client->request + 1;
+	*end = '\0';
+
+	if (answerRequest(server, client->socket, client->request) != 0)
+	    return 1;
+
+	client->length -= lineLength;
+	memmove(client->request, client->request + lineLength,
+		client->length);
+    }
+
+    // A request that fills the buffer without ending never will.
+    if (client->length == REQUEST_MAX) {
+	sendError(client->socket, "Request too long.");
+	return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+/* Opens the socket, removing one left behind by an earlier server that was
+   not stopped cleanly. Anything at the path that is not a socket is left be.
+   Returns the socket, or -1 on failure. */
+static int openSocket(const char *path)
+{
+    struct sockaddr_un address;
+    struct stat        status;
+
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    if (stat(path, &status) == 0 && S_ISSOCK(status.st_mode))
+	unlink(path);
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listener < 0)
+	return -1;
+
+    if (bind(listener, (struct sockaddr *) &address, sizeof address) != 0 ||
+	listen(listener, SERVER_CLIENTS_MAX) != 0) {
+	close(listener);
+	return -1;
+    }
+
+    return listener;
+}
+
+
+
+
+/* Gathers the options, opens the socket, then answers requests until stopped
+   by SIGINT or SIGTERM. */
+int main(int argc, char *argv[])
+{
+    int  threadCount = omp_get_num_procs();
+    long cacheSize   = SERVER_CACHE_MB;
+    int  statsFlag   = 0;
+    int  arg;
+
+    while ((arg = getopt(argc, argv, "t:m:sh")) != -1) {
+	switch (arg) {
+	case 't':
+	    threadCount = atoi(optarg);
+	    break;
+
+	case 'm':
+	    cacheSize = atol(optarg);
+	    break;
+
+	case 's':
+	    statsFlag = 1;
+	    break;
+
+	case 'h':
+	    helpMenu();
+	    return 0;
+
+	default:
+	    fprintf(
+		stderr,
+		"Use -h for additional help.\n"
+		);
+	    return 1;
+	}
+    }
+
+    if (optind != argc - 1 || threadCount < 1 || cacheSize < 0 ||
+	strlen(argv[optind]) >= sizeof ((struct sockaddr_un *) 0)->sun_path) {
+	fprintf(
+	    stderr,
+	    "Error: Needs one socket path, not too long, and a positive "
+	    "thread count (-t) and cache size (-m).\n"
+	    "Use -h for additional help.\n"
+	    );
+	return 1;
+    }
+
+    const char *path     = argv[optind];
+    const int   listener = openSocket(path);
+
+    if (listener < 0) {
+	fprintf(
+	    stderr,
+	    "Error: Could not open the socket \"%s\".\n",
+	    path
+	    );
+	return 3;
+    }
+
+    /* Without SA_RESTART, so a signal wakes poll up, and the server stops
+       between requests. */
+    struct sigaction action;
+    memset(&action, 0, sizeof action);
+    action.sa_handler = stopServer;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    serverState  *server  = malloc(sizeof *server);
+    serverClient *clients = malloc(SERVER_CLIENTS_MAX * sizeof *clients);
+
+    if (server == NULL || clients == NULL) {
+	fprintf(
+	    stderr,
+	    "Error: Could not allocate memory for the server.\n"
+	    );
+	free(server);
+	free(clients);
+	close(listener);
+	unlink(path);
+	return 2;
+    }
+
+    escapeCacheInit(&server->cache, (size_t) cacheSize << 20);
+    bufferPoolInit(&server->pool, (size_t) SERVER_POOL_MB << 20);
+    server->threadCount = threadCount;
+    server->statsFlag   = statsFlag;
+    server->requests    = 0;
+
+    int clientCount = 0;
+
+    while (stopFlag == 0) {
+	struct pollfd polls[SERVER_CLIENTS_MAX + 1];
+
+	for (int i = 0; i < clientCount; i++) {
+	    polls[i].fd     = clients[i].socket;
+	    polls[i].events = POLLIN;
+	}
+
+	// New connections wait until there is room for them.
+	const int listening = clientCount < SERVER_CLIENTS_MAX;
+	const int polled    = clientCount;
+
+	polls[polled].fd     = listener;
+	polls[polled].events = POLLIN;
+
+	if (poll(polls, polled + listening, -1) < 0)
+	    continue;
+
+	/* Goes through the clients backwards, so dropping one (by moving the
+	   last into its place) skips none of the others. */
+	for (int i = clientCount - 1; i >= 0 && stopFlag == 0; i--) {
+	    if (polls[i].revents == 0)
+		continue;
+
+	    if (readClient(server, &clients[i]) != 0) {
+		close(clients[i].socket);
+		clients[i] = clients[--clientCount];
+	    }
+	}
+
+	if (listening && stopFlag == 0 && (polls[polled].revents & POLLIN)) {
+	    const int client = accept(listener, NULL, NULL);
+
+	    if (client >= 0) {
+		clients[clientCount].socket = client;
+		clients[clientCount].length = 0;
+		clientCount++;
+	    }
+	}
+    }
+
+    for (int i = 0; i < clientCount; i++)
+	close(clients[i].socket);
+
+    close(listener);
+    unlink(path);
+
+    if (statsFlag == 1)
+	fprintf(
+	    stderr,
+	    "%lu requests. Cache: %lu hits, %lu misses, %zu bytes held.\n",
+	    server->requests, server->cache.hits, server->cache.misses,
+	    server->cache.held
+	    );
+
+    escapeCacheFree(&server->cache);
+    bufferPoolFree(&server->pool);
+    free(server);
+    free(clients);
+
+    return 0;
+}
@@ -10,73 +10,75 @@
  * this license has been provided in the main directory of this project. If it
  * is missing, a new copy can be downloaded from https://www.gnu.org/.
  */
+#define _DEFAULT_SOURCE
+
 #include "targa.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 
 
 
-/* 
- * Functions for allocating and deallocating memory for a 24 bit RGB image. 
- * Modified from the primary answer to:
- *
- * stackoverflow.com/questions/15062718/allocate-memory-2d-array-in-function-c
- *
- * ...with the primary inclusion of error-checking, as the sources provided in
- * the secondary answer suggest. 
- */
-tRGB *targaAllocateImage(tRGB ***image, const int width, const int height)
+// Alignment of the rows of an image, in bytes. One cache line.
+#define ROW_ALIGNMENT 64
+
+/* Number of pixels targaWriteRow_RGB24 converts before each fwrite. Rows up
+   to this width go out in a single call. */
+#define WRITE_CHUNK 16384
+
+// Longest packet of run-length encoded pixels.
+#define RLE_PACKET_MAX 128
+
+
+
+
+/* Allocates a row-major image. The stride is rounded up so that every row
+   starts on a fresh cache line, and no two rows share one. */
+int targaAllocateImage(tImage *image, const int width, const int height)
 {
-    /* Allocates the first level of the 2D array, which holds pointers to arrays
-       that make the rows of the image. Checks for malloc error. */
-    *image = malloc(width * sizeof *image);
-    if (*image == NULL)
-	return NULL;
-
-    // Allocates all the rows on the image in one call. Checks for malloc error.
-    tRGB *imageData = malloc(width * height * sizeof (tRGB));
-    if (imageData == NULL) {
-	free(*image);
-	*image = NULL;
-	return NULL;
-    }
+    const int rowPixels = ROW_ALIGNMENT / sizeof (tRGB);
+
+    image->width  = width;
+    image->height = height;
+    image->stride = (width + rowPixels - 1) / rowPixels * rowPixels;
 
-    // Makes the arrays for the rows of the image.
-    for(int i = 0; i < width; i++)
-	(*image)[i] = imageData + i * height;
+    // aligned_alloc wants the size to be a multiple of the alignment.
+    image->pixels = aligned_alloc(ROW_ALIGNMENT,
+				  (size_t) image->stride * height * sizeof (tRGB));
+    if (image->pixels == NULL)
+	return 1;
 
-    // Returns the interal array. Needs to be saved for clearing memory later.
-    return imageData;
+    return 0;
 }
 
 
 
 
-/* Function for deallocating memory for a 24 bit RGB image. Lightly modified 
-   from the same source. */
-void targaDeallocateImage(tRGB ***image, tRGB *imageData)
+// Function for deallocating memory for a 24 bit RGB image.
+void targaDeallocateImage(tImage *image)
 {
-    free(imageData);
-    imageData = NULL;
-    
-    free(*image);
-    image = NULL;
+    free(image->pixels);
+    image->pixels = NULL;
 }
 
 
 
 
-// Writes out a TGA header for an uncompressed 24 bit RGB image.
-void targaWriteHeader_RGB24(const int width, const int height, FILE *imageFile)
+// Fills in a TGA header for a 24 bit RGB image.
+static void packHeader_RGB24(const int           width,
+			     const int           height,
+			     const targaEncoding encoding,
+			     char                header[TARGA_HEADER_SIZE])
 {
     // TGA formatting lightly modified from paulbourke.net/dataformats/tga.
     
-    char header[18];
     header[0]  = 0;                      // id length.
     header[1]  = 0;                      // Colormap type.
-    header[2]  = 2;                      // Data-type field. 2 -> Uncompressed RGB.
+    header[2]  = (encoding == TARGA_RLE) ? 10 : 2; // Data-type field. 2 -> Uncompressed, 10 -> Run-length encoded RGB.
     header[3]  = 0; header[4]  = 0;      // Colormap origin.
     header[5]  = 0; header[6]  = 0;      // Colormap length.
     header[7]  = 0;                      // Colormap depth.
@@ -87,11 +89,24 @@ void targaWriteHeader_RGB24(const int width, const int height, FILE *imageFile)
     header[14] = (height & 0x00FF);      // Image height. First the lower, then the upper byte of the number.
     header[15] = (height & 0xFF00) / 256;
     header[16] = 24;                     // Bits per pixel. 24 -> Standard RGB color depth.
-    header[17] = 0;                      // Image descriptor.
+    header[17] = 0x20;                   // Image descriptor. 0x20 -> The first row is the top one.
+}
+
+
+
+
+// Writes out a TGA header for a 24 bit RGB image.
+void targaWriteHeader_RGB24(const int           width,
+			    const int           height,
+			    const targaEncoding encoding,
+			    FILE               *imageFile)
+{
+    char header[TARGA_HEADER_SIZE];
+
+    packHeader_RGB24(width, height, encoding, header);
 
     // Prints the header to the file.
-    for (int i = 0; i < 18; i++)
-	fputc(header[i], imageFile);
+    fwrite(header, 1, sizeof header, imageFile);
 }
 
 
@@ -107,14 +122,172 @@ void targaWritePixel_RGB24(const tRGB pixel, FILE *imageFile) {
 
 
 
+// Converts a row of RGB pixels to the BGR byte order TARGA uses.
+void targaPackRow_RGB24(const tRGB *row, const int width, unsigned char *bytes)
+{
+    for (int i = 0; i < width; i++) {
+	bytes[3 * i]     = row[i].b;
+	bytes[3 * i + 1] = row[i].g;
+	bytes[3 * i + 2] = row[i].r;
+    }
+}
+
+
+
+
+// Checks whether two pixels are the same color.
+static inline int samePixel(const tRGB a, const tRGB b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+
+
+
+/*
+ * Run-length encodes a row. Two or more neighbouring pixels of one color go in
+ * a run packet, which is a count and a single pixel. Everything else goes in
+ * raw packets, which are a count and the pixels as they are. A raw packet is
+ * cut short at the start of any run, even a run of two, since a run packet
+ * never takes more room than the raw pixels it replaces, header and all.
+ * Packets never reach past the end of the row.
+ */
+size_t targaPackRow_RLE24(const tRGB    *row,
+			  const int      width,
+			  unsigned char *bytes)
+{
+    size_t length = 0;
+    int    x      = 0;
+
+    // Puts a pixel into the packet, in BGR order.
+    void putPixel(const tRGB pixel) {
+	bytes[length++] = pixel.b;
+	bytes[length++] = pixel.g;
+	bytes[length++] = pixel.r;
+    }
+
+    while (x < width) {
+	int count = 1;
+
+	while (x + count < width && count < RLE_PACKET_MAX &&
+	       samePixel(row[x + count], row[x]))
+	    count++;
+
+	if (count > 1) {
+	    // The top bit of the count marks a run packet.
+	    bytes[length++] = 0x80 | (count - 1);
+	    putPixel(row[x]);
+	    x += count;
+	    continue;
+	}
+
+	// Goes on until the next pixel starts a run of its own.
+	while (x + count < width && count < RLE_PACKET_MAX &&
+	       !(x + count + 1 < width &&
+		 samePixel(row[x + count], row[x + count + 1])))
+	    count++;
+
+	bytes[length++] = count - 1;
+
+	for (int i = 0; i < count; i++)
+	    putPixel(row[x + i]);
+
+	x += count;
+    }
+
+    return length;
+}
+
+
+
+
+/* Prints a whole row of RGB pixels to a file. The row is converted to the BGR
+   byte order TARGA uses (and encoded, if asked for) in one pass, then handed
+   to fwrite in bulk, rather than making three library calls per pixel. Long
+   rows are done in chunks, which just splits a packet at each seam. */
+void targaWriteRow_RGB24(const tRGB         *row,
+			 const int           width,
+			 const targaEncoding encoding,
+			 FILE               *imageFile)
+{
+    unsigned char bytes[TARGA_RLE_ROW_BYTES(WRITE_CHUNK)];
+
+    for (int start = 0; start < width; start += WRITE_CHUNK) {
+	const int count = (width - start < WRITE_CHUNK) ?
+	    width - start : WRITE_CHUNK;
+
+	if (encoding == TARGA_RLE) {
+	    fwrite(bytes, 1, targaPackRow_RLE24(row + start, count, bytes),
+		   imageFile);
+	} else {
+	    targaPackRow_RGB24(row + start, count, bytes);
+	    fwrite(bytes, 3, count, imageFile);
+	}
+    }
+}
+
+
+
+
 // Writes out an RGB image to a TGA file.
-void targaWriteImage_RGB24(tRGB** image, const int width, const int height, FILE *imageFile)
+void targaWriteImage_RGB24(const tImage        *image,
+			   const targaEncoding encoding,
+			   FILE               *imageFile)
 {
     // Writes the header information to the file.
-    targaWriteHeader_RGB24(width, height, imageFile);
+    targaWriteHeader_RGB24(image->width, image->height, encoding, imageFile);
+
+    // Prints the image to the file, one whole row at a time.
+    for (int y = 0; y < image->height; y++)
+	targaWriteRow_RGB24(targaImageRow(image, y), image->width, encoding,
+			    imageFile);
+}
+
+
+
+
+/* Grows the file to the size of the whole image, maps it, and puts the header
+   in. The pixels are left as the zeroes the file was grown with. The disk
+   space is taken up front: a full disk met by a store into the map would kill
+   the program with SIGBUS, instead of failing here. */
+int targaMapImage(tTargaMap *map, FILE *imageFile, const int width,
+		  const int height)
+{
+    // Anything still sitting in the stream's buffer would land on the pixels.
+    if (fflush(imageFile) != 0)
+	return 1;
+
+    const int fd = fileno(imageFile);
+
+    map->width  = width;
+    map->height = height;
+    map->size   = TARGA_HEADER_SIZE + (size_t) width * height * 3;
+
+    if (ftruncate(fd, (off_t) map->size) != 0 ||
+	posix_fallocate(fd, 0, (off_t) map->size) != 0)
+	return 1;
+
+    map->memory = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		       fd, 0);
+    if (map->memory == MAP_FAILED) {
+	map->memory = NULL;
+	return 1;
+    }
+
+    packHeader_RGB24(width, height, TARGA_RAW, (char *) map->memory);
+
+    return 0;
+}
+
+
+
+
+// Unmaps an image, leaving the kernel to write back the rest of it.
+int targaUnmapImage(tTargaMap *map)
+{
+    const int status = munmap(map->memory, map->size);
+
+    map->memory = NULL;
 
-    // Prints each pixel to the image. 
-    for (int y = 0; y < height; y++)
-	for (int x = 0; x < width; x++)
-	    targaWritePixel_RGB24(image[x][y], imageFile); 
+    return status != 0;
 }
@@ -15,6 +15,32 @@
 #include <stdio.h>
 
 
+/* The header keeps the width and height in 16 bits, so no TARGA image can be
+   bigger than this either way. */
+#define TARGA_SIZE_MAX 65535
+
+// Size of the header, which comes before the pixels.
+#define TARGA_HEADER_SIZE 18
+
+/* Most bytes a run-length encoded row can take: the pixels themselves, if no
+   two neighbours match, and a byte for every 128 of them. */
+#define TARGA_RLE_ROW_BYTES(width) \
+    (3 * (size_t) (width) + ((size_t) (width) + 127) / 128)
+
+
+
+/*
+ * How the pixels of a TARGA image are stored. Run-length encoding squeezes
+ * runs of one color (the inside of the set, and the wide bands around it) down
+ * to 4 bytes per 128 pixels. Every row is encoded on its own, so rows can be
+ * encoded by different threads, and simply written one after another.
+ */
+typedef enum {
+    TARGA_RAW = 0, // Uncompressed, type 2.
+    TARGA_RLE      // Run-length encoded, type 10.
+} targaEncoding;
+
+
 // Packed 24-bit RGB type.
 typedef struct {
     unsigned int r:8;
@@ -24,21 +50,94 @@ typedef struct {
 
 
 
-// Tools for creating an image in RAM.
-tRGB *targaAllocateImage(tRGB ***image, const int width, const int height);
-void  targaDeallocateImage(tRGB ***image, tRGB *imageData);
+/*
+ * A 24 bit RGB image held in RAM.
+ *
+ * The pixels are stored one row after another, top row first, so walking
+ * along a row walks through memory. Each row starts on a 64 byte boundary,
+ * which is why rows are 'stride' pixels apart rather than 'width'.
+ */
+typedef struct {
+    tRGB *pixels; // First pixel of the top row.
+    int   width;
+    int   height;
+    int   stride; // Distance from the start of one row to the next, in pixels.
+} tImage;
+
+
+
+// Tools for creating an image in RAM. Allocation returns 1 on failure.
+int  targaAllocateImage(tImage *image, const int width, const int height);
+void targaDeallocateImage(tImage *image);
 
+// Gets a pointer to the first pixel of a row of the image.
+static inline tRGB *targaImageRow(const tImage *image, const int y)
+{
+    return image->pixels + (size_t) y * image->stride;
+}
 
 
-// Tools for writing an image to disk.
-void targaWriteHeader_RGB24(const int width, const int height, FILE *imageFile);
+
+/* Tools for writing an image to disk. Single pixels can only be written to
+   uncompressed images. */
+void targaWriteHeader_RGB24(const int           width,
+			    const int           height,
+			    const targaEncoding encoding,
+			    FILE               *imageFile);
 void targaWritePixel_RGB24(const tRGB pixel, FILE *imageFile);
+void targaWriteRow_RGB24(const tRGB         *row,
+			 const int           width,
+			 const targaEncoding encoding,
+			 FILE               *imageFile);
+
+// Converts a row of pixels to the BGR bytes TARGA stores, 3 per pixel.
+void targaPackRow_RGB24(const tRGB *row, const int width, unsigned char *bytes);
+
+/* Run-length encodes a row of pixels, returning the number of bytes it took,
+   which is never more than TARGA_RLE_ROW_BYTES(width). */
+size_t targaPackRow_RLE24(const tRGB    *row,
+			  const int      width,
+			  unsigned char *bytes);
 
 
 
 // Tools for writing an allocated image to disk.
-void targaWriteImage_RGB24(tRGB **image, const int width, const int height,
-			   FILE *imageFile);
+void targaWriteImage_RGB24(const tImage        *image,
+			   const targaEncoding encoding,
+			   FILE               *imageFile);
+
+
+
+/*
+ * A TARGA image file mapped into memory, so that its pixels can be written
+ * straight into the file, from any thread and in any order. The rows are
+ * packed BGR bytes, top row first, as targaWriteRow_RGB24 would write them.
+ */
+typedef struct {
+    unsigned char *memory; // The whole file, header and all.
+    size_t         size;
+    int            width;
+    int            height;
+} tTargaMap;
+
+
+
+/*
+ * Tools for mapping an image file. Mapping sizes the file to fit the whole
+ * image, setting aside its space on disk, and writes the header. The file must be a regular file, open for
+ * reading as well as writing (such as with "wb+"). Both return 1 on failure;
+ * unmapping hands any pixels not yet on disk over to be written back, as
+ * closing a file would.
+ */
+int targaMapImage(tTargaMap *map, FILE *imageFile, const int width,
+		  const int height);
+int targaUnmapImage(tTargaMap *map);
+
+// Gets a pointer to the first byte of a row of a mapped image.
+static inline unsigned char *targaMapRow(const tTargaMap *map, const int y)
+{
+    return map->memory + TARGA_HEADER_SIZE + (size_t) y * map->width * 3;
+}
 
 
 
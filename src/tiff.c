@@ -0,0 +1,345 @@
+/*
+ * A very simple tiled TIFF writer, part of an exercise program that draws
+ * mandelbrot sets.
+ *
+ * This module only contains things directly partaining to the TIFF format. The
+ * layout of the files it writes is explained in 'tiff.h'.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#define _DEFAULT_SOURCE
+
+#include "tiff.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+// Tags of the entries in the image's directory, in the order they must go.
+#define TAG_IMAGE_WIDTH      256
+#define TAG_IMAGE_LENGTH     257
+#define TAG_BITS_PER_SAMPLE  258
+#define TAG_COMPRESSION      259
+#define TAG_PHOTOMETRIC      262
+#define TAG_ORIENTATION      274
+#define TAG_SAMPLES_PER_PIX  277
+#define TAG_PLANAR_CONFIG    284
+#define TAG_TILE_WIDTH       322
+#define TAG_TILE_LENGTH      323
+#define TAG_TILE_OFFSETS     324
+#define TAG_TILE_BYTE_COUNTS 325
+#define ENTRY_COUNT          12
+
+// Types of the values in an entry.
+#define TYPE_SHORT 3  // 16 bits.
+#define TYPE_LONG  4  // 32 bits.
+#define TYPE_LONG8 16 // 64 bits, BigTIFF only.
+
+/* The header and directory are written in one go, from a buffer this big. It
+   has room for the biggest directory, and the bits per sample after it. */
+#define HEAD_BYTES 512
+
+// Tiles start on a fresh block of the file, so writing them never straddles.
+#define DATA_ALIGNMENT 4096
+
+// Number of entries of the tile offset and size arrays written at once.
+#define ARRAY_CHUNK 4096
+
+
+
+
+// Where each part of the file goes. Worked out before anything is written.
+typedef struct {
+    uint64_t directory; // The image's directory of entries.
+    uint64_t bits;      // Bits per sample, unless they fit in their entry.
+    uint64_t offsets;   // Where every tile is, unless it fits in its entry.
+    uint64_t counts;    // How big every tile is, likewise.
+    uint64_t end;       // One past the last tile.
+} fileLayout;
+
+
+
+
+// Puts a number into a buffer, lowest byte first, as the header asks for.
+static void putNumber(unsigned char *at, uint64_t value, const int size)
+{
+    for (int i = 0; i < size; i++) {
+	at[i]   = value & 0xFF;
+	value >>= 8;
+    }
+}
+
+
+
+
+/* Writes all of a buffer to a place in the file, carrying on after writes
+   that were cut short. Returns 1 on failure. */
+static int writeAt(const int fd, const void *buffer, size_t size,
+		   uint64_t offset)
+{
+    const unsigned char *bytes = buffer;
+
+    while (size > 0) {
+	const ssize_t written = pwrite(fd, bytes, size, (off_t) offset);
+
+	if (written < 0 && errno == EINTR)
+	    continue;
+	if (written <= 0)
+	    return 1;
+
+	bytes  += written;
+	size   -= written;
+	offset += written;
+    }
+
+    return 0;
+}
+
+
+
+
+/* Works out where everything goes in the file, in the format tiff->bigTiff
+   says. A value is kept in its entry whenever it fits, which is 4 bytes in a
+   TIFF, and 8 in a BigTIFF. */
+static void planLayout(tiffWriter *tiff, fileLayout *layout)
+{
+    const uint64_t tileCount  = (uint64_t) tiff->tilesAcross * tiff->tilesDown;
+    const uint64_t fieldSize  = tiff->bigTiff ? 8 : 4;
+    const uint64_t offsetSize = tiff->bigTiff ? 8 : 4;
+    uint64_t       at;
+
+    layout->directory = tiff->bigTiff ? 16 : 8;
+    at = layout->directory + (tiff->bigTiff ?
+			      8 + 20 * ENTRY_COUNT + 8 :
+			      2 + 12 * ENTRY_COUNT + 4);
+
+    // Three 16 bit numbers, one for each of red, green and blue.
+    layout->bits = at;
+    if (3 * 2 > fieldSize)
+	at += 8;
+
+    layout->offsets = at;
+    if (tileCount * offsetSize > fieldSize)
+	at += tileCount * offsetSize;
+
+    layout->counts = at;
+    if (tileCount * 4 > fieldSize)
+	at += tileCount * 4;
+
+    tiff->dataStart = (at + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT *
+	DATA_ALIGNMENT;
+    layout->end     = tiff->dataStart + tileCount * tiff->tileBytes;
+}
+
+
+
+
+/* Puts an entry into the directory, returning where the next one goes. The
+   value is either the value itself, or where in the file the values are. */
+static unsigned char *putEntry(const tiffWriter *tiff,
+			       unsigned char    *at,
+			       const int         tag,
+			       const int         type,
+			       const uint64_t    count,
+			       const uint64_t    value)
+{
+    putNumber(at, tag, 2);
+    putNumber(at + 2, type, 2);
+
+    if (tiff->bigTiff) {
+	putNumber(at + 4, count, 8);
+	putNumber(at + 12, value, 8);
+	return at + 20;
+    }
+
+    putNumber(at + 4, count, 4);
+    putNumber(at + 8, value, 4);
+    return at + 12;
+}
+
+
+
+
+/*
+ * Writes an array of tile offsets or sizes (of 'size' bytes each), either into
+ * the value of its entry, if it fits, or out to its place in the file, a chunk
+ * at a time. Returns the value for the entry, or 1 as an error through status.
+ */
+static uint64_t writeTileArray(const tiffWriter *tiff,
+			       const uint64_t    place,
+			       const int         size,
+			       const int         offsets,
+			       int              *status)
+{
+    const uint64_t tileCount = (uint64_t) tiff->tilesAcross * tiff->tilesDown;
+    const uint64_t fieldSize = tiff->bigTiff ? 8 : 4;
+    unsigned char  chunk[ARRAY_CHUNK * 8];
+
+    // Offset or size of a tile, by its number.
+    uint64_t item(uint64_t i) {
+	return offsets ? tiff->dataStart + i * tiff->tileBytes :
+	    tiff->tileBytes;
+    }
+
+    if (tileCount * size <= fieldSize) {
+	uint64_t value = 0;
+
+	for (uint64_t i = 0; i < tileCount; i++)
+	    value |= item(i) << (8 * size * i);
+
+	return value;
+    }
+
+    for (uint64_t start = 0; start < tileCount && *status == 0;
+	 start += ARRAY_CHUNK) {
+	const uint64_t count = (tileCount - start < ARRAY_CHUNK) ?
+	    tileCount - start : ARRAY_CHUNK;
+
+	for (uint64_t i = 0; i < count; i++)
+	    putNumber(chunk + i * size, item(start + i), size);
+
+	*status = writeAt(tiff->fd, chunk, count * size, place + start * size);
+    }
+
+    return place;
+}
+
+
+
+
+/* Lays the file out, then writes the header, the directory, and the arrays
+   saying where the tiles go. The tiles themselves are left for later. */
+int tiffWriterInit(tiffWriter *tiff,
+		   FILE       *file,
+		   const int   width,
+		   const int   height,
+		   const int   tileSize)
+{
+    // Anything still sitting in the stream's buffer would land on the tiles.
+    if (fflush(file) != 0)
+	return 1;
+
+    tiff->fd          = fileno(file);
+    tiff->width       = width;
+    tiff->height      = height;
+    tiff->tileSize    = tileSize;
+    tiff->tilesAcross = (width + tileSize - 1) / tileSize;
+    tiff->tilesDown   = (height + tileSize - 1) / tileSize;
+    tiff->tileBytes   = (size_t) tileSize * tileSize * 3;
+
+    // Plain TIFF offsets are 32 bits, so bigger files have to be BigTIFFs.
+    fileLayout layout;
+
+    tiff->bigTiff = 0;
+    planLayout(tiff, &layout);
+
+    if (layout.end > UINT32_MAX) {
+	tiff->bigTiff = 1;
+	planLayout(tiff, &layout);
+    }
+
+    const int      big        = tiff->bigTiff;
+    const int      offsetSize = big ? 8 : 4;
+    unsigned char  head[HEAD_BYTES];
+    unsigned char *at;
+    int            status     = 0;
+
+    memset(head, 0, sizeof head);
+
+    // "II" marks the numbers as lowest byte first. 42 is TIFF, 43 BigTIFF.
+    head[0] = 'I';
+    head[1] = 'I';
+
+    if (big) {
+	putNumber(head + 2, 43, 2);
+	putNumber(head + 4, 8, 2); // Size of an offset.
+	putNumber(head + 8, layout.directory, 8);
+	putNumber(head + layout.directory, ENTRY_COUNT, 8);
+	at = head + layout.directory + 8;
+    } else {
+	putNumber(head + 2, 42, 2);
+	putNumber(head + 4, layout.directory, 4);
+	putNumber(head + layout.directory, ENTRY_COUNT, 2);
+	at = head + layout.directory + 2;
+    }
+
+    // 8 bits per sample. In a BigTIFF, all three fit in the entry.
+    const uint64_t bits = 8 | (uint64_t) 8 << 16 | (uint64_t) 8 << 32;
+
+    if (!big)
+	putNumber(head + layout.bits, bits, 6);
+
+    const uint64_t offsets = writeTileArray(tiff, layout.offsets, offsetSize,
+					    1, &status);
+    const uint64_t counts  = writeTileArray(tiff, layout.counts, 4, 0,
+					    &status);
+
+    at = putEntry(tiff, at, TAG_IMAGE_WIDTH, TYPE_LONG, 1, width);
+    at = putEntry(tiff, at, TAG_IMAGE_LENGTH, TYPE_LONG, 1, height);
+    at = putEntry(tiff, at, TAG_BITS_PER_SAMPLE, TYPE_SHORT, 3,
+		  big ? bits : layout.bits);
+    at = putEntry(tiff, at, TAG_COMPRESSION, TYPE_SHORT, 1, 1); // None.
+    at = putEntry(tiff, at, TAG_PHOTOMETRIC, TYPE_SHORT, 1, 2); // RGB.
+    at = putEntry(tiff, at, TAG_ORIENTATION, TYPE_SHORT, 1, 1); // Top left.
+    at = putEntry(tiff, at, TAG_SAMPLES_PER_PIX, TYPE_SHORT, 1, 3);
+    at = putEntry(tiff, at, TAG_PLANAR_CONFIG, TYPE_SHORT, 1, 1); // RGBRGB...
+    at = putEntry(tiff, at, TAG_TILE_WIDTH, TYPE_LONG, 1, tileSize);
+    at = putEntry(tiff, at, TAG_TILE_LENGTH, TYPE_LONG, 1, tileSize);
+    at = putEntry(tiff, at, TAG_TILE_OFFSETS, big ? TYPE_LONG8 : TYPE_LONG,
+		  (uint64_t) tiff->tilesAcross * tiff->tilesDown, offsets);
+    putEntry(tiff, at, TAG_TILE_BYTE_COUNTS, TYPE_LONG,
+	     (uint64_t) tiff->tilesAcross * tiff->tilesDown, counts);
+
+    /* The directory ends with the place of the next one, which is left as 0,
+       as there is none. The tile arrays start right after it, or after the
+       bits per sample, so everything before them comes from the buffer. */
+    if (status == 0)
+	status = writeAt(tiff->fd, head, layout.offsets, 0);
+
+    return status;
+}
+
+
+
+
+/* Converts a tile to the RGB byte order TIFF uses, padding it out to the full
+   tile size, and writes it to its place in the file. */
+int tiffWriteTile(const tiffWriter *tiff,
+		  const int         x,
+		  const int         y,
+		  const tRGB       *pixels,
+		  const int         stride,
+		  unsigned char    *bytes)
+{
+    const int      tileSize = tiff->tileSize;
+    const int      width    = (tiff->width - x < tileSize) ?
+	tiff->width - x : tileSize;
+    const int      height   = (tiff->height - y < tileSize) ?
+	tiff->height - y : tileSize;
+    const uint64_t index    = (uint64_t) (y / tileSize) * tiff->tilesAcross +
+	x / tileSize;
+
+    for (int row = 0; row < tileSize; row++) {
+	unsigned char *out = bytes + (size_t) row * tileSize * 3;
+	int            done = 0;
+
+	if (row < height) {
+	    const tRGB *in = pixels + (size_t) row * stride;
+
+	    for (; done < width; done++) {
+		out[3 * done]     = in[done].r;
+		out[3 * done + 1] = in[done].g;
+		out[3 * done + 2] = in[done].b;
+	    }
+	}
+
+	memset(out + 3 * done, 0, (size_t) (tileSize - done) * 3);
+    }
+
+    return writeAt(tiff->fd, bytes, tiff->tileBytes,
+		   tiff->dataStart + index * tiff->tileBytes);
+}
@@ -0,0 +1,72 @@
+/*
+ * A very simple tiled TIFF writer, part of an exercise program that draws
+ * mandelbrot sets.
+ *
+ * TARGA images keep their size in 16 bits, so they stop at 65535 pixels
+ * across. TIFF has no such limit, and can cut an image into tiles that are
+ * stored one after another, each at its own place in the file. Since the
+ * tiles are uncompressed, and all the same size, where each one goes can be
+ * worked out before anything is drawn. So the header goes out first, and
+ * every tile after that can be written straight to its place, by any thread,
+ * in any order, without the rest of the image ever being held in memory.
+ *
+ * Files that would pass 4 GiB are written as BigTIFF, which has 64 bit
+ * offsets; everything else is written as plain TIFF, which more programs can
+ * read. Either way, the image is 24 bit RGB.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef TIFF_MODULE
+#define TIFF_MODULE
+
+#include <stdio.h>
+#include <stdint.h>
+#include "targa.h"
+
+
+
+// A tiled TIFF file being written. Shared between every thread writing tiles.
+typedef struct {
+    int      fd;          // Written to with pwrite, so threads never clash.
+    int      width;
+    int      height;
+    int      tileSize;    // Width and height of every tile, edges included.
+    int      tilesAcross;
+    int      tilesDown;
+    size_t   tileBytes;   // Size of a single tile in the file.
+    uint64_t dataStart;   // Where the first tile goes in the file.
+    int      bigTiff;     // 1 if the file is a BigTIFF.
+} tiffWriter;
+
+
+
+/*
+ * Writes the header of a tiled TIFF image to a file, which has to be a regular
+ * file rather than a pipe, as the tiles are written out of order. The tile
+ * size must be a multiple of 16. Returns 1 if the file could not be written.
+ */
+int tiffWriterInit(tiffWriter *tiff,
+		   FILE       *file,
+		   const int   width,
+		   const int   height,
+		   const int   tileSize);
+
+/*
+ * Writes one tile, which starts at pixel (x, y) of the image. x and y must be
+ * multiples of the tile size. pixels holds the tile's rows, stride pixels
+ * apart, cut short at the edges of the image; the rest of the tile is padded
+ * out with black. bytes is scratch space of tiff->tileBytes, which each thread
+ * needs its own of. Returns 1 if the tile could not be written.
+ */
+int tiffWriteTile(const tiffWriter *tiff,
+		  const int         x,
+		  const int         y,
+		  const tRGB       *pixels,
+		  const int         stride,
+		  unsigned char    *bytes);
+
+#endif // TIFF_MODULE
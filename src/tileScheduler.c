@@ -0,0 +1,173 @@
+/*
+ * A work-stealing tile scheduler, part of an exercise program that draws
+ * mandelbrot sets.
+ *
+ * This module only hands out regions of an image; it knows nothing about what
+ * is drawn into them.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#include "tileScheduler.h"
+
+#include <stdlib.h>
+#include <limits.h>
+#include <omp.h>
+
+
+
+
+// Sets up the tile grid, and deals the tiles out over the queues.
+int tileSchedulerInit(tileScheduler *scheduler,
+		      const int      width,
+		      const int      height,
+		      const int      tileSize,
+		      const int      queueCount)
+{
+    const long long tilesAcross = ((long long) width + tileSize - 1) / tileSize;
+    const long long tilesDown   = ((long long) height + tileSize - 1) / tileSize;
+
+    // Tiles are numbered with ints, so there cannot be more than an int holds.
+    if (tilesAcross * tilesDown > INT_MAX)
+	return 1;
+
+    scheduler->width       = width;
+    scheduler->height      = height;
+    scheduler->tileSize    = tileSize;
+    scheduler->tilesAcross = tilesAcross;
+    scheduler->tileCount   = tilesAcross * tilesDown;
+    scheduler->queueCount  = queueCount;
+
+    // The queues are cache-line aligned, so they need an aligned allocation.
+    scheduler->queues = aligned_alloc(_Alignof(tileQueue),
+				      queueCount * sizeof (tileQueue));
+    if (scheduler->queues == NULL)
+	return 1;
+
+    for (int i = 0; i < queueCount; i++)
+	omp_init_lock(&scheduler->queues[i].lock);
+
+    tileSchedulerReset(scheduler);
+
+    return 0;
+}
+
+
+
+
+/* Deals every tile out over the queues again. Each queue gets a contiguous run
+   of tiles, so a thread mostly works on neighbouring parts of the image. The
+   remainder goes to the first few queues. */
+void tileSchedulerReset(tileScheduler *scheduler)
+{
+    const int share     = scheduler->tileCount / scheduler->queueCount;
+    const int remainder = scheduler->tileCount % scheduler->queueCount;
+    int       start     = 0;
+
+    for (int i = 0; i < scheduler->queueCount; i++) {
+	tileQueue *queue = &scheduler->queues[i];
+
+	queue->head = start;
+	start      += share + (i < remainder);
+	queue->tail = start;
+    }
+}
+
+
+
+
+// Frees the queues of a scheduler.
+void tileSchedulerFree(tileScheduler *scheduler)
+{
+    for (int i = 0; i < scheduler->queueCount; i++)
+	omp_destroy_lock(&scheduler->queues[i].lock);
+
+    free(scheduler->queues);
+    scheduler->queues = NULL;
+}
+
+
+
+
+// Turns a tile number into the region of the image it covers.
+static void tileFromIndex(const tileScheduler *scheduler,
+			  const int            index,
+			  tTile               *tile)
+{
+    const int tileSize = scheduler->tileSize;
+
+    tile->x      = (index % scheduler->tilesAcross) * tileSize;
+    tile->y      = (index / scheduler->tilesAcross) * tileSize;
+    tile->width  = scheduler->width - tile->x;
+    tile->height = scheduler->height - tile->y;
+
+    // Tiles on the right and bottom edges get cut short by the image.
+    if (tile->width > tileSize)
+	tile->width = tileSize;
+    if (tile->height > tileSize)
+	tile->height = tileSize;
+}
+
+
+
+
+// Takes a tile from the thread's own queue, or steals one from another.
+int tileSchedulerNext(tileScheduler *scheduler,
+		      const int      queueID,
+		      tTile         *tile,
+		      int           *stolen)
+{
+    tileQueue *own   = &scheduler->queues[queueID];
+    int        index = -1;
+
+    // The owner takes from the front of its queue.
+    omp_set_lock(&own->lock);
+    if (own->head < own->tail)
+	index = own->head++;
+    omp_unset_lock(&own->lock);
+
+    if (stolen != NULL)
+	*stolen = 0;
+
+    /* With an empty queue, the thread goes looking through the other queues
+       (starting from its neighbour), and takes the back half of the first one
+       that still has work. Thieves take from the back, so they stay out of
+       the way of the owner. */
+    for (int i = 1; index < 0 && i < scheduler->queueCount; i++) {
+	tileQueue *victim = &scheduler->queues[(queueID + i) %
+					       scheduler->queueCount];
+	int        start  = 0;
+	int        count  = 0;
+
+	omp_set_lock(&victim->lock);
+	if (victim->head < victim->tail) {
+	    count         = (victim->tail - victim->head + 1) / 2;
+	    victim->tail -= count;
+	    start         = victim->tail;
+	}
+	omp_unset_lock(&victim->lock);
+
+	if (count == 0)
+	    continue;
+
+	// Keeps the first stolen tile, and queues the rest up for later.
+	omp_set_lock(&own->lock);
+	own->head = start + 1;
+	own->tail = start + count;
+	omp_unset_lock(&own->lock);
+
+	index = start;
+	if (stolen != NULL)
+	    *stolen = 1;
+    }
+
+    // Every queue was empty, so the image is done.
+    if (index < 0)
+	return 0;
+
+    tileFromIndex(scheduler, index, tile);
+    return 1;
+}
@@ -0,0 +1,88 @@
+/*
+ * A work-stealing tile scheduler, part of an exercise program that draws
+ * mandelbrot sets.
+ *
+ * The image is cut into small rectangular tiles, and every thread is given a
+ * queue holding a contiguous run of them. A thread takes tiles from the front
+ * of its own queue, and once that runs dry it steals half of the tiles left at
+ * the back of another thread's queue. Expensive parts of the image (the edges
+ * of the set) end up spread over all the threads this way, instead of stalling
+ * whichever thread happened to be handed them.
+ *
+ * Send all complaints and love-letters to bodavelisafrank@gmail.com.
+ *
+ * Copyright 2017, Maxwell Powlison. Licensed under the GNU GPL v3.0. A copy of
+ * this license has been provided in the main directory of this project. If it
+ * is missing, a new copy can be downloaded from https://www.gnu.org/.
+ */
+#ifndef TILE_SCHEDULER_MODULE
+#define TILE_SCHEDULER_MODULE
+
+#include <omp.h>
+
+// Width and height of a tile, in pixels, unless told otherwise.
+#define TILE_SIZE_DEFAULT 32
+
+
+
+// A rectangular region of the image.
+typedef struct {
+    int x;      // Left-most column of the tile.
+    int y;      // Top-most row of the tile.
+    int width;
+    int height;
+} tTile;
+
+
+
+/* A queue of tiles belonging to one thread. The tiles are always a contiguous
+   run of tile numbers, [head, tail). Aligned so that two queues never share a
+   cache line. */
+typedef struct {
+    _Alignas(64) omp_lock_t lock;
+    int                     head; // Next tile the owner takes.
+    int                     tail; // One past the last tile in the queue.
+} tileQueue;
+
+
+
+// The scheduler itself. Shared between every thread working on an image.
+typedef struct {
+    int        width;       // Size of the image being cut up.
+    int        height;
+    int        tileSize;    // Width and height of the (non-edge) tiles.
+    int        tilesAcross; // Number of tiles in a row of the image.
+    int        tileCount;
+    int        queueCount;
+    tileQueue *queues;      // One queue per thread.
+} tileScheduler;
+
+
+
+/*
+ * Sets up a scheduler for an image, splitting its tiles evenly over the given
+ * number of queues. Returns 1 if memory could not be allocated, or the image
+ * has more tiles than an int can count, 0 otherwise.
+ */
+int  tileSchedulerInit(tileScheduler *scheduler,
+		       const int      width,
+		       const int      height,
+		       const int      tileSize,
+		       const int      queueCount);
+void tileSchedulerFree(tileScheduler *scheduler);
+
+/* Deals every tile out again, so the same scheduler can be used for another
+   image of the same size. No thread may be taking tiles meanwhile. */
+void tileSchedulerReset(tileScheduler *scheduler);
+
+/*
+ * Hands the next tile to the thread owning the given queue, stealing from the
+ * other queues when its own is empty. Returns 0 once there is no work left, 1
+ * otherwise. If 'stolen' is not NULL, it is set to 1 for a stolen tile.
+ */
+int tileSchedulerNext(tileScheduler *scheduler,
+		      const int      queueID,
+		      tTile         *tile,
+		      int           *stolen);
+
+#endif // TILE_SCHEDULER_MODULE